@@ -10,8 +10,13 @@ let package = Package(
       
     ],
     targets: [
+        .target(
+            name: "CFFBShm",
+            path: "Sources/CFFBShm"
+        ),
         .executableTarget(
             name: "g29ffb",
+            dependencies: ["CFFBShm"],
             path: "Sources/g29ffb"
         ),
     ]
@@ -0,0 +1,2 @@
+// The ring helpers are static inline in the header; SwiftPM needs one source file per C target.
+#include "CFFBShm.h"
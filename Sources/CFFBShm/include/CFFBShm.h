@@ -0,0 +1,7 @@
+// Exposes the shared-memory ring (clients/common/ffb_shm.h) and its atomics to Swift.
+#ifndef CFFBSHM_H
+#define CFFBSHM_H
+
+#include "../../../clients/common/ffb_shm.h"
+
+#endif
@@ -0,0 +1,106 @@
+// Sources/g29ffb/Bench.swift
+
+import Foundation
+
+// MARK: - Microbenchmarks (--bench)
+// Runs the daemon's per-tick kernels offline, without a wheel or a proxy, and prints
+// throughput so changes to the hot paths can be compared on the same machine.
+
+struct BenchResult {
+    var name: String
+    var iterations: Int
+    var seconds: Double
+
+    var nsPerIteration: Double { seconds * 1e9 / Double(iterations) }
+}
+
+/// Times `body` over `iterations` calls after a short warm-up. The returned sink keeps
+/// the optimizer from discarding the work.
+func measure(_ name: String, iterations: Int, _ body: () -> Double) -> (BenchResult, Double) {
+    var sink = 0.0
+    for _ in 0..<min(iterations, 10_000) { sink += body() }
+    let start = DispatchTime.now().uptimeNanoseconds
+    for _ in 0..<iterations { sink += body() }
+    let end = DispatchTime.now().uptimeNanoseconds
+    return (BenchResult(name: name, iterations: iterations, seconds: Double(end - start) / 1e9), sink)
+}
+
+func printBench(_ r: BenchResult, effects: Int) {
+    let perEffect = r.nsPerIteration / Double(max(1, effects))
+    let samplesPerSec = Double(r.iterations * max(1, effects)) / r.seconds
+    print(String(format: "  %-28@ %9.1f ns/tick %7.2f ns/effect %8.1f Msamples/s",
+                 r.name as NSString, r.nsPerIteration, perEffect, samplesPerSec / 1e6))
+}
+
+func benchPeriodic(iterations: Int) -> Double {
+    print("periodic synth (\(PeriodicSynth.tableSize)-sample tables, dt = 1 ms):")
+    var sink = 0.0
+    let shapes = PeriodicShape.allCases
+    for effects in [1, 4, 16, PeriodicSynth.capacity] {
+        let synth = PeriodicSynth()
+        for i in 0..<effects {
+            synth.add(id: UInt16(i + 1), shape: shapes[i % shapes.count], magnitude: 0.5, offset: 0,
+                      frequency: Float(5 + i), phase: Float(i) / Float(effects))
+        }
+        let (table, s1) = measure("wavetable x\(effects)", iterations: iterations) {
+            synth.render(dt: 0.001)
+        }
+        printBench(table, effects: effects)
+
+        // Reference: evaluate each waveform directly, one effect at a time.
+        var phases = (0..<effects).map { Double($0) / Double(effects) }
+        let (direct, s2) = measure("direct x\(effects)", iterations: iterations) {
+            var total = 0.0
+            for i in 0..<effects {
+                var p = phases[i] + Double(5 + i) * 0.001
+                p -= p.rounded(.down)
+                phases[i] = p
+                total += 0.5 * shapes[i % shapes.count].value(at: p)
+            }
+            return total
+        }
+        printBench(direct, effects: effects)
+        sink += s1 + s2
+    }
+    return sink
+}
+
+func benchFilters(iterations: Int) -> Double {
+    print("output filters (1 kHz tick, budget 1 ms):")
+    var sink = 0.0
+    let full = ForceFilterConfig(lowPassHz: 40, notchHz: 25, slewPerS: 20, softClipKnee: 0.8)
+    let stages: [(String, ForceFilterConfig)] = [
+        ("lowpass", ForceFilterConfig(lowPassHz: 40)),
+        ("notch", ForceFilterConfig(notchHz: 25)),
+        ("slew", ForceFilterConfig(slewPerS: 20)),
+        ("soft clip", ForceFilterConfig(softClipKnee: 0.8)),
+        ("full chain", full),
+    ]
+    for (name, config) in stages {
+        var chain = ForceFilterChain(config, sampleRate: 1000, limit: 1)
+        var phase = 0.0
+        let (r, s) = measure(name, iterations: iterations) {
+            // A loud input with a rattle on top, so every stage has work to do.
+            phase += 0.001
+            if phase >= 1 { phase -= 1 }
+            let x = 1.2 * sin(2 * .pi * 2 * phase) + 0.2 * sin(2 * .pi * 25 * phase)
+            return chain.process(x, dt: 0.001, tick: true)
+        }
+        print(String(format: "  %-28@ %9.1f ns/tick %9.5f %% of the tick", r.name as NSString, r.nsPerIteration,
+                     r.nsPerIteration / 1e6 * 100))
+        sink += s
+    }
+    return sink
+}
+
+func runBench(args: [String]) {
+    var iterations = 200_000
+    if let i = args.firstIndex(of: "--iterations"), i + 1 < args.count, let n = Int(args[i + 1]), n > 0 {
+        iterations = n
+    }
+    var sink = 0.0
+    sink += benchPeriodic(iterations: iterations)
+    sink += benchFilters(iterations: iterations)
+    // Printed so the measured work cannot be optimized away.
+    print(String(format: "checksum %.3f", sink))
+}
@@ -0,0 +1,202 @@
+// Sources/g29ffb/ClassicSlots.swift
+
+import Foundation
+
+// MARK: - Firmware force slots (Logitech Classic protocol)
+// Besides constant forces, the Classic protocol downloads springs, dampers, friction,
+// auto-centering and periodic forces into the wheel's four force slots (F0-F3). The
+// firmware runs them in its own loop, so they never wait for a host tick or a USB write.
+// With --offload, F0 keeps the constant force the host mixes and F1-F3 are handed out by
+// ForceSlotAllocator; whatever does not fit (or has no firmware equivalent) stays on the host.
+// Only conditions are offloaded so far, so only their builders are here: periodic forces
+// keep their phase-accurate host synthesis, and DIPROP_AUTOCENTER uses the default spring
+// command rather than a slot.
+// Byte layouts follow the force type tables of the Classic FFB PDF.
+
+enum ClassicForceType: UInt8 {
+    case constant = 0x00
+    case spring = 0x01
+    case damper = 0x02
+    case autoCenterSpring = 0x03
+    case sawtoothUp = 0x04
+    case sawtoothDown = 0x05
+    case trapezoid = 0x06
+    case rectangle = 0x07
+    case highResSpring = 0x0B
+    case highResDamper = 0x0C
+    case friction = 0x0E
+}
+
+/// One downloadable force: the type (byte1) and its parameters (bytes 2...6).
+struct ClassicForce: Equatable {
+    var type: ClassicForceType
+    var p0: UInt8 = 0
+    var p1: UInt8 = 0
+    var p2: UInt8 = 0
+    var p3: UInt8 = 0
+    var p4: UInt8 = 0
+
+    /// High-resolution spring. Dead band edges are 11-bit wheel positions (0...2047);
+    /// k1/s1 apply left of `left`, k2/s2 right of `right`; s inverts the force.
+    static func highResSpring(left: Int, right: Int, k1: UInt8, k2: UInt8, s1: Bool, s2: Bool, clip: UInt8) -> ClassicForce {
+        let d1 = max(0, min(2047, left))
+        let d2 = max(0, min(2047, right))
+        // byte5: D2 low bits (7:5), S2 (4), D1 low bits (3:1), S1 (0)
+        var low = UInt8(d2 & 7) << 5 | UInt8(d1 & 7) << 1
+        if s2 { low |= 0x10 }
+        if s1 { low |= 0x01 }
+        return ClassicForce(type: .highResSpring, p0: UInt8(d1 >> 3), p1: UInt8(d2 >> 3),
+                            p2: (k2 & 0x0F) << 4 | (k1 & 0x0F), p3: low, p4: clip)
+    }
+
+    /// High-resolution damper: k1/s1 while turning left, k2/s2 while turning right.
+    static func highResDamper(k1: UInt8, k2: UInt8, s1: Bool, s2: Bool, clip: UInt8) -> ClassicForce {
+        ClassicForce(type: .highResDamper, p0: k1 & 0x0F, p1: s1 ? 1 : 0, p2: k2 & 0x0F, p3: s2 ? 1 : 0, p4: clip)
+    }
+
+    static func friction(k1: UInt8, k2: UInt8, s1: Bool, s2: Bool, clip: UInt8) -> ClassicForce {
+        let s: UInt8 = (s2 ? 0x10 : 0) | (s1 ? 0x01 : 0)
+        return ClassicForce(type: .friction, p0: k1, p1: k2, p2: clip, p3: s)
+    }
+}
+
+extension ClassicForce {
+    /// Firmware equivalent of a condition, nil for inertia (the wheel has none). `gain`
+    /// (effect gain times device gain) scales coefficients and clip; `limit` (0...1) caps
+    /// the clip like --max caps the host's force. The firmware has one clip for both
+    /// sides, so the larger saturation is used; dampers and friction ignore offset and
+    /// dead band, as the firmware has no parameter for them.
+    init?(condition c: ConditionParams, gain: Double, limit: Double) {
+        let g = c.gain * gain
+        let clip = Self.fraction(min(max(c.positiveSaturation, c.negativeSaturation) * g, limit), scale: 255)
+        switch c.kind {
+        case .spring:
+            self = .highResSpring(left: Self.position(c.offset - c.deadband), right: Self.position(c.offset + c.deadband),
+                                  k1: Self.fraction(abs(c.negativeCoefficient) * g, scale: 15),
+                                  k2: Self.fraction(abs(c.positiveCoefficient) * g, scale: 15),
+                                  s1: c.negativeCoefficient < 0, s2: c.positiveCoefficient < 0, clip: clip)
+        case .damper:
+            self = .highResDamper(k1: Self.fraction(abs(c.negativeCoefficient) * g, scale: 15),
+                                  k2: Self.fraction(abs(c.positiveCoefficient) * g, scale: 15),
+                                  s1: c.negativeCoefficient < 0, s2: c.positiveCoefficient < 0, clip: clip)
+        case .friction:
+            self = .friction(k1: Self.fraction(abs(c.negativeCoefficient) * g, scale: 255),
+                             k2: Self.fraction(abs(c.positiveCoefficient) * g, scale: 255),
+                             s1: c.negativeCoefficient < 0, s2: c.positiveCoefficient < 0, clip: clip)
+        case .inertia:
+            return nil
+        }
+    }
+
+    /// 11-bit wheel position for -1 (full left) ... 1 (full right).
+    static func position(_ x: Double) -> Int {
+        max(0, min(2047, Int(((x + 1) * 1023.5).rounded())))
+    }
+
+    /// 0...1 to 0...scale.
+    static func fraction(_ v: Double, scale: Int) -> UInt8 {
+        UInt8(max(0, min(Double(scale), (v * Double(scale)).rounded())))
+    }
+}
+
+func writeDownloadPlayForce(_ p: UnsafeMutablePointer<UInt8>, slotMask: UInt8, force: ClassicForce) {
+    // CMD 0x01: Download and Play Force, byte1: FORCE_TYPE, bytes 2..6: its parameters
+    p[0] = makeCmdByte(slotMask: slotMask, cmd: 0x01)
+    p[1] = force.type.rawValue
+    p[2] = force.p0
+    p[3] = force.p1
+    p[4] = force.p2
+    p[5] = force.p3
+    p[6] = force.p4
+}
+
+func writeDefaultSpringOn(_ p: UnsafeMutablePointer<UInt8>, slotMask: UInt8) {
+    // CMD 0x04: Default Spring On
+    p[0] = makeCmdByte(slotMask: slotMask, cmd: 0x04)
+    p.advanced(by: 1).update(repeating: 0x00, count: 6)
+}
+
+func payloadDownloadPlayForce(slotMask: UInt8, force: ClassicForce) -> [UInt8] {
+    classicPayload { writeDownloadPlayForce($0, slotMask: slotMask, force: force) }
+}
+
+func payloadDefaultSpringOn(slotMask: UInt8) -> [UInt8] {
+    classicPayload { writeDefaultSpringOn($0, slotMask: slotMask) }
+}
+
+// MARK: - Slot allocation
+
+/// Keeps F1-F3 loaded with the effects the host wants run in firmware. An effect keeps its
+/// slot for as long as it plays; free slots go to new effects in the order given.
+final class ForceSlotAllocator {
+    /// F1, F2, F3. F0 carries the host's mixed constant force.
+    static let slotMasks: [UInt8] = [0x02, 0x04, 0x08]
+
+    private var owners: [UInt16?]
+    /// What each slot runs on the wheel right now.
+    private var loaded: [ClassicForce?]
+    private let scratch = UnsafeMutablePointer<UInt8>.allocate(capacity: classicPayloadSize)
+
+    init() {
+        owners = Array(repeating: nil, count: Self.slotMasks.count)
+        loaded = Array(repeating: nil, count: Self.slotMasks.count)
+    }
+
+    deinit {
+        scratch.deallocate()
+    }
+
+    var isActive: Bool { loaded.contains { $0 != nil } }
+
+    /// Moves the slots to `wanted` (priority order) and hands `emit` the reports that get
+    /// the wheel there, batched: one stop for all freed slots, then one download per
+    /// distinct force, shared by every slot that runs it. Returns the effects that got a slot.
+    func update(_ wanted: [(id: UInt16, force: ClassicForce)], emit: (UnsafePointer<UInt8>) -> Void) -> Set<UInt16> {
+        var target = [ClassicForce?](repeating: nil, count: owners.count)
+        var placed = Set<UInt16>()
+        for i in owners.indices {
+            if let id = owners[i], let w = wanted.first(where: { $0.id == id }) {
+                target[i] = w.force
+                placed.insert(id)
+            } else {
+                owners[i] = nil
+            }
+        }
+        for w in wanted where !placed.contains(w.id) {
+            guard let i = owners.firstIndex(where: { $0 == nil }) else { break }
+            owners[i] = w.id
+            target[i] = w.force
+            placed.insert(w.id)
+        }
+
+        var stopMask: UInt8 = 0
+        for i in owners.indices where loaded[i] != nil && target[i] == nil {
+            stopMask |= Self.slotMasks[i]
+        }
+        if stopMask != 0 {
+            writeStopForce(scratch, slotMask: stopMask)
+            emit(scratch)
+        }
+        var done = [Bool](repeating: false, count: owners.count)
+        for i in owners.indices {
+            guard !done[i], let force = target[i], force != loaded[i] else { continue }
+            var mask: UInt8 = 0
+            for j in i..<owners.count where target[j] == force && loaded[j] != force {
+                mask |= Self.slotMasks[j]
+                done[j] = true
+            }
+            writeDownloadPlayForce(scratch, slotMask: mask, force: force)
+            emit(scratch)
+        }
+        loaded = target
+        return placed
+    }
+
+    /// Forgets what the wheel runs, after a stop of every slot.
+    func reset() {
+        for i in owners.indices {
+            owners[i] = nil
+            loaded[i] = nil
+        }
+    }
+}
@@ -0,0 +1,125 @@
+// Sources/g29ffb/ConditionCheck.swift
+
+import Foundation
+
+// MARK: - Condition self-check (--check-conditions)
+// Drives ConditionEngine with synthetic wheel traces (static positions, a ramp, a step,
+// a sine, and a ramp sampled at a jittery rate with 16-bit quantization), without a wheel,
+// and compares the spring, damper, friction and inertia forces and the velocity estimate
+// with their ideal values. Exits non-zero when one is off by more than its tolerance.
+
+/// An engine running only `p`.
+private func engine(_ p: WireConditionPacket) -> ConditionEngine {
+    var e = ConditionEngine()
+    e.apply(p)
+    return e
+}
+
+/// Samples `position` every millisecond from 0 to `seconds`, calling `each` after each sample.
+private func drive(_ e: inout ConditionEngine, seconds: Double, position: (Double) -> Double,
+                   each: (Double, ConditionEngine) -> Void = { _, _ in }) {
+    let steps = Int((seconds * 1000).rounded())
+    for i in 0...steps {
+        let t = Double(i) / 1000
+        e.sample(position: position(t), time: t)
+        each(t, e)
+    }
+}
+
+func runConditionCheck() {
+    var check = SelfCheck()
+    let exact = 1e-9
+
+    print("spring (static positions):")
+    for (name, p, x, want) in [
+        ("k 1 at 0.5", conditionPacket(.spring), 0.5, -0.5),
+        ("offset 0.2, dead band 0.1 at 0.5", conditionPacket(.spring, offset: 2000, deadband: 1000), 0.5, -0.2),
+        ("negative side k 0.5 at -0.6", conditionPacket(.spring, negative: 5000), -0.6, 0.3),
+        ("saturation 0.4 at 0.9", conditionPacket(.spring, positiveSaturation: 4000, negativeSaturation: 4000), 0.9, -0.4),
+        ("gain 0.5 at 0.5", conditionPacket(.spring, gain: 5000), 0.5, -0.25),
+    ] {
+        var e = engine(p)
+        drive(&e, seconds: 0.01, position: { _ in x })
+        check.expect(name, e.force(), want, tolerance: exact)
+    }
+
+    // 0.5 per second, a quarter of velocityFullScale; settled well before 1 s.
+    print("ramp:")
+    let ramp: (Double) -> Double = { t in 0.5 * t - 0.25 }
+    var e = engine(conditionPacket(.damper))
+    drive(&e, seconds: 1, position: ramp)
+    check.expect("velocity estimate", e.kinematics.velocity, 0.5, tolerance: 1e-6)
+    check.expect("damper k 1", e.force(), -0.25, tolerance: 1e-6)
+    e = engine(conditionPacket(.friction, positive: 6000, negative: 6000))
+    drive(&e, seconds: 1, position: ramp)
+    check.expect("friction 0.6, moving right", e.force(), -0.6, tolerance: 1e-6)
+    e = engine(conditionPacket(.friction, positive: 6000, negative: 6000))
+    drive(&e, seconds: 1, position: { t in -ramp(t) })
+    check.expect("friction 0.6, moving left", e.force(), 0.6, tolerance: 1e-6)
+    e = engine(conditionPacket(.friction, positive: 6000, negative: 6000))
+    drive(&e, seconds: 1, position: { _ in 0.3 })
+    check.expect("friction at rest", e.force(), 0, tolerance: exact)
+    e = engine(conditionPacket(.inertia))
+    drive(&e, seconds: 1, position: ramp)
+    check.expect("inertia at constant velocity", e.force(), 0, tolerance: 1e-6)
+
+    // 0 -> 0.5 at 0.5 s. The low-passed velocity must spike once and decay without ringing.
+    print("step:")
+    e = engine(conditionPacket(.spring))
+    e.apply(conditionPacket(.damper, id: 2))
+    var negative = false
+    var velocityAfter = 0.0
+    drive(&e, seconds: 1, position: { t in t >= 0.5 ? 0.5 : 0 }) { t, e in
+        if e.kinematics.velocity < 0 { negative = true }
+        if abs(t - 0.6) < 1e-9 { velocityAfter = e.kinematics.velocity }
+    }
+    check.expect("velocity never swings back", !negative)
+    check.expect("velocity 100 ms after the step", velocityAfter, 0, tolerance: 1e-3)
+    check.expect("spring + damper once settled", e.force(), -0.5, tolerance: 1e-6)
+
+    // 0.5 * sin(2 pi t): velocity peaks at pi, acceleration at 2 pi^2. The 30 Hz low-pass
+    // lags by about 2 degrees, hence tolerances of 5 % (velocity) and 10 % (acceleration)
+    // of the peak, checked over the second and third seconds.
+    print("sine (1 Hz):")
+    let w = 2 * Double.pi
+    let sine: (Double) -> Double = { t in 0.5 * sin(w * t) }
+    let velocity: (Double) -> Double = { t in 0.5 * w * cos(w * t) }
+    let acceleration: (Double) -> Double = { t in -0.5 * w * w * sin(w * t) }
+    var damper = engine(conditionPacket(.damper))
+    var inertia = engine(conditionPacket(.inertia))
+    var velocityError = 0.0, damperError = 0.0, inertiaError = 0.0
+    drive(&damper, seconds: 3, position: sine) { t, e in
+        guard t >= 1 else { return }
+        velocityError = max(velocityError, abs(e.kinematics.velocity - velocity(t)))
+        damperError = max(damperError, abs(e.force() + velocity(t) / ConditionEngine.velocityFullScale))
+    }
+    drive(&inertia, seconds: 3, position: sine) { t, e in
+        guard t >= 1 else { return }
+        inertiaError = max(inertiaError, abs(e.force() + acceleration(t) / ConditionEngine.accelerationFullScale))
+    }
+    check.expect("velocity estimate, max error", velocityError, 0, tolerance: 0.05 * 0.5 * w)
+    check.expect("damper k 1, max error", damperError, 0, tolerance: 0.05 * 0.5 * w / ConditionEngine.velocityFullScale)
+    check.expect("inertia k 1, max error", inertiaError, 0,
+                 tolerance: 0.1 * 0.5 * w * w / ConditionEngine.accelerationFullScale)
+
+    // The ramp again, read as a 16-bit axis and sampled every 0.5-1.5 ms.
+    print("jittered ramp:")
+    var rng = CheckRandom()
+    e = engine(conditionPacket(.damper))
+    var t = 0.0, jitterError = 0.0
+    while t < 2 {
+        e.sample(position: (ramp(t) * 32767).rounded() / 32767, time: t)
+        if t >= 0.5 { jitterError = max(jitterError, abs(e.kinematics.velocity - 0.5)) }
+        t += 0.0005 + 0.001 * rng.next()
+    }
+    check.expect("velocity estimate, max error", jitterError, 0, tolerance: 0.01)
+
+    print("stop:")
+    e = engine(conditionPacket(.spring))
+    drive(&e, seconds: 0.01, position: { _ in 0.5 })
+    e.apply(conditionPacket(.spring, playing: false))
+    check.expect("a stopped condition is removed", !e.isActive && e.playing.isEmpty)
+    check.expect("and exerts no force", e.force(), 0, tolerance: exact)
+
+    check.finish()
+}
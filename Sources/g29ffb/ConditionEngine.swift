@@ -0,0 +1,234 @@
+// Sources/g29ffb/ConditionEngine.swift
+
+import Foundation
+@preconcurrency import IOKit.hid
+
+// MARK: - Condition effects (Spring / Damper / Friction / Inertia)
+// The proxy forwards DICONDITION once; the daemon evaluates it against the wheel's own
+// position every tick, so the loop never waits on a proxy -> UDP round trip.
+// Time and position are explicit inputs: the same position trace always yields the same forces.
+
+enum ConditionKind {
+    case spring, damper, friction, inertia
+
+    init?(_ type: WireEffectType) {
+        switch type {
+        case .spring: self = .spring
+        case .damper: self = .damper
+        case .friction: self = .friction
+        case .inertia: self = .inertia
+        default: return nil
+        }
+    }
+}
+
+/// DICONDITION normalized to -1...1 (DirectInput units / 10000).
+struct ConditionParams {
+    var kind: ConditionKind
+    var offset: Double
+    var positiveCoefficient: Double
+    var negativeCoefficient: Double
+    var positiveSaturation: Double
+    var negativeSaturation: Double
+    var deadband: Double
+    /// DIEFFECT.dwGain, 0...1, applied to the effect's output.
+    var gain: Double
+
+    init?(_ p: WireConditionPacket) {
+        guard let kind = ConditionKind(p.effectType) else { return nil }
+        let scale = Double(wireMagnitudeMax)
+        self.kind = kind
+        self.offset = Double(p.offset) / scale
+        self.positiveCoefficient = Double(p.positiveCoefficient) / scale
+        self.negativeCoefficient = Double(p.negativeCoefficient) / scale
+        // Many games leave saturation at 0 meaning "no limit"; a literal 0 would disable the effect.
+        self.positiveSaturation = p.positiveSaturation == 0 ? 1 : Double(p.positiveSaturation) / scale
+        self.negativeSaturation = p.negativeSaturation == 0 ? 1 : Double(p.negativeSaturation) / scale
+        self.deadband = Double(p.deadband) / scale
+        self.gain = Double(p.gain) / scale
+    }
+}
+
+/// Position, velocity and acceleration of the steering axis from timestamped samples.
+/// Velocity and acceleration are finite differences through a one-pole low-pass.
+struct WheelKinematics {
+    /// Normalized position, -1 (full left) ... 1 (full right).
+    private(set) var position: Double = 0
+    /// Normalized units per second.
+    private(set) var velocity: Double = 0
+    /// Normalized units per second squared.
+    private(set) var acceleration: Double = 0
+
+    let cutoffHz: Double
+    private var lastTime: Double?
+
+    init(cutoffHz: Double = 30) {
+        self.cutoffHz = cutoffHz
+    }
+
+    mutating func update(position: Double, time: Double) {
+        guard let lastTime else {
+            self.position = position
+            self.lastTime = time
+            return
+        }
+        let dt = time - lastTime
+        guard dt > 0 else { return }
+        let alpha = dt / (dt + 1 / (2 * Double.pi * cutoffHz))
+        let newVelocity = velocity + alpha * ((position - self.position) / dt - velocity)
+        acceleration += alpha * ((newVelocity - velocity) / dt - acceleration)
+        velocity = newVelocity
+        self.position = position
+        self.lastTime = time
+    }
+
+    mutating func reset() {
+        self = WheelKinematics(cutoffHz: cutoffHz)
+    }
+}
+
+struct ConditionEngine {
+    /// Velocity that counts as a full-scale damper/friction metric (about 900 deg/s on a 900 deg wheel).
+    static let velocityFullScale = 2.0
+    /// Acceleration that counts as a full-scale inertia metric.
+    static let accelerationFullScale = 40.0
+    /// Friction ramps from 0 to full over this fraction of full-scale velocity, so it does not chatter at rest.
+    static let frictionRamp = 0.02
+
+    private struct Slot {
+        var effectID: UInt16
+        var params: ConditionParams
+        /// Run by the wheel firmware (--offload): not part of force().
+        var offloaded = false
+    }
+
+    /// Playing conditions only: a stop packet removes its slot.
+    private var slots: [Slot] = []
+    private(set) var kinematics = WheelKinematics()
+
+    /// True while a condition needs the host loop; offloaded ones do not.
+    var isActive: Bool { slots.contains { !$0.offloaded } }
+
+    /// Playing conditions, oldest first.
+    var playing: [(id: UInt16, params: ConditionParams)] {
+        slots.map { (id: $0.effectID, params: $0.params) }
+    }
+
+    /// Marks which conditions the wheel runs itself; every other one goes back to the host.
+    mutating func setOffloaded(_ ids: Set<UInt16>) {
+        for i in slots.indices { slots[i].offloaded = ids.contains(slots[i].effectID) }
+    }
+
+    mutating func apply(_ p: WireConditionPacket) {
+        let slot = slots.firstIndex { $0.effectID == p.effectID }
+        guard p.playing, let params = ConditionParams(p) else {
+            if let slot {
+                slots.remove(at: slot)
+                // Nothing samples the wheel until the next condition: start it from rest.
+                if slots.isEmpty { kinematics.reset() }
+            }
+            return
+        }
+        if let slot {
+            slots[slot].params = params
+        } else {
+            slots.append(Slot(effectID: p.effectID, params: params))
+        }
+    }
+
+    mutating func removeAll() {
+        slots.removeAll(keepingCapacity: true)
+        kinematics.reset()
+    }
+
+    mutating func sample(position: Double, time: Double) {
+        kinematics.update(position: position, time: time)
+    }
+
+    /// Summed force of the playing conditions, -1...1; positive pushes toward positive position.
+    func force() -> Double {
+        var total = 0.0
+        for slot in slots where !slot.offloaded {
+            let c = slot.params
+            let f: Double
+            switch c.kind {
+            case .spring:
+                f = Self.conditionForce(c, metric: kinematics.position)
+            case .damper:
+                f = Self.conditionForce(c, metric: kinematics.velocity / Self.velocityFullScale)
+            case .inertia:
+                f = Self.conditionForce(c, metric: kinematics.acceleration / Self.accelerationFullScale)
+            case .friction:
+                f = Self.frictionForce(c, velocity: kinematics.velocity / Self.velocityFullScale)
+            }
+            total += c.gain * f
+        }
+        return max(-1, min(1, total))
+    }
+
+    /// DirectInput condition: coefficient times the distance past the dead band around the
+    /// offset, limited by the saturation of that side, opposing the displacement.
+    static func conditionForce(_ c: ConditionParams, metric: Double) -> Double {
+        let d = metric - c.offset
+        if d > c.deadband {
+            let f = c.positiveCoefficient * (d - c.deadband)
+            return -max(-c.positiveSaturation, min(c.positiveSaturation, f))
+        }
+        if d < -c.deadband {
+            let f = c.negativeCoefficient * (d + c.deadband)
+            return -max(-c.negativeSaturation, min(c.negativeSaturation, f))
+        }
+        return 0
+    }
+
+    /// Coulomb friction: constant magnitude against the direction of motion.
+    static func frictionForce(_ c: ConditionParams, velocity: Double) -> Double {
+        let ramp = max(-1, min(1, velocity / frictionRamp))
+        let coefficient = ramp >= 0 ? c.positiveCoefficient : c.negativeCoefficient
+        let saturation = ramp >= 0 ? c.positiveSaturation : c.negativeSaturation
+        return -max(-saturation, min(saturation, coefficient * ramp))
+    }
+}
+
+// MARK: - Steering position
+
+/// Steering position from the wheel's Generic Desktop X input element. IOHIDDeviceGetValue
+/// returns the last value the device reported, so polling it every tick costs no USB traffic.
+final class SteeringAxis {
+    private let device: IOHIDDevice
+    private let element: IOHIDElement
+    private let minValue: Double
+    private let span: Double
+    private let placeholder: IOHIDValue
+    private var valueRef: Unmanaged<IOHIDValue>
+
+    init?(device: IOHIDDevice) {
+        let match: [String: Any] = [
+            kIOHIDElementUsagePageKey as String: kHIDPage_GenericDesktop,
+            kIOHIDElementUsageKey as String: kHIDUsage_GD_X
+        ]
+        guard let elems = IOHIDDeviceCopyMatchingElements(
+            device,
+            match as CFDictionary,
+            IOOptionBits(kIOHIDOptionsTypeNone)
+        ) as? [IOHIDElement], let e = elems.first else { return nil }
+
+        let lo = IOHIDElementGetLogicalMin(e)
+        let hi = IOHIDElementGetLogicalMax(e)
+        guard hi > lo else { return nil }
+
+        self.device = device
+        self.element = e
+        self.minValue = Double(lo)
+        self.span = Double(hi - lo)
+        self.placeholder = IOHIDValueCreateWithIntegerValue(kCFAllocatorDefault, e, 0, 0)
+        self.valueRef = Unmanaged.passUnretained(placeholder)
+    }
+
+    /// Normalized position, -1 (full left) ... 1 (full right).
+    func read() -> Double? {
+        guard IOHIDDeviceGetValue(device, element, &valueRef) == kIOReturnSuccess else { return nil }
+        let raw = Double(IOHIDValueGetIntegerValue(valueRef.takeUnretainedValue()))
+        return (raw - minValue) / span * 2 - 1
+    }
+}
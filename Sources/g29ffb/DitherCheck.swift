@@ -0,0 +1,64 @@
+// Sources/g29ffb/DitherCheck.swift
+
+import Foundation
+
+// MARK: - Dither self-check (--check-dither)
+// Feeds ForceDither fractional levels, steady, slowly varying and around saturation, and
+// checks that every run of N ticks averages to the level asked for (clipped to the limit),
+// without a wheel. The error carried into and out of a window is at most half a level
+// after a rounding and at most one level right after saturation, so the tolerance is
+// 1.5 / N levels. Exits non-zero when a window is off by more.
+
+private struct DitherCase {
+    var name: String
+    var limit: Int = 127
+    /// First tick a window may start at, after a transition the average is not meant to cover.
+    var from: Int = 0
+    var level: (Int) -> Double
+}
+
+func runDitherCheck(args: [String]) {
+    let window = checkOption(args, "--ticks") ?? 100
+    let tolerance = 1.5 / Double(window)
+    print(String(format: "%d-tick averages, tolerance %.4f levels:", window, tolerance))
+
+    let cases = [
+        DitherCase(name: "0.3", level: { _ in 0.3 }),
+        DitherCase(name: "12.5", level: { _ in 12.5 }),
+        DitherCase(name: "-40.7", level: { _ in -40.7 }),
+        DitherCase(name: "0.8 * sin, period 37 ticks", level: { k in 0.8 * sin(2 * Double.pi * Double(k) / 37) }),
+        DitherCase(name: "126.6, below saturation", level: { _ in 126.6 }),
+        DitherCase(name: "-126.9, below saturation", level: { _ in -126.9 }),
+        DitherCase(name: "63.8 with --max 64", limit: 64, level: { _ in 63.8 }),
+        DitherCase(name: "140, saturated", level: { _ in 140 }),
+        DitherCase(name: "140 then 126.7", from: 50, level: { k in k < 50 ? 140 : 126.7 }),
+        DitherCase(name: "-140 then 60.4", from: 50, level: { k in k < 50 ? -140 : 60.4 }),
+    ]
+    var check = SelfCheck()
+    for c in cases {
+        var dither = ForceDither()
+        var got = 0.0, want = 0.0, worst = 0.0
+        var history: [(got: Double, want: Double)] = []
+        for k in 0..<(c.from + 10 * window) {
+            let level = c.level(k)
+            let q = Double(dither.quantize(level, limit: c.limit))
+            guard k >= c.from else { continue }
+            history.append((got: q, want: max(-Double(c.limit), min(Double(c.limit), level))))
+            got += q
+            want += history.last!.want
+            if history.count > window {
+                got -= history[history.count - 1 - window].got
+                want -= history[history.count - 1 - window].want
+            }
+            if history.count >= window { worst = max(worst, abs(got - want) / Double(window)) }
+        }
+        // Sums of a few hundred thousand levels: allow for their rounding.
+        check.expect("\(c.name), worst window", worst, 0, tolerance: tolerance + 1e-9)
+    }
+
+    var dither = ForceDither()
+    _ = dither.quantize(0.4, limit: 127)
+    check.expect("0 writes 0 and drops the carried error", dither.quantize(0, limit: 127) == 0 && dither.error == 0)
+
+    check.finish()
+}
@@ -0,0 +1,150 @@
+// Sources/g29ffb/EffectMixer.swift
+
+import Foundation
+
+// MARK: - Effect mixer
+// Every effect the game has running, keyed by the proxy's effect ID, summed once per tick
+// with each effect's own gain and the device gain. Device commands (STOPALL, PAUSE, ...)
+// arrive on the same queue as effect updates, so each one lands between two ticks:
+// no tick ever mixes half of a command.
+
+final class EffectMixer {
+    /// Constant forces, one entry per playing effect. Stopped effects are removed,
+    /// so the tick only walks what it has to sum.
+    private struct ConstantSlot {
+        var effectID: UInt16
+        /// magnitude * gain in -1...1 (direction applied by the proxy), resampled per tick.
+        var level: ForceUpsampler
+    }
+
+    /// Effect ID used by the text protocol ("CONST <n>"); the proxy numbers effects from 1.
+    static let textEffectID: UInt16 = 0
+
+    private var constants: ContiguousArray<ConstantSlot> = []
+    private let upsample: UpsampleConfig
+    private(set) var conditions = ConditionEngine()
+    let periodic = PeriodicSynth()
+
+    /// DIPROP_FFGAIN, 0...1.
+    private(set) var deviceGain = 1.0
+    private(set) var paused = false
+    private(set) var actuatorsOn = true
+    /// DIPROP_AUTOCENTER, nil until the game sets it.
+    private(set) var autoCenter: Bool?
+
+    init(upsample: UpsampleConfig = UpsampleConfig()) {
+        self.upsample = upsample
+        constants.reserveCapacity(PeriodicSynth.capacity)
+    }
+
+    var upsampleMode: UpsampleMode { upsample.mode }
+
+    var isActive: Bool { !constants.isEmpty || conditions.isActive || periodic.isActive }
+
+    /// Wheel position is only read while a condition needs it.
+    var needsPosition: Bool { conditions.isActive }
+
+    /// `time` is when the proxy sent the packet, on the host clock (seconds).
+    func apply(_ p: WireEffectPacket, time: Double) {
+        guard p.effectType == .constant else { return }
+        // Each packet is a full snapshot: a stopped effect contributes nothing, whatever came before.
+        let scale = Double(wireMagnitudeMax)
+        setConstant(id: p.effectID, playing: p.playing,
+                    level: Double(p.magnitude) / scale * (Double(p.gain) / scale), time: time)
+    }
+
+    func apply(_ p: WireConditionPacket) {
+        conditions.apply(p)
+    }
+
+    func apply(_ p: WirePeriodicPacket) {
+        periodic.apply(p)
+    }
+
+    func apply(_ p: WireDevicePacket) {
+        deviceGain = Double(p.gain) / Double(wireMagnitudeMax)
+        switch p.command {
+        case .gainOnly:
+            break
+        case .reset:
+            removeAll()
+            paused = false
+            actuatorsOn = true
+        case .stopAll:
+            removeAll()
+        case .pause:
+            paused = true
+        case .continue:
+            paused = false
+        case .actuatorsOn:
+            actuatorsOn = true
+        case .actuatorsOff:
+            actuatorsOn = false
+        case .autoCenterOff:
+            autoCenter = false
+        case .autoCenterOn:
+            autoCenter = true
+        }
+    }
+
+    /// Text fallback: one constant force in -1...1, nil for STOP. Text carries no
+    /// timestamp, so `time` is the receive time.
+    func applyText(_ level: Double?, time: Double) {
+        setConstant(id: Self.textEffectID, playing: level != nil, level: level ?? 0, time: time)
+    }
+
+    /// Conditions the wheel firmware runs (see ForceSlotAllocator); mix() leaves them out.
+    func offloadConditions(_ ids: Set<UInt16>) {
+        conditions.setOffloaded(ids)
+    }
+
+    func removeAll() {
+        constants.removeAll(keepingCapacity: true)
+        conditions.removeAll()
+        periodic.removeAll()
+    }
+
+    /// Back to the state of a new mixer, for a session slot taken over by another sender.
+    func reset() {
+        removeAll()
+        deviceGain = 1
+        paused = false
+        actuatorsOn = true
+        autoCenter = nil
+    }
+
+    private func setConstant(id: UInt16, playing: Bool, level: Double, time: Double) {
+        let i = constants.firstIndex { $0.effectID == id }
+        guard playing else {
+            if let i { constants.swapAt(i, constants.count - 1); constants.removeLast() }
+            return
+        }
+        // A newly started effect begins at its first value: there is nothing to ramp from.
+        if let i {
+            constants[i].level.push(level, time: time)
+        } else {
+            constants.append(ConstantSlot(effectID: id, level: ForceUpsampler(upsample, value: level, time: time)))
+        }
+    }
+
+    /// Advances effect time by dt seconds and returns the mixed force, unclamped
+    /// (1 is one full-scale effect). `position` is only called when a condition is playing.
+    func mix(dt: Double, time: Double, position: () -> Double?) -> Double {
+        // Paused effects hold their time; with the actuators off they keep running, silently.
+        if paused { return 0 }
+        if needsPosition, let x = position() {
+            conditions.sample(position: x, time: time)
+        }
+        let waves = periodic.isActive ? periodic.render(dt: dt) : 0
+        guard actuatorsOn else { return 0 }
+
+        var total = waves
+        for c in constants {
+            total += c.level.sample(at: time)
+        }
+        if conditions.isActive {
+            total += conditions.force()
+        }
+        return total * deviceGain
+    }
+}
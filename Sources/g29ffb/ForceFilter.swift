@@ -0,0 +1,145 @@
+// Sources/g29ffb/ForceFilter.swift
+
+import Foundation
+
+// MARK: - Output filters (--lowpass, --notch, --slew, --soft-clip)
+// Optional per-tick processing of the mixed force, before dithering: a notch (gear
+// rattle, a resonance), a low-pass (grain), a slew-rate limit (jolts) and a soft clip
+// that bends into --max instead of cutting at it. Each stage is a few doubles of state
+// held inline, so a tick never allocates. The biquads are designed for the --rate tick
+// and only stepped on timer ticks: the outputs --event writes on receive, in between,
+// reuse their last value, so the notch and low-pass stay at the configured frequencies.
+// The slew limit and the soft clip run on every output (the slew from the actual dt).
+
+struct ForceFilterConfig {
+    var lowPassHz: Double? = nil
+    var lowPassQ: Double = 0.7071 // Butterworth
+    var notchHz: Double? = nil
+    var notchQ: Double = 2
+    /// Full scales per second.
+    var slewPerS: Double? = nil
+    /// Fraction of --max where the soft clip starts to bend, 0...1.
+    var softClipKnee: Double? = nil
+
+    var isEmpty: Bool { lowPassHz == nil && notchHz == nil && slewPerS == nil && softClipKnee == nil }
+
+    var description: String {
+        var parts: [String] = []
+        if let notchHz { parts.append(String(format: "notch=%.0fHz/Q%.1f", notchHz, notchQ)) }
+        if let lowPassHz { parts.append(String(format: "lowpass=%.0fHz/Q%.2f", lowPassHz, lowPassQ)) }
+        if let slewPerS { parts.append(String(format: "slew=%.1f/s", slewPerS)) }
+        if let softClipKnee { parts.append(String(format: "softclip=%.2f", softClipKnee)) }
+        return parts.joined(separator: " ")
+    }
+}
+
+/// Second-order section, transposed direct form II, coefficients from the RBJ cookbook.
+struct Biquad {
+    private let b0, b1, b2, a1, a2: Double
+    private var z1 = 0.0, z2 = 0.0
+
+    private init(b0: Double, b1: Double, b2: Double, a0: Double, a1: Double, a2: Double) {
+        self.b0 = b0 / a0
+        self.b1 = b1 / a0
+        self.b2 = b2 / a0
+        self.a1 = a1 / a0
+        self.a2 = a2 / a0
+    }
+
+    /// Frequencies are kept below Nyquist, where the design breaks down.
+    private static func omega(_ hz: Double, _ sampleRate: Double) -> Double {
+        2 * .pi * max(1, min(hz, 0.45 * sampleRate)) / sampleRate
+    }
+
+    static func lowPass(hz: Double, q: Double, sampleRate: Double) -> Biquad {
+        let w = omega(hz, sampleRate)
+        let alpha = sin(w) / (2 * max(0.1, q))
+        let c = cos(w)
+        return Biquad(b0: (1 - c) / 2, b1: 1 - c, b2: (1 - c) / 2, a0: 1 + alpha, a1: -2 * c, a2: 1 - alpha)
+    }
+
+    static func notch(hz: Double, q: Double, sampleRate: Double) -> Biquad {
+        let w = omega(hz, sampleRate)
+        let alpha = sin(w) / (2 * max(0.1, q))
+        let c = cos(w)
+        return Biquad(b0: 1, b1: -2 * c, b2: 1, a0: 1 + alpha, a1: -2 * c, a2: 1 - alpha)
+    }
+
+    mutating func process(_ x: Double) -> Double {
+        let y = b0 * x + z1
+        z1 = b1 * x - a1 * y + z2
+        z2 = b2 * x - a2 * y
+        return y
+    }
+
+    mutating func reset() {
+        z1 = 0
+        z2 = 0
+    }
+}
+
+struct ForceFilterChain {
+    /// Below this the output is 0, so a decaying filter tail still ends in a stop report.
+    static let floor = 1e-6
+
+    private var notch: Biquad?
+    private var lowPass: Biquad?
+    private let slewPerS: Double?
+    private let knee: Double?
+    private let limit: Double
+    private let interval: Double
+    private var last = 0.0
+    /// Output of the biquads at the last timer tick.
+    private var held = 0.0
+
+    /// `limit` is --max in mixer units (1 = one full-scale effect).
+    init(_ config: ForceFilterConfig, sampleRate: Double, limit: Double) {
+        notch = config.notchHz.map { Biquad.notch(hz: $0, q: config.notchQ, sampleRate: sampleRate) }
+        lowPass = config.lowPassHz.map { Biquad.lowPass(hz: $0, q: config.lowPassQ, sampleRate: sampleRate) }
+        slewPerS = config.slewPerS.map { max(0, $0) }
+        knee = config.softClipKnee.map { max(0, min(0.99, $0)) }
+        self.limit = limit
+        interval = 1 / sampleRate
+    }
+
+    /// One output; `dt` is the time since the previous one (0 on the first). `tick` is
+    /// false for an output between timer ticks, which does not step the biquads.
+    mutating func process(_ x: Double, dt: Double, tick: Bool) -> Double {
+        var v = x
+        if notch != nil || lowPass != nil {
+            if tick {
+                if let y = notch?.process(v) { v = y }
+                if let y = lowPass?.process(v) { v = y }
+                held = v
+            } else {
+                v = held
+            }
+        }
+        if let slewPerS {
+            let step = slewPerS * (dt > 0 ? dt : interval)
+            v = last + max(-step, min(step, v - last))
+        }
+        if let knee {
+            v = softClip(v, knee: knee)
+        }
+        if abs(v) < Self.floor { v = 0 }
+        last = v
+        return v
+    }
+
+    /// Linear up to `knee * limit`, then a tanh bend that reaches `limit` asymptotically
+    /// with a continuous slope.
+    private func softClip(_ x: Double, knee: Double) -> Double {
+        let a = abs(x) / limit
+        if a <= knee { return x }
+        let bent = knee + (1 - knee) * tanh((a - knee) / (1 - knee))
+        return x < 0 ? -bent * limit : bent * limit
+    }
+
+    mutating func reset() {
+        notch?.reset()
+        lowPass?.reset()
+        last = 0
+        held = 0
+    }
+}
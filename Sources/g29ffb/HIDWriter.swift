@@ -0,0 +1,226 @@
+// Sources/g29ffb/HIDWriter.swift
+
+import Foundation
+@preconcurrency import IOKit.hid
+
+// MARK: - Asynchronous HID output
+// IOHIDDeviceSetReport is a blocking USB control transfer. The writer owns it on a thread
+// of its own, so a slow transfer never holds up the host queue (ticks, watchdog, UDP).
+// The host posts into a single slot: a report not yet written when the next one arrives
+// is replaced, since every force report is an absolute level and only the newest matters.
+// Slot commands (firmware effects, default spring) are queued instead and always written,
+// in order, before the pending force report. The queue is bounded and the host never waits
+// on it: when it is full the host keeps its slot state and tries again on a later tick.
+
+/// Where output reports go: the wheel, or a recording for `--check-slots`.
+protocol HIDReportSink: AnyObject {
+    /// Writes one output report of `count` bytes; returns the IOReturn, 0 on success.
+    func write(_ report: UnsafePointer<UInt8>, count: Int) -> Int32
+}
+
+final class IOHIDReportSink: HIDReportSink {
+    private let device: IOHIDDevice
+    private let reportID: UInt8
+
+    init(device: IOHIDDevice, reportID: UInt8) {
+        self.device = device
+        self.reportID = reportID
+    }
+
+    func write(_ report: UnsafePointer<UInt8>, count: Int) -> Int32 {
+        IOHIDDeviceSetReport(device, kIOHIDReportTypeOutput, CFIndex(reportID), report, count)
+    }
+}
+
+/// What the writer has done since start, for the metrics (`STATS`, --stats-file).
+struct HIDWriterStats {
+    static let failureCodeSlots = 8
+
+    var written: UInt64 = 0
+    var replaced: UInt64 = 0
+    var failed: UInt64 = 0
+    /// Commands (or slot updates) that did not fit the command queue and were put off.
+    var commandOverflows: UInt64 = 0
+    /// Failures by IOReturn, in order of first occurrence; codes past the table count as `otherFailures`.
+    private(set) var failureCodes = ContiguousArray<Int32>(repeating: 0, count: HIDWriterStats.failureCodeSlots)
+    private(set) var failureCounts = ContiguousArray<UInt64>(repeating: 0, count: HIDWriterStats.failureCodeSlots)
+    private(set) var otherFailures: UInt64 = 0
+    /// Time spent inside the write, every report.
+    var writeTime = LatencyHistogram()
+
+    mutating func recordFailure(_ code: Int32) {
+        failed &+= 1
+        for i in 0..<Self.failureCodeSlots {
+            if failureCounts[i] == 0 { failureCodes[i] = code }
+            if failureCodes[i] == code {
+                failureCounts[i] &+= 1
+                return
+            }
+        }
+        otherFailures &+= 1
+    }
+
+    /// Copies `other` into this value's own storage, so neither side allocates on its next update.
+    mutating func assign(_ other: HIDWriterStats) {
+        written = other.written
+        replaced = other.replaced
+        failed = other.failed
+        commandOverflows = other.commandOverflows
+        for i in 0..<Self.failureCodeSlots {
+            failureCodes[i] = other.failureCodes[i]
+            failureCounts[i] = other.failureCounts[i]
+        }
+        otherFailures = other.otherFailures
+        writeTime.assign(other.writeTime)
+    }
+}
+
+final class HIDWriter: @unchecked Sendable {
+    static let commandCapacity = 16
+
+    private let sink: HIDReportSink
+    private let size: Int
+
+    private let condition = NSCondition()
+    // Guarded by `condition`.
+    private let slot: UnsafeMutablePointer<UInt8>
+    private var slotFull = false
+    private var slotDecidedNs: UInt64 = 0
+    private var slotReceivedNs: UInt64 = 0
+    private let commands: UnsafeMutablePointer<UInt8> // commandCapacity reports, FIFO
+    private var commandHead = 0
+    private var commandCount = 0
+    private var hid = LatencyHistogram()
+    private var total = LatencyHistogram()
+    private var totals = HIDWriterStats()
+
+    // Writer thread only.
+    private let transfer: UnsafeMutablePointer<UInt8>
+
+    /// `size` is the device's output report size; payloads shorter than it are zero-padded.
+    init(sink: HIDReportSink, size: Int) {
+        self.sink = sink
+        self.size = max(classicPayloadSize, size)
+        self.slot = .allocate(capacity: self.size)
+        self.slot.initialize(repeating: 0x00, count: self.size)
+        self.commands = .allocate(capacity: Self.commandCapacity * classicPayloadSize)
+        self.commands.initialize(repeating: 0x00, count: Self.commandCapacity * classicPayloadSize)
+        self.transfer = .allocate(capacity: self.size)
+        self.transfer.initialize(repeating: 0x00, count: self.size)
+    }
+
+    func start() {
+        let thread = Thread { [self] in run() }
+        thread.name = "g29ffb.hid"
+        thread.qualityOfService = .userInteractive
+        thread.start()
+    }
+
+    /// Writes a payload on the caller's thread. Only for setup, before `start()`.
+    func writeNow(_ payload: UnsafePointer<UInt8>) {
+        slot.update(from: payload, count: classicPayloadSize)
+        _ = sink.write(slot, count: size)
+    }
+
+    /// True when `count` commands fit the queue now. Only the host queue posts commands and
+    /// the writer only takes them out, so they still fit when posted. False is counted as
+    /// an overflow.
+    func reserveCommands(_ count: Int) -> Bool {
+        condition.lock()
+        defer { condition.unlock() }
+        guard commandCount + count <= Self.commandCapacity else {
+            totals.commandOverflows &+= 1
+            return false
+        }
+        return true
+    }
+
+    /// Queues a command that must reach the wheel (a slot download or stop): it is never
+    /// replaced, and goes out before the pending force report. Never waits: returns false,
+    /// and counts an overflow, when the queue is full.
+    @discardableResult
+    func postCommand(_ payload: UnsafePointer<UInt8>) -> Bool {
+        condition.lock()
+        guard commandCount < Self.commandCapacity else {
+            totals.commandOverflows &+= 1
+            condition.unlock()
+            return false
+        }
+        let i = (commandHead + commandCount) % Self.commandCapacity
+        (commands + i * classicPayloadSize).update(from: payload, count: classicPayloadSize)
+        commandCount += 1
+        condition.signal()
+        condition.unlock()
+        return true
+    }
+
+    /// Queues a payload for the writer thread, replacing one still waiting. The timestamps
+    /// (uptime ns, 0 if unknown) feed the hid and total latency stages.
+    func post(_ payload: UnsafePointer<UInt8>, decidedNs: UInt64, receivedNs: UInt64) {
+        condition.lock()
+        var receivedNs = receivedNs
+        if slotFull {
+            totals.replaced &+= 1
+            // This report also delivers the replaced one's update: keep the older receive time.
+            if slotReceivedNs != 0 && (receivedNs == 0 || slotReceivedNs < receivedNs) { receivedNs = slotReceivedNs }
+        }
+        slot.update(from: payload, count: classicPayloadSize)
+        slotDecidedNs = decidedNs
+        slotReceivedNs = receivedNs
+        slotFull = true
+        condition.signal()
+        condition.unlock()
+    }
+
+    /// Moves the writer's latency samples into `hid`/`total` and gives it theirs back.
+    func takeLatency(hid: inout LatencyHistogram, total: inout LatencyHistogram) {
+        condition.lock()
+        swap(&self.hid, &hid)
+        swap(&self.total, &total)
+        condition.unlock()
+    }
+
+    func counters() -> (written: UInt64, replaced: UInt64, failed: UInt64) {
+        condition.lock()
+        defer { condition.unlock() }
+        return (totals.written, totals.replaced, totals.failed)
+    }
+
+    /// Copies the cumulative counters into `into`, which the caller keeps between calls.
+    func stats(into: inout HIDWriterStats) {
+        condition.lock()
+        into.assign(totals)
+        condition.unlock()
+    }
+
+    private func run() {
+        condition.lock()
+        while true {
+            while !slotFull && commandCount == 0 { condition.wait() }
+            var decidedNs: UInt64 = 0
+            var receivedNs: UInt64 = 0
+            if commandCount > 0 {
+                // Bytes past the payload stay zero: only the first classicPayloadSize are ever written.
+                transfer.update(from: commands + commandHead * classicPayloadSize, count: classicPayloadSize)
+                commandHead = (commandHead + 1) % Self.commandCapacity
+                commandCount -= 1
+            } else {
+                transfer.update(from: slot, count: size)
+                decidedNs = slotDecidedNs
+                receivedNs = slotReceivedNs
+                slotFull = false
+            }
+            condition.unlock()
+
+            let startNs = DispatchTime.now().uptimeNanoseconds
+            let status = sink.write(transfer, count: size)
+            let doneNs = DispatchTime.now().uptimeNanoseconds
+
+            condition.lock()
+            if status == 0 { totals.written &+= 1 } else { totals.recordFailure(status) }
+            totals.writeTime.record(doneNs &- startNs)
+            if decidedNs != 0 { hid.record(doneNs &- decidedNs) }
+            if receivedNs != 0 { total.record(doneNs &- receivedNs) }
+        }
+    }
+}
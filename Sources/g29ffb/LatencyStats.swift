@@ -0,0 +1,115 @@
+// Sources/g29ffb/LatencyStats.swift
+
+import Foundation
+
+// MARK: - Latency histograms (--latency)
+// Where a force spends its time between the game and the motor. Every sample is recorded
+// into a fixed log-linear table, so recording costs a few instructions and never allocates.
+// The histograms themselves take no lock: the wire and queue stages are recorded and
+// reported on the host queue, while the hid and total stages are recorded by the writer
+// thread under its condition lock, which it already holds for its counters after every
+// write, and swapped out to the host queue under the same lock (HIDWriter.takeLatency).
+
+/// HDR-style histogram of nanosecond durations: 8 linear sub-buckets per power of two, so
+/// percentiles are within 12.5% of the exact value from 1 ns up to several minutes.
+struct LatencyHistogram {
+    private static let subBits = 3
+    private static let subBuckets = 1 << subBits
+    private static let bucketCount = (64 - subBits + 1) << subBits
+
+    private var counts = ContiguousArray<UInt64>(repeating: 0, count: LatencyHistogram.bucketCount)
+    private(set) var count: UInt64 = 0
+    private(set) var maxNs: UInt64 = 0
+    private var sumNs: Double = 0
+
+    private static func index(_ ns: UInt64) -> Int {
+        if ns < UInt64(subBuckets) { return Int(ns) }
+        let shift = (63 - ns.leadingZeroBitCount) - subBits
+        return ((shift + 1) << subBits) + Int((ns >> UInt64(shift)) & UInt64(subBuckets - 1))
+    }
+
+    /// Largest value that lands in bucket `i`.
+    private static func upperBound(_ i: Int) -> UInt64 {
+        if i < subBuckets { return UInt64(i) }
+        let shift = (i >> subBits) - 1
+        let sub = UInt64(i & (subBuckets - 1)) | UInt64(subBuckets)
+        return ((sub + 1) &<< UInt64(shift)) &- 1
+    }
+
+    mutating func record(_ ns: UInt64) {
+        counts[Self.index(ns)] &+= 1
+        count &+= 1
+        sumNs += Double(ns)
+        if ns > maxNs { maxNs = ns }
+    }
+
+    var meanNs: Double { count == 0 ? 0 : sumNs / Double(count) }
+
+    /// Upper bound of the bucket holding the `p`-th fraction of samples (p in 0...1).
+    func percentileNs(_ p: Double) -> UInt64 {
+        if count == 0 { return 0 }
+        let rank = UInt64((p * Double(count)).rounded(.up))
+        var seen: UInt64 = 0
+        for i in 0..<counts.count where counts[i] != 0 {
+            seen += counts[i]
+            if seen >= max(1, rank) { return min(Self.upperBound(i), maxNs) }
+        }
+        return maxNs
+    }
+
+    /// Copies `other` bucket by bucket, so this histogram keeps its own storage and a
+    /// later `record` on either one does not copy the table.
+    mutating func assign(_ other: LatencyHistogram) {
+        for i in 0..<counts.count { counts[i] = other.counts[i] }
+        count = other.count
+        maxNs = other.maxNs
+        sumNs = other.sumNs
+    }
+
+    mutating func reset() {
+        for i in 0..<counts.count { counts[i] = 0 }
+        count = 0
+        maxNs = 0
+        sumNs = 0
+    }
+}
+
+/// The four timestamps of a force: the proxy's SetParameters hook (wire timestamp), UDP
+/// receipt, the tick that mixed it, and the return of IOHIDDeviceSetReport.
+struct LatencyStats {
+    /// SetParameters -> UDP receipt. The proxy's clock is not ours, so this is measured
+    /// relative to the fastest packet seen: the constant part of the delay is not included.
+    var wire = LatencyHistogram()
+    /// UDP receipt -> the tick that mixed the update (the oldest unconsumed one).
+    var queue = LatencyHistogram()
+    /// Tick decision -> IOHIDDeviceSetReport returned, for every report written.
+    var hid = LatencyHistogram()
+    /// UDP receipt -> IOHIDDeviceSetReport returned, for ticks that wrote a new update.
+    var total = LatencyHistogram()
+
+    private var minClockOffsetNs: Int64 = .max
+
+    mutating func recordWire(senderUs: UInt64, receivedNs: UInt64) {
+        let offset = Int64(bitPattern: receivedNs &- senderUs &* 1000)
+        if offset < minClockOffsetNs { minClockOffsetNs = offset }
+        wire.record(UInt64(offset - minClockOffsetNs))
+    }
+
+    func report() -> String {
+        var lines = ["[latency] stage       samples      p50      p99    p99.9      max     mean (us)"]
+        for (name, h) in [("wire", wire), ("queue", queue), ("hid", hid), ("total", total)] {
+            lines.append(String(format: "[latency] %-8@ %10llu %8.1f %8.1f %8.1f %8.1f %8.1f",
+                                name as NSString, h.count,
+                                Double(h.percentileNs(0.5)) / 1e3, Double(h.percentileNs(0.99)) / 1e3,
+                                Double(h.percentileNs(0.999)) / 1e3, Double(h.maxNs) / 1e3, h.meanNs / 1e3))
+        }
+        return lines.joined(separator: "\n")
+    }
+
+    mutating func reset() {
+        wire.reset()
+        queue.reset()
+        hid.reset()
+        total.reset()
+    }
+}
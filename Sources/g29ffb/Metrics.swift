@@ -0,0 +1,99 @@
+// Sources/g29ffb/Metrics.swift
+
+import Foundation
+
+// MARK: - Runtime metrics (STATS, --stats-file)
+// Counters that are always on, unlike --latency, and never reset: what came in, what was
+// dropped and why, how the ticks keep time and what the wheel's writes returned. They are
+// plain integers and a fixed histogram updated on the host queue, so counting takes no lock
+// and never allocates; only formatting a report does. A report is one `name value` per
+// line, sent back to a `STATS` datagram on the UDP port and, with --stats-file, rewritten
+// every --stats-every seconds.
+
+struct DaemonMetrics {
+    /// Datagrams received, UDP and shared memory (shared-memory doorbells excluded).
+    var datagrams: UInt64 = 0
+    /// Decoded binary wire packets.
+    var parsed: UInt64 = 0
+    /// Text commands (STOP, CONST, STATS).
+    var text: UInt64 = 0
+    /// Binary datagrams that did not decode (version, size) and unknown text commands.
+    var rejected: UInt64 = 0
+    /// Packets skipped because a newer one for the same effect arrived in the same batch.
+    var superseded: UInt64 = 0
+    /// Reports not posted because they repeated the last one.
+    var elided: UInt64 = 0
+    var reportsPosted: UInt64 = 0
+    /// Lease renewals (wire heartbeats).
+    var heartbeats: UInt64 = 0
+    /// Times the watchdog stopped the force after updates and heartbeats ceased.
+    var watchdogTrips: UInt64 = 0
+    var ticks: UInt64 = 0
+    /// How much longer than the --rate interval each timer tick came after the previous one.
+    var tickLate = LatencyHistogram()
+}
+
+/// Formats one report. Runs on the host queue, so the host's counters are read as they are.
+/// Sequence counters are summed over all sessions, closed ones included; each open session
+/// adds a few lines of its own under its name.
+func metricsReport(_ m: DaemonMetrics, sessions: SessionTable, writer w: HIDWriterStats, uptimeS: Double) -> String {
+    var lines: [String] = []
+    func add(_ name: String, _ value: UInt64) { lines.append("\(name) \(value)") }
+    func addUs(_ name: String, _ ns: UInt64) { lines.append(String(format: "%@ %.1f", name as NSString, Double(ns) / 1e3)) }
+
+    lines.append(String(format: "uptime_s %.1f", uptimeS))
+    add("datagrams", m.datagrams)
+    add("packets_parsed", m.parsed)
+    add("packets_text", m.text)
+    add("packets_rejected", m.rejected)
+    add("packets_superseded", m.superseded)
+    let sequence = sessions.sequenceTotals()
+    add("seq_lost", sequence.lost)
+    add("seq_stale", sequence.stale)
+    add("seq_restarts", sequence.restarts)
+    add("sessions_open", UInt64(sessions.openCount))
+    add("sessions_active", UInt64(sessions.activeCount))
+    add("sessions_opened", sessions.opened)
+    add("sessions_full", sessions.full)
+    add("session_switches", sessions.switches)
+    sessions.forEachOpen { s in
+        add("session_\(s.name)_priority", UInt64(s.priority))
+        add("session_\(s.name)_active", s.active ? 1 : 0)
+        add("session_\(s.name)_on_wheel", s.weight > 0 ? 1 : 0)
+        add("session_\(s.name)_seq_lost", s.sequence.lost)
+    }
+    add("heartbeats", m.heartbeats)
+    add("watchdog_trips", m.watchdogTrips)
+    add("ticks", m.ticks)
+    addUs("tick_late_p50_us", m.tickLate.percentileNs(0.5))
+    addUs("tick_late_p99_us", m.tickLate.percentileNs(0.99))
+    addUs("tick_late_p999_us", m.tickLate.percentileNs(0.999))
+    addUs("tick_late_max_us", m.tickLate.maxNs)
+    add("reports_posted", m.reportsPosted)
+    add("reports_elided", m.elided)
+    add("hid_written", w.written)
+    add("hid_replaced", w.replaced)
+    add("hid_failed", w.failed)
+    add("hid_command_overflows", w.commandOverflows)
+    for i in 0..<HIDWriterStats.failureCodeSlots where w.failureCounts[i] > 0 {
+        add(String(format: "hid_failed_0x%08x", UInt32(bitPattern: w.failureCodes[i])), w.failureCounts[i])
+    }
+    if w.otherFailures > 0 { add("hid_failed_other", w.otherFailures) }
+    addUs("hid_write_p50_us", w.writeTime.percentileNs(0.5))
+    addUs("hid_write_p99_us", w.writeTime.percentileNs(0.99))
+    addUs("hid_write_p999_us", w.writeTime.percentileNs(0.999))
+    addUs("hid_write_max_us", w.writeTime.maxNs)
+    return lines.joined(separator: "\n") + "\n"
+}
+
+/// True for a `STATS` text datagram (any case, surrounding whitespace allowed), checked
+/// on the bytes before any String is made.
+func isStatsQuery(_ bytes: UnsafeRawBufferPointer) -> Bool {
+    var start = 0, end = bytes.count
+    func isSpace(_ b: UInt8) -> Bool { b == 0x20 || b == 0x09 || b == 0x0A || b == 0x0D || b == 0x00 }
+    while start < end && isSpace(bytes[start]) { start += 1 }
+    while end > start && isSpace(bytes[end - 1]) { end -= 1 }
+    guard end - start == 5 else { return false }
+    for (k, c) in "STATS".utf8.enumerated() where bytes[start + k] & 0xDF != c { return false }
+    return true
+}
@@ -0,0 +1,190 @@
+// Sources/g29ffb/PeriodicSynth.swift
+
+import Foundation
+
+// MARK: - Periodic effects (Sine / Square / Triangle / Sawtooth)
+// The proxy only forwards DIPERIODIC changes; the daemon generates the waveform at tick rate
+// from one precomputed cycle per shape. Active effects live in fixed-capacity
+// structure-of-arrays storage, and the per-tick kernel evaluates them four lanes at a time.
+
+enum PeriodicShape: Int, CaseIterable {
+    case sine, square, triangle, sawUp, sawDown
+
+    init?(_ type: WireEffectType) {
+        switch type {
+        case .sine: self = .sine
+        case .square: self = .square
+        case .triangle: self = .triangle
+        case .sawUp: self = .sawUp
+        case .sawDown: self = .sawDown
+        default: return nil
+        }
+    }
+
+    /// One cycle, -1...1, at phase x in [0, 1).
+    func value(at x: Double) -> Double {
+        switch self {
+        case .sine: return sin(2 * Double.pi * x)
+        case .square: return x < 0.5 ? 1 : -1
+        case .triangle:
+            if x < 0.25 { return 4 * x }
+            if x < 0.75 { return 2 - 4 * x }
+            return 4 * x - 4
+        case .sawUp: return 2 * x - 1
+        case .sawDown: return 1 - 2 * x
+        }
+    }
+}
+
+final class PeriodicSynth {
+    static let tableSize = 1024
+    static let capacity = 64
+
+    /// tableSize + 1 samples per shape; the guard sample repeats sample 0 so interpolation never wraps.
+    private let table: UnsafeMutablePointer<Float>
+    private static let stride = tableSize + 1
+
+    // Structure of arrays, `capacity` lanes each. Lanes at and beyond `count` are kept zeroed,
+    // so the kernel can always run whole 4-lane chunks.
+    private let phase: UnsafeMutablePointer<Float>     // cycles, [0, 1)
+    private let frequency: UnsafeMutablePointer<Float> // cycles per second
+    private let magnitude: UnsafeMutablePointer<Float> // 0...1
+    private let offset: UnsafeMutablePointer<Float>    // -1...1
+    private let tableBase: UnsafeMutablePointer<Int32> // shape.rawValue * stride
+    private let ids: UnsafeMutablePointer<UInt16>
+    private(set) var count = 0
+
+    init() {
+        let stride = Self.stride
+        // One spare sample past the last shape: a phase that rounds up to exactly 1.0 stays in bounds.
+        table = .allocate(capacity: PeriodicShape.allCases.count * stride + 1)
+        for shape in PeriodicShape.allCases {
+            let base = shape.rawValue * stride
+            for i in 0..<Self.tableSize {
+                table[base + i] = Float(shape.value(at: Double(i) / Double(Self.tableSize)))
+            }
+            table[base + Self.tableSize] = table[base]
+        }
+        table[PeriodicShape.allCases.count * stride] = 0
+
+        let n = Self.capacity
+        phase = .allocate(capacity: n); phase.initialize(repeating: 0, count: n)
+        frequency = .allocate(capacity: n); frequency.initialize(repeating: 0, count: n)
+        magnitude = .allocate(capacity: n); magnitude.initialize(repeating: 0, count: n)
+        offset = .allocate(capacity: n); offset.initialize(repeating: 0, count: n)
+        tableBase = .allocate(capacity: n); tableBase.initialize(repeating: 0, count: n)
+        ids = .allocate(capacity: n); ids.initialize(repeating: 0, count: n)
+    }
+
+    deinit {
+        table.deallocate()
+        phase.deallocate()
+        frequency.deallocate()
+        magnitude.deallocate()
+        offset.deallocate()
+        tableBase.deallocate()
+        ids.deallocate()
+    }
+
+    var isActive: Bool { count > 0 }
+
+    /// Applies a parameter snapshot. A newly started effect begins at its DIPERIODIC phase;
+    /// an update to a running effect keeps its phase so the waveform stays continuous.
+    func apply(_ p: WirePeriodicPacket) {
+        let lane = (0..<count).first { ids[$0] == p.effectID }
+        guard p.playing, let shape = PeriodicShape(p.effectType) else {
+            if let lane { remove(lane) }
+            return
+        }
+        let i: Int
+        if let lane {
+            i = lane
+        } else {
+            guard count < Self.capacity else { return }
+            i = count
+            count += 1
+            ids[i] = p.effectID
+            phase[i] = Float(p.phase) / 36000
+        }
+        let scale = Float(wireMagnitudeMax)
+        let gain = Float(p.gain) / scale
+        frequency[i] = p.periodUs > 0 ? Float(1_000_000 / Double(p.periodUs)) : 0
+        magnitude[i] = gain * Float(p.magnitude) / scale
+        offset[i] = gain * Float(p.offset) / scale
+        tableBase[i] = Int32(shape.rawValue * Self.stride)
+    }
+
+    /// Adds an effect directly (benchmarking / offline use).
+    func add(id: UInt16, shape: PeriodicShape, magnitude m: Float, offset o: Float, frequency f: Float, phase ph: Float) {
+        guard count < Self.capacity else { return }
+        let i = count
+        count += 1
+        ids[i] = id
+        phase[i] = ph
+        frequency[i] = f
+        magnitude[i] = m
+        offset[i] = o
+        tableBase[i] = Int32(shape.rawValue * Self.stride)
+    }
+
+    func removeAll() {
+        for i in 0..<count { clear(i) }
+        count = 0
+    }
+
+    private func remove(_ lane: Int) {
+        let last = count - 1
+        if lane != last {
+            ids[lane] = ids[last]
+            phase[lane] = phase[last]
+            frequency[lane] = frequency[last]
+            magnitude[lane] = magnitude[last]
+            offset[lane] = offset[last]
+            tableBase[lane] = tableBase[last]
+        }
+        clear(last)
+        count = last
+    }
+
+    private func clear(_ i: Int) {
+        ids[i] = 0
+        phase[i] = 0
+        frequency[i] = 0
+        magnitude[i] = 0
+        offset[i] = 0
+        tableBase[i] = 0
+    }
+
+    /// Advances every active effect by dt seconds and returns the summed sample (-1...1 per effect, unclamped).
+    func render(dt: Double) -> Double {
+        guard count > 0 else { return 0 }
+        let n = Float(Self.tableSize)
+        let step = SIMD4<Float>(repeating: Float(dt))
+        var total = SIMD4<Float>(repeating: 0)
+        var i = 0
+        while i < count {
+            var p = load4(phase + i) + load4(frequency + i) * step
+            p -= p.rounded(.down)
+            UnsafeMutableRawPointer(phase + i).storeBytes(of: p, as: SIMD4<Float>.self)
+
+            let pos = p * n
+            let whole = pos.rounded(.down)
+            let frac = pos - whole
+            var a = SIMD4<Float>()
+            var b = SIMD4<Float>()
+            for lane in 0..<4 {
+                let idx = Int(tableBase[i + lane]) + Int(whole[lane])
+                a[lane] = table[idx]
+                b[lane] = table[idx + 1]
+            }
+            total += load4(offset + i) + load4(magnitude + i) * (a + (b - a) * frac)
+            i += 4
+        }
+        return Double(total.sum())
+    }
+
+    @inline(__always)
+    private func load4(_ p: UnsafeMutablePointer<Float>) -> SIMD4<Float> {
+        UnsafeRawPointer(p).loadUnaligned(as: SIMD4<Float>.self)
+    }
+}
@@ -0,0 +1,81 @@
+// Sources/g29ffb/SelfCheck.swift
+
+import Foundation
+
+// MARK: - Self-check harness (--check-*)
+// What the --check-* modes share, so each of them only lists its cases: one "ok"/"FAIL"
+// line per check, the failure count and the exit status, option parsing, a deterministic
+// random source and the packets they feed in.
+
+struct SelfCheck {
+    private(set) var failures = 0
+
+    /// Prints the check's line; `detail` only on failure.
+    mutating func expect(_ name: String, _ ok: Bool, detail: @autoclosure () -> String = "") {
+        if ok {
+            print("  ok    \(name)")
+            return
+        }
+        failures += 1
+        let why = detail()
+        print("  FAIL  \(name)" + (why.isEmpty || why.hasPrefix("\n") ? why : ": \(why)"))
+    }
+
+    mutating func expect(_ name: String, _ got: Double, _ want: Double, tolerance: Double) {
+        if abs(got - want) <= tolerance {
+            print(String(format: "  ok    %@ (%.4f)", name as NSString, got))
+            return
+        }
+        expect(name, false, detail: String(format: "want %.4f +- %.4f, got %.4f", want, tolerance, got))
+    }
+
+    mutating func expect(_ name: String, _ got: [[UInt8]], _ want: [[UInt8]]) {
+        expect(name, got == want, detail: "\n        want \(want.map { hex(Data($0), max: $0.count) })"
+                                        + "\n        got  \(got.map { hex(Data($0), max: $0.count) })")
+    }
+
+    mutating func expect(_ name: String, _ got: [UInt8], _ want: [UInt8]) {
+        expect(name, [got], [want])
+    }
+
+    mutating func expect(_ name: String, _ got: Set<UInt16>, _ want: Set<UInt16>) {
+        expect(name, got == want, detail: "want \(want.sorted()) got \(got.sorted())")
+    }
+
+    /// Prints the verdict; exits non-zero if any check failed.
+    func finish() {
+        if failures > 0 {
+            print("\(failures) check(s) failed")
+            exit(1)
+        }
+        print("all checks passed")
+    }
+}
+
+/// Small deterministic generator, so two runs of a check print the same numbers.
+struct CheckRandom {
+    var state: UInt64 = 0x9E37_79B9_7F4A_7C15
+
+    mutating func next() -> Double {
+        state = state &* 6_364_136_223_846_793_005 &+ 1_442_695_040_888_963_407
+        return Double(state >> 11) / Double(1 << 53)
+    }
+}
+
+/// The positive integer after `name` in `args`, e.g. `--ticks 100`.
+func checkOption(_ args: [String], _ name: String) -> Int? {
+    guard let i = args.firstIndex(of: name), i + 1 < args.count, let n = Int(args[i + 1]), n > 0 else { return nil }
+    return n
+}
+
+/// A DICONDITION as the proxy sends it; coefficients and saturations default to full scale.
+func conditionPacket(_ type: WireEffectType, id: UInt16 = 1, playing: Bool = true, offset: Int16 = 0,
+                     positive: Int16 = 10000, negative: Int16 = 10000,
+                     positiveSaturation: UInt16 = 10000, negativeSaturation: UInt16 = 10000,
+                     deadband: UInt16 = 0, gain: UInt16 = 10000) -> WireConditionPacket {
+    let header = WireHeader(kind: .condition, size: WireConditionPacket.size, seq: 0, clientID: 0, priority: 0, timestampUs: 0)
+    return WireConditionPacket(header: header, effectID: id, effectType: type, playing: playing, offset: offset,
+                               positiveCoefficient: positive, negativeCoefficient: negative,
+                               positiveSaturation: positiveSaturation, negativeSaturation: negativeSaturation,
+                               deadband: deadband, gain: gain)
+}
@@ -0,0 +1,274 @@
+// Sources/g29ffb/Session.swift
+
+import Foundation
+
+// MARK: - Client sessions (--arbitrate, --client)
+// Every sender gets its own session: effect table, sequence numbers, clock offset,
+// watchdog and lease. A sender is known by the client ID in the wire header (the proxy
+// sends its process ID, so its UDP and shared-memory datagrams meet in one session) or,
+// when that is 0 (text commands, older senders), by its address. The table has a fixed
+// number of slots scanned linearly, so finding the session of a datagram is a few dozen
+// compares and never allocates; a slot and its mixer are created for the first sender
+// that needs them and reused after that sender goes away. Once per tick (and after each
+// batch) the table decides whose forces reach the wheel, see ArbitrationMode.
+
+enum ArbitrationMode: String, CaseIterable {
+    /// The first sender to become active keeps the wheel until its watchdog or lease runs out.
+    case exclusive
+    /// The active sender with the highest priority; on a tie, whoever has the wheel keeps it.
+    case priority
+    /// Every active sender, each scaled by its gain.
+    case sum
+}
+
+/// --client ID:PRIORITY[:GAIN[:WATCHDOG_MS]]: fixes what a client ID's packets would
+/// otherwise say (priority) or what the daemon would otherwise use (gain 1, --watchdog).
+struct ClientRule {
+    var clientID: UInt16
+    var priority: Int
+    var gain: Double = 1
+    var watchdogMs: Int?
+
+    init?(_ text: String) {
+        let parts = text.split(separator: ":", omittingEmptySubsequences: false)
+        guard parts.count >= 2, parts.count <= 4,
+              let id = UInt16(parts[0]), id != 0, let priority = Int(parts[1]) else { return nil }
+        clientID = id
+        self.priority = max(0, min(255, priority))
+        if parts.count >= 3 {
+            guard let gain = Double(parts[2]), gain >= 0 else { return nil }
+            self.gain = gain
+        }
+        if parts.count == 4 {
+            guard let ms = Int(parts[3]) else { return nil }
+            watchdogMs = max(50, ms)
+        }
+    }
+}
+
+final class ClientSession {
+    let mixer: EffectMixer
+    var sequence = WireSequenceTracker()
+    var clock = SenderClock()
+    /// Latest state update (not heartbeat); the watchdog runs from here.
+    var lastUpdateMs: UInt64 = 0
+    /// Until when the sender's heartbeats hold its state, 0 without a lease.
+    var leaseUntilMs: UInt64 = 0
+
+    /// "id<N>", "<ip>:<port>" or "shm"; also the prefix of its STATS lines.
+    fileprivate(set) var name = ""
+    /// 0-255, from the wire header unless a --client rule fixes it; text senders get 0.
+    fileprivate(set) var priority = 0
+    fileprivate(set) var gain = 1.0
+    fileprivate(set) var watchdogMs: UInt64 = 0
+    fileprivate var hasRule = false
+    /// Any datagram, heartbeats included.
+    fileprivate(set) var lastSeenMs: UInt64 = 0
+    fileprivate(set) var activeSinceMs: UInt64 = 0
+    /// Within its watchdog or lease at the last arbitration; active sessions are mixed.
+    fileprivate(set) var active = false
+    /// What its mix is scaled by on the wheel; 0 while another session has it.
+    fileprivate(set) var weight = 0.0
+
+    fileprivate init(upsample: UpsampleConfig) {
+        mixer = EffectMixer(upsample: upsample)
+    }
+
+    fileprivate func isLive(now: UInt64) -> Bool {
+        lastUpdateMs > 0 && now <= max(lastUpdateMs + watchdogMs, leaseUntilMs)
+    }
+}
+
+final class SessionTable {
+    static let capacity = 64
+    /// A session without a datagram for this long is closed and its slot freed.
+    static let idleCloseMs: UInt64 = 30_000
+
+    let mode: ArbitrationMode
+    let upsample: UpsampleConfig
+    private let watchdogMs: UInt64
+    private let rules: [UInt16: ClientRule]
+
+    /// Slot i is free when keys[i] is 0. Both arrays only grow, up to `capacity`.
+    private var keys = ContiguousArray<UInt64>()
+    private(set) var sessions = ContiguousArray<ClientSession>()
+    private var lastHit = 0
+
+    /// The session with the wheel (exclusive, priority) or the one ranked first (sum): its
+    /// conditions are the ones offloaded to the wheel's slots. nil while none is active.
+    private(set) var lead: Int?
+    private(set) var activeCount = 0
+    private(set) var openCount = 0
+    private(set) var opened: UInt64 = 0
+    /// Datagrams dropped because every slot belonged to an active sender.
+    private(set) var full: UInt64 = 0
+    /// Times the wheel went from one session to another.
+    private(set) var switches: UInt64 = 0
+    // Sequence counters of closed sessions, so the totals never go backwards.
+    private var closedLost: UInt64 = 0
+    private var closedStale: UInt64 = 0
+    private var closedRestarts: UInt64 = 0
+
+    init(mode: ArbitrationMode, upsample: UpsampleConfig, watchdogMs: Int, rules: [ClientRule]) {
+        self.mode = mode
+        self.upsample = upsample
+        self.watchdogMs = UInt64(watchdogMs)
+        var byID: [UInt16: ClientRule] = [:]
+        for rule in rules { byID[rule.clientID] = rule }
+        self.rules = byID
+        keys.reserveCapacity(Self.capacity)
+        sessions.reserveCapacity(Self.capacity)
+    }
+
+    subscript(i: Int) -> ClientSession { sessions[i] }
+
+    /// Index of the sender's session, opened on its first datagram; nil when the table is
+    /// full of active senders. `priority` is the header's, nil for text.
+    func lookup(clientID: UInt16, priority: UInt8?, source: sockaddr_in?, now: UInt64) -> Int? {
+        let key = Self.key(clientID: clientID, source: source)
+        var slot = -1
+        if lastHit < keys.count, keys[lastHit] == key {
+            slot = lastHit
+        } else {
+            var free = -1
+            for i in 0..<keys.count {
+                if keys[i] == key { slot = i; break }
+                if free < 0 && keys[i] == 0 { free = i }
+            }
+            if slot < 0 {
+                guard let i = free >= 0 ? free : freeSlot(now: now) else {
+                    full &+= 1
+                    return nil
+                }
+                open(i, key: key, clientID: clientID, source: source)
+                slot = i
+            }
+            lastHit = slot
+        }
+        let s = sessions[slot]
+        s.lastSeenMs = now
+        if let priority, !s.hasRule { s.priority = Int(priority) }
+        return slot
+    }
+
+    /// Once per tick and after each batch: ends lapsed leases, closes idle sessions and
+    /// decides which sessions are mixed and with what weight. Returns true when the lead
+    /// changed (the host then moves the offloaded conditions).
+    func arbitrate(now: UInt64) -> Bool {
+        var best: Int?
+        activeCount = 0
+        for i in 0..<sessions.count where keys[i] != 0 {
+            let s = sessions[i]
+            s.weight = 0
+            s.active = s.isLive(now: now)
+            guard s.active else {
+                if s.leaseUntilMs != 0 {
+                    s.leaseUntilMs = 0
+                    print("[daemon] \(s.name): lease expired, no heartbeat for the lease period")
+                }
+                s.activeSinceMs = 0
+                if now &- s.lastSeenMs > Self.idleCloseMs { close(i) }
+                continue
+            }
+            activeCount += 1
+            if s.activeSinceMs == 0 { s.activeSinceMs = now }
+            if mode == .sum { s.weight = s.gain }
+            if best == nil || outranks(i, best!) { best = i }
+        }
+        if let best, mode != .sum { sessions[best].weight = sessions[best].gain }
+        guard best != lead else { return false }
+        if best != nil && lead != nil { switches &+= 1 }
+        lead = best
+        return true
+    }
+
+    func sequenceTotals() -> (lost: UInt64, stale: UInt64, restarts: UInt64) {
+        var lost = closedLost, stale = closedStale, restarts = closedRestarts
+        for i in 0..<sessions.count where keys[i] != 0 {
+            lost &+= sessions[i].sequence.lost
+            stale &+= sessions[i].sequence.stale
+            restarts &+= sessions[i].sequence.restarts
+        }
+        return (lost, stale, restarts)
+    }
+
+    /// Open sessions in slot order.
+    func forEachOpen(_ body: (ClientSession) -> Void) {
+        for i in 0..<sessions.count where keys[i] != 0 { body(sessions[i]) }
+    }
+
+    private static func key(clientID: UInt16, source: sockaddr_in?) -> UInt64 {
+        if clientID != 0 { return 1 << 48 | UInt64(clientID) }
+        if let source {
+            return 2 << 48 | UInt64(UInt32(bigEndian: source.sin_addr.s_addr)) << 16 | UInt64(UInt16(bigEndian: source.sin_port))
+        }
+        return 3 << 48 // shared memory from a sender without a client ID
+    }
+
+    /// Exclusive keeps the lead, then goes by who became active first; priority and sum
+    /// rank by priority before that.
+    private func outranks(_ a: Int, _ b: Int) -> Bool {
+        let sa = sessions[a], sb = sessions[b]
+        if mode != .exclusive, sa.priority != sb.priority { return sa.priority > sb.priority }
+        if a == lead || b == lead { return a == lead }
+        return sa.activeSinceMs < sb.activeSinceMs
+    }
+
+    /// A new slot while there is room, else the longest-idle inactive session's. A session
+    /// seen at `now` is never taken: it may have been opened earlier in the same batch, which
+    /// still holds its index (it only turns active at the next arbitration).
+    private func freeSlot(now: UInt64) -> Int? {
+        if sessions.count < Self.capacity {
+            sessions.append(ClientSession(upsample: upsample))
+            keys.append(0)
+            return sessions.count - 1
+        }
+        var victim: Int?
+        for i in 0..<sessions.count where !sessions[i].active && sessions[i].lastSeenMs < now {
+            if victim == nil || sessions[i].lastSeenMs < sessions[victim!].lastSeenMs { victim = i }
+        }
+        if let victim { close(victim) }
+        return victim
+    }
+
+    private func open(_ i: Int, key: UInt64, clientID: UInt16, source: sockaddr_in?) {
+        let s = sessions[i]
+        keys[i] = key
+        s.sequence = WireSequenceTracker()
+        s.clock = SenderClock()
+        s.lastUpdateMs = 0
+        s.leaseUntilMs = 0
+        s.activeSinceMs = 0
+        s.active = false
+        s.weight = 0
+        if clientID != 0 {
+            s.name = "id\(clientID)"
+        } else if let source {
+            let a = UInt32(bigEndian: source.sin_addr.s_addr)
+            s.name = "\(a >> 24).\(a >> 16 & 0xFF).\(a >> 8 & 0xFF).\(a & 0xFF):\(UInt16(bigEndian: source.sin_port))"
+        } else {
+            s.name = "shm"
+        }
+        let rule = clientID != 0 ? rules[clientID] : nil
+        s.hasRule = rule != nil
+        s.priority = rule?.priority ?? 0
+        s.gain = rule?.gain ?? 1
+        s.watchdogMs = rule?.watchdogMs.map { UInt64($0) } ?? watchdogMs
+        openCount += 1
+        opened &+= 1
+        print("[daemon] \(s.name): session opened (priority \(s.priority)" + (s.hasRule ? ", --client rule" : "") + ")")
+    }
+
+    private func close(_ i: Int) {
+        let s = sessions[i]
+        closedLost &+= s.sequence.lost
+        closedStale &+= s.sequence.stale
+        closedRestarts &+= s.sequence.restarts
+        s.mixer.reset()
+        s.active = false
+        s.weight = 0
+        keys[i] = 0
+        openCount -= 1
+        print("[daemon] \(s.name): session closed")
+    }
+}
@@ -0,0 +1,75 @@
+// Sources/g29ffb/ShmReceiver.swift
+
+import Foundation
+import CFFBShm
+
+// MARK: - Shared-memory transport (--shm)
+// Reads the ring the proxy writes into when started with FFB_SHM (clients/common/ffb_shm.h).
+// Draining it is a few loads and copies per datagram, without a syscall; the UDP socket
+// stays open for the proxy's fallback packets, the text protocol and doorbells.
+
+final class ShmReceiver {
+    static let batchSlots = 64
+    static let slotBytes = Int(FFB_SHM_SLOT_BYTES) - 4
+
+    private let header: UnsafeMutablePointer<FfbShmHeader>
+    private let mappedBytes: Int
+
+    // Allocated once, like UDPServer's.
+    private let buffer = UnsafeMutableRawPointer.allocate(byteCount: ShmReceiver.batchSlots * ShmReceiver.slotBytes, alignment: 16)
+    private let lengths = UnsafeMutablePointer<Int>.allocate(capacity: ShmReceiver.batchSlots)
+    private let stamps = UnsafeMutablePointer<UInt64>.allocate(capacity: ShmReceiver.batchSlots)
+
+    /// Creates (or reuses) the ring file and attaches as its reader. The file is never
+    /// truncated or replaced, so a proxy that mapped it earlier picks the new daemon up.
+    init(path: String) throws {
+        let fd = open(path, O_RDWR | O_CREAT, 0o666)
+        guard fd >= 0 else { throw NSError(domain: "open", code: Int(errno)) }
+        defer { close(fd) }
+
+        let size = MemoryLayout<FfbShmHeader>.size + Int(FFB_SHM_SLOTS) * MemoryLayout<FfbShmSlot>.size
+        var st = stat()
+        guard fstat(fd, &st) == 0 else { throw NSError(domain: "fstat", code: Int(errno)) }
+        if Int(st.st_size) < size, ftruncate(fd, off_t(size)) != 0 {
+            throw NSError(domain: "ftruncate", code: Int(errno))
+        }
+        guard let p = mmap(nil, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0), p != MAP_FAILED else {
+            throw NSError(domain: "mmap", code: Int(errno))
+        }
+        self.mappedBytes = size
+        self.header = p.bindMemory(to: FfbShmHeader.self, capacity: 1)
+        ffb_shm_attach(header)
+    }
+
+    deinit {
+        ffb_shm_detach(header)
+        munmap(UnsafeMutableRawPointer(header), mappedBytes)
+        buffer.deallocate()
+        lengths.deallocate()
+        stamps.deallocate()
+    }
+
+    /// Hands every pending datagram to `body`, oldest first, in batches of up to `batchSlots`.
+    func drain(_ body: (DatagramBatch) -> Void) {
+        while true {
+            var n = 0
+            while n < Self.batchSlots {
+                let got = ffb_shm_pop(header, buffer + n * Self.slotBytes, Int32(Self.slotBytes))
+                if got < 0 { break }
+                lengths[n] = Int(got)
+                stamps[n] = DispatchTime.now().uptimeNanoseconds
+                n += 1
+            }
+            if n > 0 {
+                body(DatagramBatch(base: buffer, stride: Self.slotBytes, lengths: lengths, stamps: stamps, count: n))
+            }
+            if n < Self.batchSlots { return }
+        }
+    }
+
+    /// Asks the proxy to send a doorbell datagram with its next push. Returns true when
+    /// entries arrived in the meantime; they will not ring, so drain again.
+    func requestWake() -> Bool {
+        ffb_shm_request_wake(header) != 0
+    }
+}
@@ -0,0 +1,131 @@
+// Sources/g29ffb/SlotCheck.swift
+
+import Foundation
+
+// MARK: - Report self-check (--check-slots)
+// Runs the Classic force builders, the slot allocator and the HID writer against a sink
+// that records every report, and compares the bytes with the ones expected, without a
+// wheel. Exits non-zero on any mismatch.
+
+/// Records reports instead of writing them to a device.
+final class MockHIDSink: HIDReportSink, @unchecked Sendable {
+    private let lock = NSLock()
+    private var reports: [[UInt8]] = []
+
+    func write(_ report: UnsafePointer<UInt8>, count: Int) -> Int32 {
+        lock.lock()
+        reports.append(Array(UnsafeBufferPointer(start: report, count: count)))
+        lock.unlock()
+        return 0
+    }
+
+    var count: Int {
+        lock.lock()
+        defer { lock.unlock() }
+        return reports.count
+    }
+
+    /// Returns the reports recorded so far and forgets them.
+    func take() -> [[UInt8]] {
+        lock.lock()
+        defer { lock.unlock() }
+        let r = reports
+        reports.removeAll()
+        return r
+    }
+}
+
+private func download(_ mask: UInt8, _ force: ClassicForce?) -> [UInt8] {
+    guard let force else { return [] }
+    return payloadDownloadPlayForce(slotMask: mask, force: force)
+}
+
+func runSlotCheck() {
+    var check = SelfCheck()
+
+    print("builders:")
+    let fullSpring = ClassicForce(condition: ConditionParams(conditionPacket(.spring))!, gain: 1, limit: 1)
+    check.expect("spring, full scale", download(0x02, fullSpring), [0x21, 0x0B, 0x80, 0x80, 0xFF, 0x00, 0xFF])
+    let soft = ClassicForce(condition: ConditionParams(conditionPacket(.spring, positive: 5000, negative: -3000,
+                                                                       positiveSaturation: 8000, negativeSaturation: 4000,
+                                                                       deadband: 1000, gain: 5000))!, gain: 1, limit: 1)
+    // Dead band 921...1126, k1 2 inverted, k2 4, clip 0.8 * 0.5.
+    check.expect("spring, dead band and inverted side", download(0x02, soft), [0x21, 0x0B, 0x73, 0x8C, 0x42, 0xC3, 0x66])
+    let limited = ClassicForce(condition: ConditionParams(conditionPacket(.spring))!, gain: 1, limit: 0.4)
+    check.expect("spring, clip capped by --max", download(0x02, limited), [0x21, 0x0B, 0x80, 0x80, 0xFF, 0x00, 0x66])
+    let fullDamper = ClassicForce(condition: ConditionParams(conditionPacket(.damper))!, gain: 1, limit: 1)
+    check.expect("damper", download(0x04, fullDamper), [0x41, 0x0C, 0x0F, 0x00, 0x0F, 0x00, 0xFF])
+    let someFriction = ClassicForce(condition: ConditionParams(conditionPacket(.friction, positive: 4000, negative: 4000))!, gain: 1, limit: 1)
+    check.expect("friction", download(0x08, someFriction), [0x81, 0x0E, 0x66, 0x66, 0xFF, 0x00, 0x00])
+    let inertia = ClassicForce(condition: ConditionParams(conditionPacket(.inertia))!, gain: 1, limit: 1)
+    check.expect("inertia stays on the host", download(0x02, inertia), [])
+    check.expect("default spring on", payloadDefaultSpringOn(slotMask: 0x0F), [0xF4, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00])
+
+    print("slot allocator:")
+    guard let spring = fullSpring, let damper = fullDamper, let friction = someFriction else {
+        print("condition builders returned nil")
+        exit(1)
+    }
+    let sink = MockHIDSink()
+    let slots = ForceSlotAllocator()
+    let emit: (UnsafePointer<UInt8>) -> Void = { _ = sink.write($0, count: classicPayloadSize) }
+
+    var placed = slots.update([(id: 1, force: spring), (id: 2, force: spring)], emit: emit)
+    check.expect("identical forces share one download", sink.take(), [download(0x06, spring)])
+    check.expect("both placed", placed, [1, 2])
+
+    placed = slots.update([(id: 1, force: spring), (id: 2, force: damper)], emit: emit)
+    check.expect("only the changed slot is downloaded", sink.take(), [download(0x04, damper)])
+
+    placed = slots.update([(id: 1, force: spring), (id: 2, force: damper)], emit: emit)
+    check.expect("no change, no report", sink.take(), [])
+
+    placed = slots.update([(id: 2, force: damper)], emit: emit)
+    check.expect("a freed slot is stopped", sink.take(), [[0x23, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00]])
+    check.expect("effect 2 keeps F2", placed, [2])
+
+    placed = slots.update([(id: 2, force: damper), (id: 3, force: spring), (id: 4, force: spring), (id: 5, force: friction)],
+                          emit: emit)
+    check.expect("new effects fill F1 and F3 in one report", sink.take(), [download(0x0A, spring)])
+    check.expect("the fourth effect stays on the host", placed, [2, 3, 4])
+
+    placed = slots.update([], emit: emit)
+    check.expect("one stop for every slot", sink.take(), [[0xE3, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00]])
+    check.expect("nothing placed", placed, [])
+
+    _ = slots.update([(id: 1, force: spring)], emit: emit)
+    _ = sink.take()
+    slots.reset()
+    _ = slots.update([(id: 1, force: spring)], emit: emit)
+    check.expect("reset downloads again", sink.take(), [download(0x02, spring)])
+
+    print("hid writer:")
+    let writerSink = MockHIDSink()
+    let writer = HIDWriter(sink: writerSink, size: 8)
+    let stopSlots: [UInt8] = [0xE3, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00]
+    let firstForce = payloadDownloadPlayConstantForce(slotMask: 0x01, f0: 0x90)
+    let secondForce = payloadDownloadPlayConstantForce(slotMask: 0x01, f0: 0xA0)
+    let springDownload = download(0x02, spring)
+    writer.post(firstForce, decidedNs: 0, receivedNs: 0)
+    writer.postCommand(stopSlots)
+    writer.post(secondForce, decidedNs: 0, receivedNs: 0)
+    writer.postCommand(springDownload)
+    writer.start()
+    let deadline = DispatchTime.now().uptimeNanoseconds + 1_000_000_000
+    while writerSink.count < 3 && DispatchTime.now().uptimeNanoseconds < deadline { sleepMs(1) }
+    // Reports are padded with zeros to the output report size.
+    check.expect("commands first, in order, then the newest force",
+                 writerSink.take(), [stopSlots + [0x00], springDownload + [0x00], secondForce + [0x00]])
+    check.expect("the replaced force is counted", [UInt8(writer.counters().replaced)], [1])
+
+    // Not started, so nothing drains the queue.
+    let fullWriter = HIDWriter(sink: MockHIDSink(), size: 8)
+    for _ in 0..<HIDWriter.commandCapacity { fullWriter.postCommand(stopSlots) }
+    check.expect("a full queue turns a command away", [fullWriter.postCommand(springDownload) ? 1 : 0], [0])
+    check.expect("and has no room for a slot update", [fullWriter.reserveCommands(1) ? 1 : 0], [0])
+    var fullStats = HIDWriterStats()
+    fullWriter.stats(into: &fullStats)
+    check.expect("both are counted", [UInt8(fullStats.commandOverflows)], [2])
+
+    check.finish()
+}
@@ -0,0 +1,201 @@
+// Sources/g29ffb/UpsampleCheck.swift
+
+import Foundation
+
+// MARK: - Resampler check (--check-upsample)
+// Replays one constant force through every --upsample mode at --rate, without a wheel,
+// and prints how far each output is from the ideal signal and how many reports it would
+// write. The trace is either synthetic (a known signal sent at an irregular game rate
+// with transport jitter) or a capture recorded with clients/ffb_replay, where the ideal
+// is the recorded stream joined by straight lines and --decimate N thins what the
+// resampler gets to every Nth packet. It then checks that every mode passes a steady
+// force through unchanged, in a single report, and exits non-zero if one does not.
+
+private struct TraceSample {
+    var sentNs: UInt64     // on the host clock
+    var receivedNs: UInt64
+    var playing: Bool
+    var value: Double      // magnitude * gain, -1...1
+}
+
+private struct Trace {
+    var name: String
+    var samples: [TraceSample]
+    var ideal: (Double) -> Double
+}
+
+/// Road feel (1.1 Hz sway, 6.3 Hz texture) and a kerb every 1.5 s.
+private func syntheticTrace() -> Trace {
+    irregularTrace(name: "synthetic") { t in
+        let kerb = t.truncatingRemainder(dividingBy: 1.5) < 0.3 ? 0.2 : 0
+        return 0.4 * sin(2 * .pi * 1.1 * t) + 0.15 * sin(2 * .pi * 6.3 * t + 1) + kerb
+    }
+}
+
+/// `f` sent every 8-25 ms and received 0.5-3 ms later.
+private func irregularTrace(name: String, _ f: @escaping (Double) -> Double) -> Trace {
+    var rng = CheckRandom()
+    var samples: [TraceSample] = []
+    var t = 1.0
+    while t < 11 {
+        let latency = 0.0005 + 0.0025 * rng.next()
+        samples.append(TraceSample(sentNs: UInt64(t * 1e9), receivedNs: UInt64((t + latency) * 1e9),
+                                   playing: true, value: f(t)))
+        t += 0.008 + 0.017 * rng.next()
+    }
+    // A packet is never received before the one sent ahead of it (one socket, one sender).
+    for i in 1..<samples.count where samples[i].receivedNs < samples[i - 1].receivedNs {
+        samples[i].receivedNs = samples[i - 1].receivedNs
+    }
+    return Trace(name: name, samples: samples, ideal: f)
+}
+
+/// Reads the constant force packets of one effect (the first one seen, or `effectID`)
+/// from a G29C capture (clients/common/ffb_capture.h).
+private func captureTrace(path: String, effectID: UInt16?) -> Trace? {
+    guard let data = FileManager.default.contents(atPath: path) else {
+        print("cannot read \(path)")
+        return nil
+    }
+    var samples: [TraceSample] = []
+    let ok: Bool = data.withUnsafeBytes { raw in
+        guard raw.count >= 16,
+              UInt32(littleEndian: raw.loadUnaligned(fromByteOffset: 0, as: UInt32.self)) == 0x4339_3247,
+              UInt16(littleEndian: raw.loadUnaligned(fromByteOffset: 4, as: UInt16.self)) == 1 else { return false }
+        var clock = SenderClock()
+        var id = effectID
+        var at = 16
+        while at + 12 <= raw.count {
+            let receivedNs = UInt64(littleEndian: raw.loadUnaligned(fromByteOffset: at, as: UInt64.self))
+            let len = Int(UInt16(littleEndian: raw.loadUnaligned(fromByteOffset: at + 8, as: UInt16.self)))
+            at += 12
+            guard at + len <= raw.count else { return false }
+            let bytes = UnsafeRawBufferPointer(rebasing: raw[at..<(at + len)])
+            at += len
+            guard case .effect(let p)? = decodeWirePacket(bytes), p.effectType == .constant else { continue }
+            if id == nil { id = p.effectID }
+            guard p.effectID == id else { continue }
+            let scale = Double(wireMagnitudeMax)
+            samples.append(TraceSample(sentNs: clock.hostNs(senderUs: p.header.timestampUs, receivedNs: receivedNs),
+                                       receivedNs: receivedNs, playing: p.playing,
+                                       value: p.playing ? Double(p.magnitude) / scale * (Double(p.gain) / scale) : 0))
+        }
+        return true
+    }
+    guard ok else {
+        print("\(path) is not a G29C capture (version 1)")
+        return nil
+    }
+    guard samples.count >= 2 else {
+        print("\(path) has fewer than two constant force packets\(effectID.map { " for effect \($0)" } ?? "")")
+        return nil
+    }
+    let times = samples.map { Double($0.sentNs) / 1e9 }
+    let values = samples.map { $0.value }
+    let ideal: (Double) -> Double = { t in
+        // Last sample at or before t, then a straight line to the next one.
+        var lo = 0, hi = times.count
+        while hi - lo > 1 {
+            let mid = (lo + hi) / 2
+            if times[mid] <= t { lo = mid } else { hi = mid }
+        }
+        guard lo + 1 < times.count, times[lo] <= t else { return values[lo] }
+        let span = times[lo + 1] - times[lo]
+        guard span > 0 else { return values[lo + 1] }
+        return values[lo] + (values[lo + 1] - values[lo]) * (t - times[lo]) / span
+    }
+    return Trace(name: (path as NSString).lastPathComponent, samples: samples, ideal: ideal)
+}
+
+private struct UpsampleResult {
+    var rms = 0.0
+    var maxError = 0.0
+    var reports = 0
+}
+
+/// Runs the ticks the daemon would, from the first packet received to 100 ms after the
+/// last, and compares each with the ideal at the same instant.
+private func replay(_ trace: Trace, config: UpsampleConfig, rateHz: Int, decimate: Int) -> UpsampleResult {
+    var result = UpsampleResult()
+    var level: ForceUpsampler?
+    var next = 0
+    var kept = 0
+    var lastReport: Int?
+    var sumSquares = 0.0
+    var ticks = 0
+    let step = 1.0 / Double(rateHz)
+    var t = Double(trace.samples[0].receivedNs) / 1e9
+    let end = Double(trace.samples[trace.samples.count - 1].receivedNs) / 1e9 + 0.1
+    while t < end {
+        while next < trace.samples.count, Double(trace.samples[next].receivedNs) / 1e9 <= t {
+            let s = trace.samples[next]
+            let playingChanged = s.playing != (level != nil)
+            next += 1
+            kept += 1
+            // Starts and stops always get through; the rest is thinned.
+            guard playingChanged || kept % decimate == 0 else { continue }
+            let sent = Double(s.sentNs) / 1e9
+            if !s.playing {
+                level = nil
+            } else if level == nil {
+                level = ForceUpsampler(config, value: s.value, time: sent)
+            } else {
+                level!.push(s.value, time: sent)
+            }
+        }
+        let out = level?.sample(at: t) ?? 0
+        let error = abs(out - trace.ideal(t))
+        sumSquares += error * error
+        result.maxError = max(result.maxError, error)
+        ticks += 1
+        let report = Int((max(-1, min(1, out)) * 127).rounded())
+        if report != lastReport {
+            result.reports += 1
+            lastReport = report
+        }
+        t += step
+    }
+    result.rms = (sumSquares / Double(max(1, ticks))).squareRoot()
+    return result
+}
+
+func runUpsampleCheck(args: [String]) {
+    let cfg = parseHostConfig(args)
+    let rateHz = max(50, min(1000, cfg.rateHz))
+    let decimate = checkOption(args, "--decimate") ?? 1
+    let effectID = checkOption(args, "--effect").flatMap { UInt16(exactly: $0) }
+
+    let trace: Trace
+    if let i = args.firstIndex(of: "--check-upsample"), i + 1 < args.count, !args[i + 1].hasPrefix("--") {
+        guard let t = captureTrace(path: args[i + 1], effectID: effectID) else { exit(1) }
+        trace = t
+    } else {
+        trace = syntheticTrace()
+    }
+
+    let first = trace.samples[0], last = trace.samples[trace.samples.count - 1]
+    let seconds = Double(last.sentNs &- first.sentNs) / 1e9
+    print(String(format: "trace %@: %d packets over %.1f s (%.1f ms apart on average), every %d replayed at %d Hz, horizon %.0f ms",
+                 trace.name as NSString, trace.samples.count, seconds, seconds * 1000 / Double(trace.samples.count - 1),
+                 decimate, rateHz, cfg.upsample.horizon * 1000))
+    print("  mode         rms error   max error   reports   (error in % of full scale)")
+    for mode in UpsampleMode.allCases {
+        var config = cfg.upsample
+        config.mode = mode
+        let r = replay(trace, config: config, rateHz: rateHz, decimate: decimate)
+        print(String(format: "  %-11@ %10.2f %11.2f %9d", mode.rawValue as NSString, r.rms * 100, r.maxError * 100, r.reports))
+    }
+
+    // Whatever the mode, a steady force sent at an irregular rate must come out unchanged.
+    print("steady force:")
+    var check = SelfCheck()
+    let steady = irregularTrace(name: "steady") { _ in 0.5 }
+    for mode in UpsampleMode.allCases {
+        var config = cfg.upsample
+        config.mode = mode
+        let r = replay(steady, config: config, rateHz: rateHz, decimate: 1)
+        check.expect("\(mode.rawValue): exact, one report", r.maxError <= 1e-12 && r.reports == 1,
+                     detail: String(format: "max error %.6f, %d reports", r.maxError, r.reports))
+    }
+    check.finish()
+}
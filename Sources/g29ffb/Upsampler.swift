@@ -0,0 +1,103 @@
+// Sources/g29ffb/Upsampler.swift
+
+import Foundation
+
+// MARK: - Constant force resampling (--upsample)
+// The game sends a constant force whenever its physics step gets to it, at an irregular
+// rate of its own; the daemon writes the wheel at --rate. Each constant effect keeps its
+// last two samples, stamped with the proxy's send time, and every tick reads its value at
+// the tick's instant:
+//   hold         the latest sample, flat until the next one (the old behaviour);
+//   linear       a ramp from the current output to each new sample over the last sample
+//                interval, so the output is continuous at the cost of that interval of delay;
+//   extrapolate  the latest sample continued along the slope of the last two, which makes
+//                up for the transport latency, for at most --horizon past the sample.
+
+enum UpsampleMode: String, CaseIterable {
+    case hold
+    case linear
+    case extrapolate
+}
+
+struct UpsampleConfig {
+    var mode: UpsampleMode = .hold
+    /// Longest extrapolation, and longest linear ramp, in seconds.
+    var horizon: Double = 0.02
+}
+
+struct ForceUpsampler {
+    /// Two samples closer than this would turn jitter into a steep slope.
+    static let minInterval = 0.001
+
+    let config: UpsampleConfig
+    private var t0 = 0.0, v0 = 0.0 // previous sample
+    private var t1 = 0.0, v1 = 0.0 // latest sample
+    private var samples = 0
+    // linear: ramp from `rampFrom` at `rampStart` to v1 over `rampDuration`.
+    private var rampFrom = 0.0
+    private var rampStart = 0.0
+    private var rampDuration = 0.0
+
+    init(_ config: UpsampleConfig, value: Double, time: Double) {
+        self.config = config
+        t1 = time
+        v1 = value
+        rampFrom = value
+        rampStart = time
+        samples = 1
+    }
+
+    /// The newest sample, as held.
+    var latest: Double { v1 }
+
+    /// `time` is the sample's send time on the host clock (seconds). Samples that come
+    /// out of order are taken as sent with the previous one.
+    mutating func push(_ value: Double, time: Double) {
+        let t = max(time, t1)
+        if config.mode == .linear {
+            rampFrom = sample(at: t)
+            rampStart = t
+            rampDuration = min(t - t1, config.horizon)
+        }
+        t0 = t1
+        v0 = v1
+        t1 = t
+        v1 = value
+        samples += 1
+    }
+
+    /// Output at `time` (seconds, host clock), in the unit of the samples.
+    func sample(at time: Double) -> Double {
+        switch config.mode {
+        case .hold:
+            return v1
+        case .linear:
+            guard rampDuration > 0 else { return v1 }
+            let a = (time - rampStart) / rampDuration
+            if a >= 1 { return v1 }
+            if a <= 0 { return rampFrom }
+            return rampFrom + (v1 - rampFrom) * a
+        case .extrapolate:
+            guard samples > 1 else { return v1 }
+            let slope = (v1 - v0) / max(t1 - t0, Self.minInterval)
+            let ahead = min(max(time - t1, 0), config.horizon)
+            return max(-1, min(1, v1 + slope * ahead))
+        }
+    }
+}
+
+/// Maps the proxy's send timestamps onto the host clock. The fastest packet seen sets the
+/// offset, so the sample times keep the game's spacing instead of the transport's jitter.
+struct SenderClock {
+    /// A packet this much later than the fastest one means the proxy's clock moved
+    /// (new process, suspend): start over from it.
+    static let resyncNs: Int64 = 1_000_000_000
+
+    private var offsetNs = Int64.max
+
+    mutating func hostNs(senderUs: UInt64, receivedNs: UInt64) -> UInt64 {
+        let offset = Int64(bitPattern: receivedNs &- senderUs &* 1000)
+        if offset < offsetNs || offset - offsetNs > Self.resyncNs { offsetNs = offset }
+        return senderUs &* 1000 &+ UInt64(bitPattern: offsetNs)
+    }
+}
@@ -0,0 +1,262 @@
+// Sources/g29ffb/WireProtocol.swift
+
+import Foundation
+
+// MARK: - Binary wire protocol (mirrors clients/common/ffb_wire.h)
+// Packets are little-endian with fixed offsets. Anything that does not start with
+// the magic is handed to the text fallback ("CONST <n>" / "STOP").
+
+let wireMagic: UInt32 = 0x4639_3247 // "G29F"
+let wireVersion: UInt8 = 2
+let wireHeaderSize = 24
+let wireMagnitudeMax = 10000
+
+enum WireKind: UInt8 {
+    case effect = 0x01
+    case condition = 0x02
+    case periodic = 0x03
+    case device = 0x04
+    case heartbeat = 0x05
+}
+
+enum WireEffectType: UInt8 {
+    case constant = 0x01
+    case ramp = 0x02
+    case spring = 0x03
+    case damper = 0x04
+    case friction = 0x05
+    case inertia = 0x06
+    case sine = 0x07
+    case square = 0x08
+    case triangle = 0x09
+    case sawUp = 0x0A
+    case sawDown = 0x0B
+    case custom = 0x0C
+}
+
+/// IDirectInputDevice8::SendForceFeedbackCommand and DIPROP_AUTOCENTER, as forwarded by the proxy.
+enum WireDeviceCommand: UInt8 {
+    case gainOnly = 0x00
+    case reset = 0x01
+    case stopAll = 0x02
+    case pause = 0x03
+    case `continue` = 0x04
+    case actuatorsOn = 0x05
+    case actuatorsOff = 0x06
+    case autoCenterOff = 0x07
+    case autoCenterOn = 0x08
+}
+
+struct WireHeader {
+    var kind: WireKind
+    var size: Int
+    var seq: UInt32
+    /// Sender's client ID, 0 when it has none (sessions then go by address).
+    var clientID: UInt16
+    /// Sender's arbitration priority, 0-255.
+    var priority: UInt8
+    var timestampUs: UInt64
+}
+
+/// Full snapshot of one effect (FfbWireEffect).
+struct WireEffectPacket {
+    static let size = wireHeaderSize + 8
+
+    var header: WireHeader
+    var effectID: UInt16
+    var effectType: WireEffectType
+    var playing: Bool
+    /// Direction already applied.
+    var magnitude: Int16
+    /// DIEFFECT.dwGain, 0...wireMagnitudeMax.
+    var gain: UInt16
+}
+
+/// Spring/Damper/Friction/Inertia parameters (FfbWireCondition), DirectInput units.
+struct WireConditionPacket {
+    static let size = wireHeaderSize + 20
+
+    var header: WireHeader
+    var effectID: UInt16
+    var effectType: WireEffectType
+    var playing: Bool
+    var offset: Int16
+    var positiveCoefficient: Int16
+    var negativeCoefficient: Int16
+    var positiveSaturation: UInt16
+    var negativeSaturation: UInt16
+    var deadband: UInt16
+    var gain: UInt16
+}
+
+/// Sine/Square/Triangle/Sawtooth parameters (FfbWirePeriodic).
+struct WirePeriodicPacket {
+    static let size = wireHeaderSize + 16
+
+    var header: WireHeader
+    var effectID: UInt16
+    var effectType: WireEffectType
+    var playing: Bool
+    var magnitude: UInt16
+    var offset: Int16
+    /// Hundredths of a degree.
+    var phase: UInt16
+    var gain: UInt16
+    var periodUs: UInt32
+}
+
+/// Device-wide command and gain (FfbWireDevice).
+struct WireDevicePacket {
+    static let size = wireHeaderSize + 8
+
+    var header: WireHeader
+    var command: WireDeviceCommand
+    /// DIPROP_FFGAIN, 0...wireMagnitudeMax.
+    var gain: UInt16
+}
+
+/// Liveness lease (FfbWireHeartbeat): the sender is alive and wants its state held.
+struct WireHeartbeatPacket {
+    static let size = wireHeaderSize + 8
+
+    var header: WireHeader
+    /// 0 ends the lease.
+    var leaseMs: UInt16
+}
+
+enum WirePacket {
+    case effect(WireEffectPacket)
+    case condition(WireConditionPacket)
+    case periodic(WirePeriodicPacket)
+    case device(WireDevicePacket)
+    case heartbeat(WireHeartbeatPacket)
+
+    var header: WireHeader {
+        switch self {
+        case .effect(let p): return p.header
+        case .condition(let p): return p.header
+        case .periodic(let p): return p.header
+        case .device(let p): return p.header
+        case .heartbeat(let p): return p.header
+        }
+    }
+}
+
+@inline(__always)
+private func le<T: FixedWidthInteger & BitwiseCopyable>(_ bytes: UnsafeRawBufferPointer, _ offset: Int, _: T.Type) -> T {
+    T(littleEndian: bytes.loadUnaligned(fromByteOffset: offset, as: T.self))
+}
+
+func wireHasMagic(_ bytes: UnsafeRawBufferPointer) -> Bool {
+    bytes.count >= 4 && le(bytes, 0, UInt32.self) == wireMagic
+}
+
+/// Decodes a binary datagram. Returns nil for text datagrams and for binary ones
+/// that are truncated, from another protocol version or of an unknown kind.
+func decodeWirePacket(_ bytes: UnsafeRawBufferPointer) -> WirePacket? {
+    guard bytes.count >= wireHeaderSize, wireHasMagic(bytes) else { return nil }
+    guard bytes[4] == wireVersion, let kind = WireKind(rawValue: bytes[5]) else { return nil }
+    let size = Int(le(bytes, 6, UInt16.self))
+    guard size <= bytes.count else { return nil }
+    let header = WireHeader(
+        kind: kind,
+        size: size,
+        seq: le(bytes, 8, UInt32.self),
+        clientID: le(bytes, 12, UInt16.self),
+        priority: bytes[14],
+        timestampUs: le(bytes, 16, UInt64.self)
+    )
+
+    switch kind {
+    case .effect:
+        guard size >= WireEffectPacket.size,
+              let type = WireEffectType(rawValue: bytes[wireHeaderSize + 2]) else { return nil }
+        return .effect(WireEffectPacket(
+            header: header,
+            effectID: le(bytes, wireHeaderSize, UInt16.self),
+            effectType: type,
+            playing: bytes[wireHeaderSize + 3] != 0,
+            magnitude: le(bytes, wireHeaderSize + 4, Int16.self),
+            gain: le(bytes, wireHeaderSize + 6, UInt16.self)
+        ))
+    case .condition:
+        guard size >= WireConditionPacket.size,
+              let type = WireEffectType(rawValue: bytes[wireHeaderSize + 2]) else { return nil }
+        let b = wireHeaderSize
+        return .condition(WireConditionPacket(
+            header: header,
+            effectID: le(bytes, b, UInt16.self),
+            effectType: type,
+            playing: bytes[b + 3] != 0,
+            offset: le(bytes, b + 4, Int16.self),
+            positiveCoefficient: le(bytes, b + 6, Int16.self),
+            negativeCoefficient: le(bytes, b + 8, Int16.self),
+            positiveSaturation: le(bytes, b + 10, UInt16.self),
+            negativeSaturation: le(bytes, b + 12, UInt16.self),
+            deadband: le(bytes, b + 14, UInt16.self),
+            gain: le(bytes, b + 16, UInt16.self)
+        ))
+    case .periodic:
+        guard size >= WirePeriodicPacket.size,
+              let type = WireEffectType(rawValue: bytes[wireHeaderSize + 2]) else { return nil }
+        let b = wireHeaderSize
+        return .periodic(WirePeriodicPacket(
+            header: header,
+            effectID: le(bytes, b, UInt16.self),
+            effectType: type,
+            playing: bytes[b + 3] != 0,
+            magnitude: le(bytes, b + 4, UInt16.self),
+            offset: le(bytes, b + 6, Int16.self),
+            phase: le(bytes, b + 8, UInt16.self),
+            gain: le(bytes, b + 10, UInt16.self),
+            periodUs: le(bytes, b + 12, UInt32.self)
+        ))
+    case .device:
+        guard size >= WireDevicePacket.size,
+              let command = WireDeviceCommand(rawValue: bytes[wireHeaderSize]) else { return nil }
+        return .device(WireDevicePacket(
+            header: header,
+            command: command,
+            gain: le(bytes, wireHeaderSize + 2, UInt16.self)
+        ))
+    case .heartbeat:
+        guard size >= WireHeartbeatPacket.size else { return nil }
+        return .heartbeat(WireHeartbeatPacket(header: header, leaseMs: le(bytes, wireHeaderSize, UInt16.self)))
+    }
+}
+
+/// Tracks the sender's sequence numbers to drop reordered/duplicate packets and count gaps.
+/// A backwards step is taken as a sender restart (new process, counter back at 1) when it
+/// is large, when the counter is back at 0 or 1, or when the timestamp moved by more than
+/// a reordered datagram could have: one sent earlier carries about the same time.
+struct WireSequenceTracker {
+    private(set) var last: UInt32?
+    private(set) var lost: UInt64 = 0
+    private(set) var stale: UInt64 = 0
+    private(set) var restarts: UInt64 = 0
+    private var lastTimestampUs: UInt64 = 0
+
+    private let restartWindow: Int32 = 1024
+    private let restartGapUs: UInt64 = 1_000_000
+
+    /// Returns false when the packet is older than one already applied.
+    mutating func accept(_ header: WireHeader) -> Bool {
+        let seq = header.seq, t = header.timestampUs
+        if let last {
+            let delta = Int32(bitPattern: seq &- last)
+            if delta <= 0 {
+                let jumped = t > lastTimestampUs &+ restartGapUs || t &+ restartGapUs < lastTimestampUs
+                if delta > -restartWindow && seq > 1 && !jumped {
+                    stale += 1
+                    return false
+                }
+                restarts += 1
+            } else if delta > 1 {
+                lost += UInt64(delta - 1)
+            }
+        }
+        last = seq
+        lastTimestampUs = t
+        return true
+    }
+}
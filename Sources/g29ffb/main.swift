@@ -129,49 +129,80 @@ func makeCmdByte(slotMask: UInt8, cmd: UInt8) -> UInt8 {
     return ((slotMask & 0x0F) << 4) | (cmd & 0x0F)
 }
 
-func payloadStopForce(slotMask: UInt8) -> [UInt8] {
+let classicPayloadSize = 7
+
+// Each command is written in place, so the daemon can build reports in preallocated
+// buffers; the payload*() functions below wrap them for the interactive tools.
+
+func writeStopForce(_ p: UnsafeMutablePointer<UInt8>, slotMask: UInt8) {
     // CMD 0x03: Stop Force
-    return [
-        makeCmdByte(slotMask: slotMask, cmd: 0x03),
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-    ]
+    p[0] = makeCmdByte(slotMask: slotMask, cmd: 0x03)
+    p.advanced(by: 1).update(repeating: 0x00, count: 6)
 }
 
-func payloadDefaultSpringOff(slotMask: UInt8) -> [UInt8] {
+func writeDefaultSpringOff(_ p: UnsafeMutablePointer<UInt8>, slotMask: UInt8) {
     // CMD 0x05: Default Spring Off
-    return [
-        makeCmdByte(slotMask: slotMask, cmd: 0x05),
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-    ]
+    p[0] = makeCmdByte(slotMask: slotMask, cmd: 0x05)
+    p.advanced(by: 1).update(repeating: 0x00, count: 6)
 }
 
-func payloadFixedTimeLoop(enable2ms: Bool) -> [UInt8] {
+func writeFixedTimeLoop(_ p: UnsafeMutablePointer<UInt8>, enable2ms: Bool) {
     // CMD 0x0D: Fixed Time Loop
     // byte1: 0x01 = update forces every 2ms, 0x00 = disabled
-    return [
-        0x0D,
-        enable2ms ? 0x01 : 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00
-    ]
+    p[0] = 0x0D
+    p[1] = enable2ms ? 0x01 : 0x00
+    p.advanced(by: 2).update(repeating: 0x00, count: 5)
 }
 
-func payloadDownloadPlayConstantForce(
+func writeDownloadPlayConstantForce(
+    _ p: UnsafeMutablePointer<UInt8>,
     slotMask: UInt8,
     f0: UInt8,
     f1: UInt8 = 0x80,
     f2: UInt8 = 0x80,
     f3: UInt8 = 0x80
-) -> [UInt8] {
+) {
     // CMD 0x01: Download and Play Force
     // byte1: FORCE_TYPE = 0x00 (Constant Force)
     // bytes 2..5: force levels for F0..F3
     // byte6: unused/padding
-    return [
-        makeCmdByte(slotMask: slotMask, cmd: 0x01),
-        0x00,
-        f0, f1, f2, f3,
-        0x00
-    ]
+    p[0] = makeCmdByte(slotMask: slotMask, cmd: 0x01)
+    p[1] = 0x00
+    p[2] = f0
+    p[3] = f1
+    p[4] = f2
+    p[5] = f3
+    p[6] = 0x00
+}
+
+func classicPayload(_ write: (UnsafeMutablePointer<UInt8>) -> Void) -> [UInt8] {
+    [UInt8](unsafeUninitializedCapacity: classicPayloadSize) { buf, count in
+        buf.initialize(repeating: 0x00)
+        write(buf.baseAddress!)
+        count = classicPayloadSize
+    }
+}
+
+func payloadStopForce(slotMask: UInt8) -> [UInt8] {
+    classicPayload { writeStopForce($0, slotMask: slotMask) }
+}
+
+func payloadDefaultSpringOff(slotMask: UInt8) -> [UInt8] {
+    classicPayload { writeDefaultSpringOff($0, slotMask: slotMask) }
+}
+
+func payloadFixedTimeLoop(enable2ms: Bool) -> [UInt8] {
+    classicPayload { writeFixedTimeLoop($0, enable2ms: enable2ms) }
+}
+
+func payloadDownloadPlayConstantForce(
+    slotMask: UInt8,
+    f0: UInt8,
+    f1: UInt8 = 0x80,
+    f2: UInt8 = 0x80,
+    f3: UInt8 = 0x80
+) -> [UInt8] {
+    classicPayload { writeDownloadPlayConstantForce($0, slotMask: slotMask, f0: f0, f1: f1, f2: f2, f3: f3) }
 }
 
 func sleepMs(_ ms: Int) {
@@ -361,17 +392,77 @@ func runScriptedTestSequence(_ d: IOHIDDevice, reportID: UInt8) {
     print("=== End scripted test ===\n")
 }
 
+// MARK: - Force quantization
+
+/// First-order error-feedback quantizer (noise shaping) from a high-resolution force level
+/// onto the integer levels of the classic protocol. The rounding error of each tick is carried
+/// into the next one, so the time-averaged output equals the input even for fractional levels;
+/// at a high tick rate the wheel's own inertia does the averaging.
+struct ForceDither {
+    private(set) var error: Double = 0
+
+    mutating func quantize(_ level: Double, limit: Int) -> Int8 {
+        if level == 0 {
+            error = 0
+            return 0
+        }
+        let v = level + error
+        let q = max(Double(-limit), min(Double(limit), v.rounded()))
+        error = v - q
+        // Saturation must not wind the error up without bound.
+        error = max(-1, min(1, error))
+        return Int8(q)
+    }
+
+    mutating func reset() {
+        error = 0
+    }
+}
+
 // MARK: - UDP host (daemon)
 
+/// Datagrams drained in one go from the UDP socket or the shared-memory ring: views into
+/// the receiver's preallocated buffers (`stride` bytes apart), valid only during the callback.
+struct DatagramBatch {
+    let base: UnsafeMutableRawPointer
+    let stride: Int
+    let lengths: UnsafeMutablePointer<Int>
+    let stamps: UnsafeMutablePointer<UInt64>
+    let count: Int
+    /// Sender addresses; nil for the shared-memory ring, which has no way back.
+    var sources: UnsafeMutablePointer<sockaddr_in>? = nil
+
+    func bytes(_ i: Int) -> UnsafeRawBufferPointer {
+        UnsafeRawBufferPointer(start: base + i * stride, count: lengths[i])
+    }
+
+    /// Receive time, uptime nanoseconds.
+    func receivedNs(_ i: Int) -> UInt64 { stamps[i] }
+
+    func source(_ i: Int) -> sockaddr_in? { sources?[i] }
+}
+
 final class UDPServer {
+    static let batchSlots = 64
+    static let slotBytes = 1024
+
     private let fd: Int32
     private let source: DispatchSourceRead
     private let queue: DispatchQueue
-    private let onMessage: (String) -> Void
+    private let onBatch: (DatagramBatch) -> Void
+
+    // Allocated once; a wakeup never allocates, however many datagrams are pending.
+    private let buffer = UnsafeMutableRawPointer.allocate(byteCount: UDPServer.batchSlots * UDPServer.slotBytes, alignment: 16)
+    private let lengths = UnsafeMutablePointer<Int>.allocate(capacity: UDPServer.batchSlots)
+    private let stamps = UnsafeMutablePointer<UInt64>.allocate(capacity: UDPServer.batchSlots)
+    private let sources = UnsafeMutablePointer<sockaddr_in>.allocate(capacity: UDPServer.batchSlots)
 
-    init(port: UInt16, onMessage: @escaping (String) -> Void) throws {
-        self.queue = DispatchQueue(label: "g29ffb.udp")
-        self.onMessage = onMessage
+    /// `onBatch` runs on `queue` with every datagram pending at the wakeup, oldest first,
+    /// in batches of up to `batchSlots`. A wakeup that only found empty datagrams (the
+    /// shared-memory doorbell) delivers one empty batch.
+    init(port: UInt16, queue: DispatchQueue, onBatch: @escaping (DatagramBatch) -> Void) throws {
+        self.queue = queue
+        self.onBatch = onBatch
 
         let fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)
         guard fd >= 0 else { throw NSError(domain: "socket", code: 1) }
@@ -397,7 +488,7 @@ final class UDPServer {
 
         self.source = DispatchSource.makeReadSource(fileDescriptor: fd, queue: queue)
         self.source.setEventHandler { [weak self] in
-            self?.readOnce()
+            self?.readAll()
         }
         self.source.setCancelHandler { [fd] in
             close(fd)
@@ -405,25 +496,48 @@ final class UDPServer {
         self.source.resume()
     }
 
-    private func readOnce() {
-        var buf = [UInt8](repeating: 0, count: 1024)
-        var addr = sockaddr_in()
-        var addrLen = socklen_t(MemoryLayout<sockaddr_in>.size)
-
-        let bufCount = buf.count
-        let n = buf.withUnsafeMutableBytes { raw -> Int in
-            guard let base = raw.baseAddress else { return -1 }
-            return withUnsafeMutablePointer(to: &addr) { ptr in
-                ptr.withMemoryRebound(to: sockaddr.self, capacity: 1) { sa in
-                    recvfrom(fd, base, bufCount, 0, sa, &addrLen)
-                }
+    deinit {
+        source.cancel()
+        buffer.deallocate()
+        lengths.deallocate()
+        stamps.deallocate()
+        sources.deallocate()
+    }
+
+    /// Sends `text` back to the address a datagram came from (replies to `STATS`).
+    func reply(_ text: String, to address: sockaddr_in) {
+        var addr = address
+        let bytes = Array(text.utf8)
+        _ = withUnsafePointer(to: &addr) { ptr in
+            ptr.withMemoryRebound(to: sockaddr.self, capacity: 1) { sa in
+                sendto(fd, bytes, bytes.count, 0, sa, socklen_t(MemoryLayout<sockaddr_in>.size))
             }
         }
+    }
 
-        guard n > 0 else { return }
-        let data = Data(buf[0..<n])
-        if let msg = String(data: data, encoding: .utf8) {
-            onMessage(msg)
+    /// Drains the socket. Darwin has no recvmmsg, so this is a non-blocking recvfrom loop,
+    /// but one wakeup still consumes the whole backlog instead of one datagram.
+    private func readAll() {
+        var delivered = false
+        while true {
+            var n = 0
+            while n < Self.batchSlots {
+                var addrLen = socklen_t(MemoryLayout<sockaddr_in>.size)
+                let got = (sources + n).withMemoryRebound(to: sockaddr.self, capacity: 1) { sa in
+                    recvfrom(fd, buffer + n * Self.slotBytes, Self.slotBytes, MSG_DONTWAIT, sa, &addrLen)
+                }
+                if got < 0 { break }
+                if got == 0 { continue }
+                lengths[n] = got
+                stamps[n] = DispatchTime.now().uptimeNanoseconds
+                n += 1
+            }
+            if n > 0 || !delivered {
+                onBatch(DatagramBatch(base: buffer, stride: Self.slotBytes, lengths: lengths, stamps: stamps, count: n,
+                                      sources: sources))
+                delivered = true
+            }
+            if n < Self.batchSlots { return }
         }
     }
 }
@@ -433,146 +547,579 @@ struct HostConfig {
     var rateHz: Int = 200
     var watchdogMs: Int = 250
     var maxForce: Int = 100
+    var dither: Bool = true
     var deviceIndex: Int? = nil
     var reportID: UInt8 = 0x00
+    var latencyReportS: Int = 0
+    var eventDriven: Bool = false
+    var minGapUs: Int = 1000
+    var refreshMs: Int = 1000
+    var shmPath: String? = nil
+    var offload: Bool = false
+    var upsample = UpsampleConfig()
+    var filters = ForceFilterConfig()
+    var maxLeaseMs: Int = 1000
+    var statsPath: String? = nil
+    var statsEveryS: Int = 1
+    var arbitration: ArbitrationMode = .priority
+    var clientRules: [ClientRule] = []
 }
 
 final class FFBHost {
     private let wheel: IOHIDDevice
-    private let reportID: UInt8
-    private let outputSize: Int
+    private let writer: HIDWriter
     private let maxForce: Int
     private let watchdogMs: Int
-    private let keepAliveMs: UInt64
+    private let maxLeaseMs: UInt64
+    private let refreshMs: UInt64
+    private let eventDriven: Bool
+    private let minGapNs: UInt64
 
     private let queue = DispatchQueue(label: "g29ffb.host")
     private var server: UDPServer?
+    private var shm: ShmReceiver?
     private var timer: DispatchSourceTimer?
 
-    private var desiredForce: Int8 = 0
+    private let ditherEnabled: Bool
+    private var dither = ForceDither()
+    private var filters: ForceFilterChain?
+    private let filterDescription: String
+
     private var activeForce: Int8 = 0
+    /// Latest update from any session; 0 until the first one, when there is nothing to guard.
     private var lastUpdateMs: UInt64 = 0
     private var lastSendMs: UInt64 = 0
-    private var loopEnabled = false
     private var lastLogMs: UInt64 = 0
 
+    private let steering: SteeringAxis?
+    private let sessions: SessionTable
+    private var lastTickNs: UInt64 = 0
+    private var lastReportNs: UInt64 = 0
+    private var outputScheduled = false
+
+    private var latency = LatencyStats()
+    private let latencyReportMs: UInt64
+    private var lastLatencyReportMs: UInt64 = 0
+    /// Receive time of the oldest update not yet mixed by a tick, 0 if none.
+    private var pendingReceivedNs: UInt64 = 0
+
+    // Per-batch scratch, reused so a burst never allocates.
+    private var decoded = ContiguousArray<WirePacket?>()
+    private var keys = ContiguousArray<Int>()
+    private var owners = ContiguousArray<Int>()
+    /// Supersede key to the index of the datagram that survives for it.
+    private var survivors: [Int: Int] = [:]
+
+    private var metrics = DaemonMetrics()
+    private var writerStats = HIDWriterStats()
+    private let startNs = DispatchTime.now().uptimeNanoseconds
+    private var tickIntervalNs: UInt64 = 0
+    private var lastTimerNs: UInt64 = 0
+    private var watchdogTripped = false
+    private let statsPath: String?
+    private let statsEveryMs: UInt64
+    private var lastStatsMs: UInt64 = 0
+    private let statsQueue = DispatchQueue(label: "g29ffb.stats", qos: .utility)
+
+    // Reports are built in `report` and only posted when they differ from `lastPosted`
+    // (or the refresh is due); both are allocated once.
+    private let report = UnsafeMutablePointer<UInt8>.allocate(capacity: classicPayloadSize)
+    private let lastPosted = UnsafeMutablePointer<UInt8>.allocate(capacity: classicPayloadSize)
+    private var hasPosted = false
+
+    // --offload: conditions run in the wheel's slots F1-F3 and the host only drives F0,
+    // so its stop commands must leave the other slots alone.
+    private let slots: ForceSlotAllocator?
+    private let hostSlotMask: UInt8
+    private var slotsDirty = false
+    private var autoCenterSent: Bool?
+
     init(wheel: IOHIDDevice, reportID: UInt8, outputSize: Int, config: HostConfig) {
         self.wheel = wheel
-        self.reportID = reportID
-        self.outputSize = outputSize
+        self.writer = HIDWriter(sink: IOHIDReportSink(device: wheel, reportID: reportID), size: outputSize)
+        self.steering = SteeringAxis(device: wheel)
         self.maxForce = max(1, min(127, config.maxForce))
         self.watchdogMs = max(50, config.watchdogMs)
-        self.keepAliveMs = UInt64(max(10, 1000 / max(50, config.rateHz)))
+        self.maxLeaseMs = UInt64(max(0, config.maxLeaseMs))
+        self.refreshMs = UInt64(max(0, config.refreshMs))
+        self.ditherEnabled = config.dither
+        self.eventDriven = config.eventDriven
+        self.minGapNs = UInt64(max(0, config.minGapUs)) * 1000
+        self.latencyReportMs = UInt64(max(0, config.latencyReportS)) * 1000
+        self.sessions = SessionTable(mode: config.arbitration, upsample: config.upsample,
+                                     watchdogMs: max(50, config.watchdogMs), rules: config.clientRules)
+        if !config.filters.isEmpty {
+            let sampleRate = 1e6 / Double(Self.tickIntervalUs(rateHz: config.rateHz))
+            self.filters = ForceFilterChain(config.filters, sampleRate: sampleRate,
+                                            limit: Double(max(1, min(127, config.maxForce))) / 100)
+        }
+        self.filterDescription = config.filters.description
+        self.statsPath = config.statsPath
+        self.statsEveryMs = UInt64(max(1, config.statsEveryS)) * 1000
+        self.slots = config.offload ? ForceSlotAllocator() : nil
+        self.hostSlotMask = config.offload ? 0x01 : 0x0F
+        decoded.reserveCapacity(UDPServer.batchSlots)
+        keys.reserveCapacity(UDPServer.batchSlots)
+        owners.reserveCapacity(UDPServer.batchSlots)
+        survivors.reserveCapacity(UDPServer.batchSlots)
     }
 
-    func start(port: UInt16, rateHz: Int) throws {
-        let _ = sendInit()
-        self.server = try UDPServer(port: port) { [weak self] msg in
-            self?.handleMessage(msg)
+    func start(port: UInt16, rateHz: Int, shmPath: String?) throws {
+        sendInit()
+        writer.start()
+        if let shmPath {
+            do {
+                shm = try ShmReceiver(path: shmPath)
+                print("Shared-memory ring at \(shmPath) (proxy: FFB_SHM=Z:\(shmPath.replacingOccurrences(of: "/", with: "\\")))")
+            } catch {
+                print("Shared-memory ring at \(shmPath) unavailable (\(error)); UDP only.")
+            }
+        }
+        // Datagrams are handled on the tick queue: the mixer is never touched from two threads.
+        self.server = try UDPServer(port: port, queue: queue) { [weak self] batch in
+            guard let self else { return }
+            self.drainShm()
+            self.handleBatch(batch)
+            if self.eventDriven { self.outputSoon() }
         }
-        let intervalMs = max(1, 1000 / max(50, rateHz))
-        let timer = DispatchSource.makeTimerSource(queue: queue)
-        timer.schedule(deadline: .now(), repeating: .milliseconds(intervalMs))
+        let intervalUs = Self.tickIntervalUs(rateHz: rateHz)
+        tickIntervalNs = UInt64(intervalUs) * 1000
+        let timer = DispatchSource.makeTimerSource(flags: .strict, queue: queue)
+        timer.schedule(deadline: .now(), repeating: .microseconds(intervalUs), leeway: .microseconds(intervalUs / 10))
         timer.setEventHandler { [weak self] in
             self?.tick()
         }
         self.timer = timer
         timer.resume()
-        print("FFB host running on 127.0.0.1:\(port) rate=\(rateHz)Hz watchdog=\(watchdogMs)ms maxForce=\(maxForce)")
+        print("FFB host running on 127.0.0.1:\(port) rate=\(rateHz)Hz watchdog=\(watchdogMs)ms maxForce=\(maxForce) dither=\(ditherEnabled)"
+              + (maxLeaseMs == 0 ? " leases=off" : "")
+              + (eventDriven ? " event minGap=\(minGapNs / 1000)us" : "")
+              + (slots != nil ? " offload=F1-F3" : "")
+              + (sessions.upsample.mode != .hold ? " upsample=\(sessions.upsample.mode.rawValue)" : "")
+              + " arbitrate=\(sessions.mode.rawValue)"
+              + (filters != nil ? " " + filterDescription : "")
+              + (statsPath.map { " stats=\($0)" } ?? ""))
+        if steering == nil {
+            print("Steering axis not found; Spring/Damper/Friction/Inertia effects are ignored.")
+        }
         dispatchMain()
     }
 
+    /// Up to 1 kHz (the G29's USB polling interval); dithering needs the high rate.
+    static func tickIntervalUs(rateHz: Int) -> Int {
+        max(1000, 1_000_000 / max(50, rateHz))
+    }
+
+    /// Monotonic: wall-clock steps (NTP, sleep) must not trip or stall the watchdog.
     private func nowMs() -> UInt64 {
-        UInt64(Date().timeIntervalSince1970 * 1000.0)
+        DispatchTime.now().uptimeNanoseconds / 1_000_000
+    }
+
+    private func clampLevel(_ v: Double) -> Double {
+        max(Double(-maxForce), min(Double(maxForce), v))
     }
 
-    private func clampForce(_ v: Int) -> Int8 {
-        let clamped = max(-maxForce, min(maxForce, v))
-        return Int8(clamped)
+    /// Key of the effect state a datagram carries within its session: a later datagram with
+    /// the same key (and session) replaces it completely. nil for device commands, which are
+    /// never skipped. Keys fit in 24 bits.
+    private static func supersedeKey(_ packet: WirePacket?, _ bytes: UnsafeRawBufferPointer) -> Int? {
+        switch packet {
+        case .effect(let p): return Int(WireKind.effect.rawValue) << 16 | Int(p.effectID)
+        case .condition(let p): return Int(WireKind.condition.rawValue) << 16 | Int(p.effectID)
+        case .periodic(let p): return Int(WireKind.periodic.rawValue) << 16 | Int(p.effectID)
+        case .device: return nil
+        case .heartbeat: return Int(WireKind.heartbeat.rawValue) << 16
+        case nil:
+            if wireHasMagic(bytes) || isStatsQuery(bytes) { return nil }
+            return 0xFF_FFFF // all text commands drive one effect
+        }
     }
 
-    private func handleMessage(_ msg: String) {
+    /// Applies a burst in order, skipping every effect packet (or text command) that a
+    /// newer one from the same sender in the same batch replaces: the highest sequence
+    /// number for binary packets (datagrams can arrive reordered), the last one for text.
+    /// Binary packets carry full state, so the result is the same as applying them one by
+    /// one, without the intermediate forces.
+    private func handleBatch(_ batch: DatagramBatch) {
+        if batch.count == 0 { return }
+        if pendingReceivedNs == 0 { pendingReceivedNs = batch.receivedNs(0) }
+        decoded.removeAll(keepingCapacity: true)
+        keys.removeAll(keepingCapacity: true)
+        owners.removeAll(keepingCapacity: true)
+        survivors.removeAll(keepingCapacity: true)
+        metrics.datagrams &+= UInt64(batch.count)
+        let now = nowMs()
+        for i in 0..<batch.count {
+            let bytes = batch.bytes(i)
+            let packet = decodeWirePacket(bytes)
+            var owner = -1
+            if let packet {
+                metrics.parsed &+= 1
+                latency.recordWire(senderUs: packet.header.timestampUs, receivedNs: batch.receivedNs(i))
+                owner = sessions.lookup(clientID: packet.header.clientID, priority: packet.header.priority,
+                                        source: batch.source(i), now: now) ?? -1
+            } else if wireHasMagic(bytes) {
+                metrics.rejected &+= 1
+            } else {
+                metrics.text &+= 1
+                if bytes.count > 0 && !isStatsQuery(bytes) {
+                    owner = sessions.lookup(clientID: 0, priority: nil, source: batch.source(i), now: now) ?? -1
+                }
+            }
+            decoded.append(packet)
+            owners.append(owner)
+            let key = owner < 0 ? nil : Self.supersedeKey(packet, bytes).map { owner << 24 | $0 }
+            keys.append(key ?? Int.min)
+            if let key {
+                if let j = survivors[key], let kept = decoded[j], let packet,
+                   Int32(bitPattern: packet.header.seq &- kept.header.seq) < 0 {
+                    continue
+                }
+                survivors[key] = i
+            }
+        }
+
+        for i in 0..<batch.count {
+            let key = keys[i]
+            if key != Int.min, survivors[key] != i {
+                metrics.superseded &+= 1
+                // Older than the survivor: counted in order if it came first, as stale if not,
+                // the same as without batching.
+                if let packet = decoded[i] { _ = sessions[owners[i]].sequence.accept(packet.header) }
+                continue
+            }
+            if isStatsQuery(batch.bytes(i)) {
+                if let source = batch.source(i) { server?.reply(statsReport(), to: source) }
+                continue
+            }
+            // No session: the table is full of active senders.
+            guard owners[i] >= 0 else { continue }
+            let session = sessions[owners[i]]
+            if let packet = decoded[i] {
+                handlePacket(packet, session: session, receivedNs: batch.receivedNs(i))
+            } else if !wireHasMagic(batch.bytes(i)) {
+                // Binary but undecodable (wrong version, truncated): never reinterpret it as text.
+                handleMessage(String(decoding: batch.bytes(i), as: UTF8.self), session: session, receivedNs: batch.receivedNs(i))
+            }
+        }
+        arbitrate(now: nowMs())
+        syncSlots()
+    }
+
+    private func handlePacket(_ packet: WirePacket, session s: ClientSession, receivedNs: UInt64) {
+        switch packet {
+        case .effect(let effect):
+            handleEffectPacket(effect, session: s, receivedNs: receivedNs)
+        case .condition(let condition):
+            handleConditionPacket(condition, session: s)
+        case .periodic(let p):
+            handlePeriodicPacket(p, session: s)
+        case .device(let device):
+            handleDevicePacket(device, session: s)
+        case .heartbeat(let p):
+            handleHeartbeat(p, session: s)
+        }
+    }
+
+    private func noteUpdate(_ s: ClientSession) {
+        s.lastUpdateMs = nowMs()
+        lastUpdateMs = s.lastUpdateMs
+    }
+
+    private func handleEffectPacket(_ p: WireEffectPacket, session s: ClientSession, receivedNs: UInt64) {
+        guard s.sequence.accept(p.header) else { return }
+        guard p.effectType == .constant else { return }
+        let sentNs = s.clock.hostNs(senderUs: p.header.timestampUs, receivedNs: receivedNs)
+        s.mixer.apply(p, time: Double(sentNs) / 1e9)
+        noteUpdate(s)
+        logIncoming("\(s.name) EFFECT id=\(p.effectID) \(p.playing ? "PLAY" : "STOP") mag=\(p.magnitude) gain=\(p.gain) seq=\(p.header.seq) lost=\(s.sequence.lost) stale=\(s.sequence.stale) superseded=\(metrics.superseded)")
+    }
+
+    private func handleConditionPacket(_ p: WireConditionPacket, session s: ClientSession) {
+        guard s.sequence.accept(p.header) else { return }
+        s.mixer.apply(p)
+        slotsDirty = true
+        noteUpdate(s)
+        logIncoming("\(s.name) CONDITION id=\(p.effectID) \(p.effectType) \(p.playing ? "PLAY" : "STOP") coeff=\(p.positiveCoefficient)/\(p.negativeCoefficient) sat=\(p.positiveSaturation)/\(p.negativeSaturation) offset=\(p.offset) dead=\(p.deadband)")
+    }
+
+    private func handlePeriodicPacket(_ p: WirePeriodicPacket, session s: ClientSession) {
+        guard s.sequence.accept(p.header) else { return }
+        s.mixer.apply(p)
+        noteUpdate(s)
+        logIncoming("\(s.name) PERIODIC id=\(p.effectID) \(p.effectType) \(p.playing ? "PLAY" : "STOP") mag=\(p.magnitude) offset=\(p.offset) phase=\(p.phase) period=\(p.periodUs)us")
+    }
+
+    private func handleDevicePacket(_ p: WireDevicePacket, session s: ClientSession) {
+        guard s.sequence.accept(p.header) else { return }
+        s.mixer.apply(p)
+        slotsDirty = true
+        noteUpdate(s)
+        // Commands are rare and matter when debugging; never throttle them.
+        print("[daemon] \(s.name) DEVICE \(p.command) gain=\(p.gain)")
+    }
+
+    /// Renews or ends the sender's lease. A heartbeat is not an update: it holds whatever the
+    /// last update left, and the watchdog still runs from that update once the lease lapses.
+    private func handleHeartbeat(_ p: WireHeartbeatPacket, session s: ClientSession) {
+        guard s.sequence.accept(p.header) else { return }
+        metrics.heartbeats &+= 1
+        guard maxLeaseMs > 0 else { return }
+        let hadLease = s.leaseUntilMs != 0
+        let leaseMs = min(UInt64(p.leaseMs), maxLeaseMs)
+        s.leaseUntilMs = leaseMs == 0 ? 0 : nowMs() + leaseMs
+        if hadLease != (s.leaseUntilMs != 0) {
+            print("[daemon] \(s.name): lease " + (leaseMs == 0 ? "ended by the sender" : "of \(leaseMs) ms from heartbeats"))
+        }
+    }
+
+    private func handleMessage(_ msg: String, session s: ClientSession, receivedNs: UInt64) {
         let trimmed = msg.trimmingCharacters(in: .whitespacesAndNewlines)
         if trimmed.isEmpty { return }
         let upper = trimmed.uppercased()
         if upper == "STOP" {
-            desiredForce = 0
-            lastUpdateMs = nowMs()
-            logIncoming("STOP")
+            s.mixer.applyText(nil, time: Double(receivedNs) / 1e9)
+            noteUpdate(s)
+            logIncoming("\(s.name) STOP")
             return
         }
         if upper.hasPrefix("CONST") {
             let parts = trimmed.split(whereSeparator: { $0 == " " || $0 == "\t" })
             if parts.count >= 2, let v = Int(parts[1]) {
-                desiredForce = clampForce(v)
-                lastUpdateMs = nowMs()
-                logIncoming("CONST \(desiredForce)")
+                let level = clampLevel(Double(v))
+                s.mixer.applyText(level / 100, time: Double(receivedNs) / 1e9)
+                noteUpdate(s)
+                logIncoming("\(s.name) CONST \(Int(level))")
+                return
+            }
+        }
+        metrics.rejected &+= 1
+    }
+
+    /// Runs the session arbitration. When the wheel changes hands the previous lead's
+    /// conditions go back to its own mix and the new lead's are offloaded instead.
+    private func arbitrate(now: UInt64) {
+        let previous = sessions.lead
+        guard sessions.arbitrate(now: now) else { return }
+        if let previous { sessions[previous].mixer.offloadConditions([]) }
+        slotsDirty = true
+        if let lead = sessions.lead, sessions.openCount > 1 {
+            print("[daemon] wheel: \(sessions[lead].name) (priority \(sessions[lead].priority), \(sessions.mode.rawValue))")
+        }
+    }
+
+    /// --offload: moves the lead session's playing conditions the firmware can run into
+    /// slots F1-F3 (the rest stay in the host mix) and applies its DIPROP_AUTOCENTER as the
+    /// default spring. Slot commands are queued on the writer, so a later force report
+    /// never replaces them. When the queue has no room for a whole update (a stop, a
+    /// download per slot and the default spring) the slots stay dirty for the next tick.
+    private func syncSlots() {
+        guard let slots, slotsDirty,
+              writer.reserveCommands(ForceSlotAllocator.slotMasks.count + 2) else { return }
+        slotsDirty = false
+        var wanted: [(id: UInt16, force: ClassicForce)] = []
+        let mixer = sessions.lead.map { sessions[$0].mixer }
+        if let lead = sessions.lead, let mixer, !mixer.paused && mixer.actuatorsOn {
+            let limit = Double(maxForce) / 127
+            // The firmware runs the slots unscaled, so they carry the lead's weight the way
+            // output scales its host mix.
+            let gain = mixer.deviceGain * sessions[lead].weight
+            for c in mixer.conditions.playing {
+                if let force = ClassicForce(condition: c.params, gain: gain, limit: limit) {
+                    wanted.append((id: c.id, force: force))
+                }
             }
         }
+        let offloaded = slots.update(wanted) { _ = writer.postCommand($0) }
+        mixer?.offloadConditions(offloaded)
+
+        if let on = mixer?.autoCenter, on != autoCenterSent {
+            // `report` is rebuilt by every output, and postCommand copies it.
+            if on { writeDefaultSpringOn(report, slotMask: 0x0F) } else { writeDefaultSpringOff(report, slotMask: 0x0F) }
+            writer.postCommand(report)
+            autoCenterSent = on
+            print("[daemon] default spring \(on ? "on" : "off") (DIPROP_AUTOCENTER)")
+        }
     }
 
-    private func logIncoming(_ line: String) {
+    /// At most one line every 200 ms. `line` is only formatted when it is printed, so the
+    /// packets in between cost no string (the receive path does not allocate).
+    private func logIncoming(_ line: @autoclosure () -> String) {
         let now = nowMs()
         if now - lastLogMs < 200 { return }
         lastLogMs = now
-        print("[daemon] \(line)")
+        print("[daemon] \(line())")
+    }
+
+    /// Shared-memory datagrams go first: UDP only carries what did not fit in the ring
+    /// (or was sent while the daemon was not attached), which is newer. In event mode the
+    /// proxy is asked for a doorbell datagram instead of waiting for the next tick.
+    private func drainShm() {
+        guard let shm else { return }
+        shm.drain { handleBatch($0) }
+        if eventDriven {
+            while shm.requestWake() { shm.drain { handleBatch($0) } }
+        }
     }
 
     private func tick() {
+        let tickNs = DispatchTime.now().uptimeNanoseconds
+        if lastTimerNs != 0 {
+            let gap = tickNs &- lastTimerNs
+            metrics.tickLate.record(gap > tickIntervalNs ? gap - tickIntervalNs : 0)
+        }
+        lastTimerNs = tickNs
+        metrics.ticks &+= 1
+        drainShm()
         let now = nowMs()
-        if lastUpdateMs > 0, now - lastUpdateMs > UInt64(watchdogMs) {
+        if let statsPath, now - lastStatsMs >= statsEveryMs {
+            lastStatsMs = now
+            let text = statsReport()
+            // Formatted here, where the counters live; the file is written off the tick queue.
+            statsQueue.async {
+                do {
+                    try text.write(toFile: statsPath, atomically: true, encoding: .utf8)
+                } catch {
+                    print("[daemon] cannot write \(statsPath): \(error)")
+                }
+            }
+        }
+        if latencyReportMs > 0, now - lastLatencyReportMs >= latencyReportMs {
+            if lastLatencyReportMs > 0 {
+                writer.takeLatency(hid: &latency.hid, total: &latency.total)
+                let c = writer.counters()
+                print(latency.report())
+                print("[latency] hid reports written=\(c.written) replaced=\(c.replaced) failed=\(c.failed) elided=\(metrics.elided)")
+            }
+            latency.reset()
+            lastLatencyReportMs = now
+        }
+        arbitrate(now: now)
+        syncSlots()
+        // Every session's watchdog (or lease) has run out.
+        if lastUpdateMs > 0, sessions.activeCount == 0 {
+            if !watchdogTripped {
+                watchdogTripped = true
+                metrics.watchdogTrips &+= 1
+            }
+            if let slots, slots.isActive {
+                // Queued, so a slot download that follows once updates resume lands after it.
+                // A full queue leaves the slots active, so the next tick tries again.
+                writeStopForce(report, slotMask: 0x0E)
+                if writer.postCommand(report) {
+                    slots.reset()
+                    slotsDirty = true
+                }
+            }
             if activeForce != 0 {
-                sendStop()
+                writeStopForce(report, slotMask: hostSlotMask)
+                postReport(now: now, decidedNs: 0, receivedNs: 0)
                 activeForce = 0
-                lastSendMs = now
             }
+            dither.reset()
+            filters?.reset()
+            lastTickNs = 0
+            pendingReceivedNs = 0
             return
         }
+        watchdogTripped = false
+        // A report just went out on receive; the gap applies to timer ticks as well.
+        if eventDriven, DispatchTime.now().uptimeNanoseconds &- lastReportNs < minGapNs { return }
+        output(now: now, tick: true)
+    }
 
-        if desiredForce != activeForce || now - lastSendMs >= keepAliveMs {
-            if desiredForce == 0 {
-                sendStop()
-            } else {
-                sendConstant(desiredForce)
-            }
-            activeForce = desiredForce
-            lastSendMs = now
+    /// Event mode: a received update is written right away, or as soon as the minimum gap
+    /// since the previous report has passed. The timer is then only needed for the refresh,
+    /// the watchdog and effects that change on their own (conditions, periodics, dither).
+    private func outputSoon() {
+        if outputScheduled { return }
+        let elapsed = DispatchTime.now().uptimeNanoseconds &- lastReportNs
+        if elapsed >= minGapNs {
+            output(now: nowMs(), tick: false)
+            return
+        }
+        outputScheduled = true
+        queue.asyncAfter(deadline: .now() + .nanoseconds(Int(minGapNs - elapsed))) { [weak self] in
+            guard let self else { return }
+            self.outputScheduled = false
+            self.output(now: self.nowMs(), tick: false)
         }
     }
 
-    private func sendInit() {
-        sendPayload(payloadStopForce(slotMask: 0x0F))
-        sendPayload(payloadDefaultSpringOff(slotMask: 0x0F))
-        sendPayload(payloadFixedTimeLoop(enable2ms: true))
-        loopEnabled = true
-    }
+    /// Mixes all effects at this instant and writes a report if the force changed or the
+    /// keepalive is due. Runs from the timer (`tick`) and, in event mode, on receive.
+    /// Every active session is mixed, so effect time runs on while another session has the
+    /// wheel; only the arbitration's weights decide what reaches it.
+    private func output(now: UInt64, tick: Bool) {
+        let tickNs = DispatchTime.now().uptimeNanoseconds
+        let dt = lastTickNs == 0 ? 0 : Double(tickNs - lastTickNs) / 1e9
+        lastTickNs = tickNs
+        let time = Double(tickNs) / 1e9
+        var mixed = 0.0
+        var position: Double?
+        var positionRead = false
+        for s in sessions.sessions where s.active {
+            if !positionRead && s.mixer.needsPosition {
+                position = steering?.read()
+                positionRead = true
+            }
+            mixed += s.mixer.mix(dt: dt, time: time) { position } * s.weight
+        }
+        mixed = filters?.process(mixed, dt: dt, tick: tick) ?? mixed
+
+        // Mixed at full resolution; only the dither below quantizes to wheel levels.
+        let level = clampLevel(mixed * 100)
+        let force: Int8
+        if ditherEnabled {
+            force = dither.quantize(level, limit: maxForce)
+        } else {
+            force = Int8(level.rounded())
+        }
 
-    private func sendStop() {
-        sendPayload(payloadStopForce(slotMask: 0x0F))
-    }
+        let decidedNs = DispatchTime.now().uptimeNanoseconds
+        let receivedNs = pendingReceivedNs
+        pendingReceivedNs = 0
+        if receivedNs != 0 { latency.queue.record(decidedNs &- receivedNs) }
 
-    private func sendConstant(_ force: Int8) {
-        if !loopEnabled {
-            sendPayload(payloadFixedTimeLoop(enable2ms: true))
-            loopEnabled = true
+        // A dithered 0 while a force is requested is a neutral level, not a stop command.
+        if force == 0 && level == 0 {
+            writeStopForce(report, slotMask: hostSlotMask)
+        } else {
+            writeDownloadPlayConstantForce(report, slotMask: 0x01, f0: UInt8(Int(force) + 0x80))
         }
-        let f0 = UInt8(Int(force) + 0x80)
-        sendPayload(payloadDownloadPlayConstantForce(slotMask: 0x01, f0: f0))
+        activeForce = force
+        postReport(now: now, decidedNs: decidedNs, receivedNs: receivedNs)
     }
 
-    private func sendPayload(_ payload7: [UInt8]) {
-        var buf = payload7
-        if outputSize > buf.count {
-            buf.append(contentsOf: Array(repeating: 0x00, count: outputSize - buf.count))
+    /// Hands `report` to the writer unless it repeats the last one. The wheel holds a level
+    /// until told otherwise, so identical reports are only resent every `refreshMs` (0: never).
+    private func postReport(now: UInt64, decidedNs: UInt64, receivedNs: UInt64) {
+        if hasPosted, memcmp(report, lastPosted, classicPayloadSize) == 0,
+           refreshMs == 0 || now - lastSendMs < refreshMs {
+            metrics.elided &+= 1
+            return
         }
-        var out = buf
-        _ = IOHIDDeviceSetReport(
-            wheel,
-            kIOHIDReportTypeOutput,
-            CFIndex(reportID),
-            &out,
-            out.count
-        )
+        writer.post(report, decidedNs: decidedNs, receivedNs: receivedNs)
+        metrics.reportsPosted &+= 1
+        lastPosted.update(from: report, count: classicPayloadSize)
+        hasPosted = true
+        lastSendMs = now
+        lastReportNs = DispatchTime.now().uptimeNanoseconds
+    }
+
+    private func statsReport() -> String {
+        writer.stats(into: &writerStats)
+        return metricsReport(metrics, sessions: sessions, writer: writerStats,
+                             uptimeS: Double(DispatchTime.now().uptimeNanoseconds &- startNs) / 1e9)
+    }
+
+    private func sendInit() {
+        writeStopForce(report, slotMask: 0x0F)
+        writer.writeNow(report)
+        writeDefaultSpringOff(report, slotMask: 0x0F)
+        writer.writeNow(report)
+        writeFixedTimeLoop(report, enable2ms: true)
+        writer.writeNow(report)
     }
 }
 
@@ -614,6 +1161,46 @@ func parseHostConfig(_ args: [String]) -> HostConfig {
             if i + 1 < args.count, let w = Int(args[i + 1]) { cfg.watchdogMs = w; i += 1 }
         case "--max":
             if i + 1 < args.count, let m = Int(args[i + 1]) { cfg.maxForce = m; i += 1 }
+        case "--no-dither":
+            cfg.dither = false
+        case "--event":
+            cfg.eventDriven = true
+        case "--min-gap":
+            if i + 1 < args.count, let g = Int(args[i + 1]) { cfg.minGapUs = g; i += 1 }
+        case "--shm":
+            if i + 1 < args.count { cfg.shmPath = args[i + 1]; i += 1 }
+        case "--refresh":
+            if i + 1 < args.count, let m = Int(args[i + 1]) { cfg.refreshMs = m; i += 1 }
+        case "--offload":
+            cfg.offload = true
+        case "--upsample":
+            if i + 1 < args.count, let m = UpsampleMode(rawValue: args[i + 1]) { cfg.upsample.mode = m; i += 1 }
+        case "--lowpass":
+            if i + 1 < args.count, let hz = Double(args[i + 1]) { cfg.filters.lowPassHz = hz; i += 1 }
+        case "--lowpass-q":
+            if i + 1 < args.count, let q = Double(args[i + 1]) { cfg.filters.lowPassQ = q; i += 1 }
+        case "--notch":
+            if i + 1 < args.count, let hz = Double(args[i + 1]) { cfg.filters.notchHz = hz; i += 1 }
+        case "--notch-q":
+            if i + 1 < args.count, let q = Double(args[i + 1]) { cfg.filters.notchQ = q; i += 1 }
+        case "--slew":
+            if i + 1 < args.count, let v = Double(args[i + 1]) { cfg.filters.slewPerS = v; i += 1 }
+        case "--soft-clip":
+            if i + 1 < args.count, let k = Double(args[i + 1]) { cfg.filters.softClipKnee = k; i += 1 }
+        case "--horizon":
+            if i + 1 < args.count, let h = Int(args[i + 1]) { cfg.upsample.horizon = Double(max(0, h)) / 1000; i += 1 }
+        case "--max-lease":
+            if i + 1 < args.count, let m = Int(args[i + 1]) { cfg.maxLeaseMs = m; i += 1 }
+        case "--arbitrate":
+            if i + 1 < args.count, let m = ArbitrationMode(rawValue: args[i + 1]) { cfg.arbitration = m; i += 1 }
+        case "--client":
+            if i + 1 < args.count, let rule = ClientRule(args[i + 1]) { cfg.clientRules.append(rule); i += 1 }
+        case "--stats-file":
+            if i + 1 < args.count { cfg.statsPath = args[i + 1]; i += 1 }
+        case "--stats-every":
+            if i + 1 < args.count, let s = Int(args[i + 1]) { cfg.statsEveryS = s; i += 1 }
+        case "--latency":
+            if i + 1 < args.count, let s = Int(args[i + 1]) { cfg.latencyReportS = s; i += 1 }
         case "--device":
             if i + 1 < args.count, let d = Int(args[i + 1]) { cfg.deviceIndex = d; i += 1 }
         case "--report-id":
@@ -766,10 +1353,14 @@ func runDaemon(args: [String]) {
 
     let outputSize = cfNumToInt(IOHIDDeviceGetProperty(dev, kIOHIDMaxOutputReportSizeKey as CFString)) ?? 16
     print("Using device index \(idx) reportID=0x\(String(format: "%02X", cfg.reportID)) outputSize=\(outputSize) bytes")
+    for rule in cfg.clientRules {
+        print("Client \(rule.clientID): priority \(rule.priority)" + String(format: " gain %.2f", rule.gain)
+              + (rule.watchdogMs.map { " watchdog \($0)ms" } ?? ""))
+    }
 
     let host = FFBHost(wheel: dev, reportID: cfg.reportID, outputSize: outputSize, config: cfg)
     do {
-        try host.start(port: cfg.port, rateHz: cfg.rateHz)
+        try host.start(port: cfg.port, rateHz: cfg.rateHz, shmPath: cfg.shmPath)
     } catch {
         print("Failed to start UDP host: \(error)")
         exit(1)
@@ -780,6 +1371,16 @@ func run() {
     let args = Array(CommandLine.arguments.dropFirst())
     if args.contains("--daemon") {
         runDaemon(args: args)
+    } else if args.contains("--bench") {
+        runBench(args: args)
+    } else if args.contains("--check-slots") {
+        runSlotCheck()
+    } else if args.contains("--check-upsample") {
+        runUpsampleCheck(args: args)
+    } else if args.contains("--check-conditions") {
+        runConditionCheck()
+    } else if args.contains("--check-dither") {
+        runDitherCheck(args: args)
     } else {
         runInteractive()
     }
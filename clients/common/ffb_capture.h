@@ -0,0 +1,40 @@
+/*
+ * Capture of the datagram stream sent to the g29ffb daemon (clients/ffb_replay).
+ *
+ * A capture is one FfbCaptureHeader followed by variable-length records: an
+ * FfbCaptureRecord and then `len` bytes of the datagram exactly as received, binary
+ * (ffb_wire.h) or text. Little-endian, packed. Records are in receive order and
+ * timestamps never decrease, so a replay only has to wait for each one in turn.
+ */
+#ifndef FFB_CAPTURE_H
+#define FFB_CAPTURE_H
+
+#include <stdint.h>
+
+#define FFB_CAPTURE_MAGIC   0x43393247u /* "G29C" on disk */
+#define FFB_CAPTURE_VERSION 1
+#define FFB_CAPTURE_MAX_DATAGRAM 1024
+
+#pragma pack(push, 1)
+
+typedef struct FfbCaptureHeader {
+    uint32_t magic;   /* FFB_CAPTURE_MAGIC */
+    uint16_t version; /* FFB_CAPTURE_VERSION */
+    uint16_t reserved;
+    uint64_t start_unix_ms; /* wall clock when recording started, for humans */
+} FfbCaptureHeader;
+
+typedef struct FfbCaptureRecord {
+    uint64_t t_ns;    /* receive time, monotonic, since the first record */
+    uint16_t len;     /* datagram bytes that follow, <= FFB_CAPTURE_MAX_DATAGRAM */
+    uint16_t reserved;
+} FfbCaptureRecord;
+
+#pragma pack(pop)
+
+#ifdef __cplusplus
+static_assert(sizeof(FfbCaptureHeader) == 16, "FfbCaptureHeader layout changed");
+static_assert(sizeof(FfbCaptureRecord) == 12, "FfbCaptureRecord layout changed");
+#endif
+
+#endif /* FFB_CAPTURE_H */
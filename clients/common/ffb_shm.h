@@ -0,0 +1,130 @@
+/*
+ * Shared-memory transport between the dinput8 proxy (in Wine) and the g29ffb daemon.
+ *
+ * Wine maps a Windows file mapping of a host file (e.g. Z:\tmp\g29ffb.shm) with a shared
+ * mmap, so both processes see the same pages. The file holds one FfbShmHeader and a
+ * single-producer/single-consumer ring of FfbShmSlot, each carrying one datagram exactly
+ * as it would have been sent over UDP (ffb_wire.h or text). Pushing and popping are plain
+ * memory operations; no syscall is involved on either side.
+ *
+ * The consumer (daemon) creates the file and sets consumer_active. The producer only uses
+ * the ring while consumer_active is set and the ring has room, and sends over UDP
+ * otherwise, so a stopped or stalled daemon degrades to the UDP path.
+ *
+ * Wakeup: a consumer that wants to be woken (instead of polling from its tick) sets
+ * wake_requested after draining the ring and drains once more. The next push clears it
+ * and the producer sends one zero-length UDP datagram as a doorbell.
+ *
+ * The helpers use the GCC/Clang __atomic builtins (MinGW, Clang, GCC).
+ */
+#ifndef FFB_SHM_H
+#define FFB_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define FFB_SHM_MAGIC      0x53393247u /* "G29S" in the file */
+#define FFB_SHM_VERSION    1
+#define FFB_SHM_SLOTS      256         /* power of two */
+#define FFB_SHM_SLOT_BYTES 128
+#define FFB_SHM_DATA_BYTES (FFB_SHM_SLOT_BYTES - 4)
+
+/* Naturally aligned (no packing) so the indices can be accessed atomically. */
+typedef struct FfbShmHeader {
+    uint32_t magic;           /* FFB_SHM_MAGIC */
+    uint16_t version;         /* FFB_SHM_VERSION */
+    uint16_t slot_bytes;      /* FFB_SHM_SLOT_BYTES */
+    uint32_t slots;           /* FFB_SHM_SLOTS */
+    uint32_t reserved0;
+    uint32_t consumer_active; /* consumer: 1 while it reads the ring */
+    uint32_t wake_requested;  /* consumer sets, producer clears and rings the doorbell */
+    uint8_t  pad0[40];
+    uint32_t head;            /* producer only; its own cache line */
+    uint8_t  pad1[60];
+    uint32_t tail;            /* consumer only; its own cache line */
+    uint8_t  pad2[60];
+} FfbShmHeader;
+
+typedef struct FfbShmSlot {
+    uint16_t len;
+    uint16_t reserved;
+    uint8_t  data[FFB_SHM_DATA_BYTES];
+} FfbShmSlot;
+
+#define FFB_SHM_FILE_BYTES (sizeof(FfbShmHeader) + (size_t)FFB_SHM_SLOTS * sizeof(FfbShmSlot))
+
+#ifdef __cplusplus
+static_assert(sizeof(FfbShmHeader) == 192, "FfbShmHeader layout changed");
+static_assert(sizeof(FfbShmSlot) == FFB_SHM_SLOT_BYTES, "FfbShmSlot layout changed");
+#endif
+
+static inline FfbShmSlot *ffb_shm_slot(FfbShmHeader *h, uint32_t index) {
+    return (FfbShmSlot *)(h + 1) + (index & (FFB_SHM_SLOTS - 1));
+}
+
+static inline int ffb_shm_valid(const FfbShmHeader *h) {
+    return h->magic == FFB_SHM_MAGIC && h->version == FFB_SHM_VERSION &&
+           h->slot_bytes == FFB_SHM_SLOT_BYTES && h->slots == FFB_SHM_SLOTS;
+}
+
+/* Consumer: (re)initializes the header and starts reading. Pending entries from a previous
+   consumer are dropped; head is never rewound, so a producer that is already attached
+   carries on. */
+static inline void ffb_shm_attach(FfbShmHeader *h) {
+    if (!ffb_shm_valid(h)) {
+        memset(h, 0, sizeof(*h));
+        h->magic = FFB_SHM_MAGIC;
+        h->version = FFB_SHM_VERSION;
+        h->slot_bytes = FFB_SHM_SLOT_BYTES;
+        h->slots = FFB_SHM_SLOTS;
+    }
+    __atomic_store_n(&h->tail, __atomic_load_n(&h->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    __atomic_store_n(&h->wake_requested, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->consumer_active, 1, __ATOMIC_RELEASE);
+}
+
+static inline void ffb_shm_detach(FfbShmHeader *h) {
+    __atomic_store_n(&h->consumer_active, 0, __ATOMIC_RELEASE);
+}
+
+/* Producer (one thread at a time). Returns 1 if queued; *wake is set when the consumer
+   asked for a doorbell. Returns 0 (caller sends over UDP) if nobody reads or it is full. */
+static inline int ffb_shm_push(FfbShmHeader *h, const void *data, int len, int *wake) {
+    *wake = 0;
+    if (len < 0 || len > FFB_SHM_DATA_BYTES) return 0;
+    if (!__atomic_load_n(&h->consumer_active, __ATOMIC_ACQUIRE)) return 0;
+    uint32_t head = __atomic_load_n(&h->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&h->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= FFB_SHM_SLOTS) return 0;
+    FfbShmSlot *slot = ffb_shm_slot(h, head);
+    slot->len = (uint16_t)len;
+    memcpy(slot->data, data, (size_t)len);
+    /* seq_cst pairs with the consumer's request-then-recheck: one side always sees the other. */
+    __atomic_store_n(&h->head, head + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&h->wake_requested, __ATOMIC_SEQ_CST)) {
+        *wake = __atomic_exchange_n(&h->wake_requested, 0, __ATOMIC_SEQ_CST) != 0;
+    }
+    return 1;
+}
+
+/* Consumer. Copies the oldest datagram into out and returns its length, or -1 if empty. */
+static inline int ffb_shm_pop(FfbShmHeader *h, void *out, int cap) {
+    uint32_t tail = __atomic_load_n(&h->tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+    if (tail == head) return -1;
+    const FfbShmSlot *slot = ffb_shm_slot(h, tail);
+    int len = slot->len;
+    if (len > cap) len = cap;
+    memcpy(out, slot->data, (size_t)len);
+    __atomic_store_n(&h->tail, tail + 1, __ATOMIC_RELEASE);
+    return len;
+}
+
+/* Consumer: ask for a doorbell with the next push. Returns 1 if entries are already
+   pending, in which case no doorbell may come and the caller must drain again. */
+static inline int ffb_shm_request_wake(FfbShmHeader *h) {
+    __atomic_store_n(&h->wake_requested, 1, __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&h->head, __ATOMIC_SEQ_CST) != __atomic_load_n(&h->tail, __ATOMIC_RELAXED);
+}
+
+#endif /* FFB_SHM_H */
@@ -0,0 +1,72 @@
+/*
+ * Binary trace of the DirectInput calls the dinput8 proxy hooks (FFB_TRACE=<path>).
+ *
+ * A trace is one FfbTraceHeader followed by fixed-size FfbTraceRecord entries, all
+ * little-endian and packed, appended in the order the calls were made. Nothing is
+ * throttled: every hooked call produces exactly one record, so rates and intervals
+ * computed from a trace are exact. See clients/trace_analyzer for the reader.
+ */
+#ifndef FFB_TRACE_H
+#define FFB_TRACE_H
+
+#include <stdint.h>
+
+#define FFB_TRACE_MAGIC   0x54393247u /* "G29T" on disk */
+#define FFB_TRACE_VERSION 1
+
+/* FfbTraceRecord.call */
+#define FFB_TRACE_CREATE_EFFECT  0x01 /* flags: 1 = fake effect (device could not create it) */
+#define FFB_TRACE_SET_PARAMETERS 0x02 /* flags: dwFlags; p[]: see below */
+#define FFB_TRACE_START          0x03 /* flags: dwFlags; p[0]: dwIterations */
+#define FFB_TRACE_STOP           0x04
+#define FFB_TRACE_RELEASE        0x05 /* last reference to the effect dropped */
+#define FFB_TRACE_ACQUIRE        0x06 /* p[0]: HRESULT */
+#define FFB_TRACE_UNACQUIRE      0x07 /* p[0]: HRESULT */
+#define FFB_TRACE_FF_COMMAND     0x08 /* flags: DISFFC_*; p[0]: HRESULT */
+
+/*
+ * SetParameters p[] layout. p[0] dwGain, p[1] rglDirection[0] (0 without axes), then
+ * by effect type:
+ *   constant:  p[2] lMagnitude
+ *   ramp:      p[2] lStart, p[3] lEnd
+ *   condition: p[2] lOffset, p[3] lPositiveCoefficient, p[4] lNegativeCoefficient,
+ *              p[5] dwPositiveSaturation, p[6] dwNegativeSaturation, p[7] lDeadBand
+ *   periodic:  p[2] dwMagnitude, p[3] lOffset, p[4] dwPhase, p[5] dwPeriod
+ * Only what the call set is read: p[0] needs DIEP_GAIN in flags, p[1] DIEP_DIRECTION and
+ * p[2..] DIEP_TYPESPECIFICPARAMS; fields the flags leave out are 0 and not the game's.
+ */
+#define FFB_TRACE_PARAMS 8
+
+/* The DIEP_* bits of a SetParameters record's flags that say which p[] are set. */
+#define FFB_TRACE_DIEP_GAIN               0x00000004u
+#define FFB_TRACE_DIEP_DIRECTION          0x00000040u
+#define FFB_TRACE_DIEP_TYPESPECIFICPARAMS 0x00000100u
+
+#pragma pack(push, 1)
+
+typedef struct FfbTraceHeader {
+    uint32_t magic;        /* FFB_TRACE_MAGIC */
+    uint16_t version;      /* FFB_TRACE_VERSION */
+    uint16_t record_size;  /* sizeof(FfbTraceRecord) */
+    uint32_t pid;
+    uint32_t reserved;
+    uint64_t start_us;     /* sender monotonic clock when the trace was opened */
+} FfbTraceHeader;
+
+typedef struct FfbTraceRecord {
+    uint64_t t_us;         /* same clock as start_us and the wire timestamps */
+    uint8_t  call;         /* FFB_TRACE_* */
+    uint8_t  effect_type;  /* FFB_EFFECT_*, 0 for device calls */
+    uint16_t effect_id;    /* 0 for device calls */
+    uint32_t flags;
+    int32_t  p[FFB_TRACE_PARAMS];
+} FfbTraceRecord;
+
+#pragma pack(pop)
+
+#ifdef __cplusplus
+static_assert(sizeof(FfbTraceHeader) == 24, "FfbTraceHeader layout changed");
+static_assert(sizeof(FfbTraceRecord) == 48, "FfbTraceRecord layout changed");
+#endif
+
+#endif /* FFB_TRACE_H */
@@ -0,0 +1,168 @@
+/*
+ * Binary wire format shared by the dinput8 proxy, ffb_client and the g29ffb daemon.
+ *
+ * All fields are little-endian and the structs are packed, so the daemon can
+ * decode a datagram with fixed offsets (see Sources/g29ffb/WireProtocol.swift).
+ * Every effect packet is a full snapshot of that effect's state: losing one
+ * datagram never leaves the daemon with a half-applied update.
+ *
+ * The text format ("CONST <n>" / "STOP") is still accepted by the daemon as a
+ * fallback; a datagram is treated as binary only when it starts with FFB_WIRE_MAGIC.
+ */
+#ifndef FFB_WIRE_H
+#define FFB_WIRE_H
+
+#include <stdint.h>
+
+#define FFB_WIRE_MAGIC   0x46393247u /* "G29F" on the wire */
+#define FFB_WIRE_VERSION 2 /* 2: per-effect gain, device packets */
+
+/* Packet kinds (FfbWireHeader.kind). */
+#define FFB_KIND_EFFECT    0x01
+#define FFB_KIND_CONDITION 0x02
+#define FFB_KIND_PERIODIC  0x03
+#define FFB_KIND_DEVICE    0x04
+#define FFB_KIND_HEARTBEAT 0x05
+
+/* Effect types (FfbWireEffect.effect_type). */
+#define FFB_EFFECT_CONSTANT 0x01
+#define FFB_EFFECT_RAMP     0x02
+#define FFB_EFFECT_SPRING   0x03
+#define FFB_EFFECT_DAMPER   0x04
+#define FFB_EFFECT_FRICTION 0x05
+#define FFB_EFFECT_INERTIA  0x06
+#define FFB_EFFECT_SINE     0x07
+#define FFB_EFFECT_SQUARE   0x08
+#define FFB_EFFECT_TRIANGLE 0x09
+#define FFB_EFFECT_SAW_UP   0x0A
+#define FFB_EFFECT_SAW_DOWN 0x0B
+#define FFB_EFFECT_CUSTOM   0x0C
+
+/* Effect state (FfbWireEffect.state). */
+#define FFB_STATE_STOPPED 0x00
+#define FFB_STATE_PLAYING 0x01
+
+/* Device commands (FfbWireDevice.command), from IDirectInputDevice8::SendForceFeedbackCommand
+   and SetProperty(DIPROP_AUTOCENTER). */
+#define FFB_CMD_NONE          0x00 /* gain change only */
+#define FFB_CMD_RESET         0x01 /* remove every effect, clear pause, actuators on */
+#define FFB_CMD_STOP_ALL      0x02
+#define FFB_CMD_PAUSE         0x03 /* output off, effect time frozen */
+#define FFB_CMD_CONTINUE      0x04
+#define FFB_CMD_ACTUATORS_ON  0x05
+#define FFB_CMD_ACTUATORS_OFF 0x06 /* output off, effects keep running */
+#define FFB_CMD_AUTOCENTER_OFF 0x07 /* DIPROPAUTOCENTER_OFF */
+#define FFB_CMD_AUTOCENTER_ON  0x08 /* DIPROPAUTOCENTER_ON: the wheel's own centering spring */
+
+/* DirectInput magnitude range carried in FfbWireEffect.magnitude; also the range of gains. */
+#define FFB_MAGNITUDE_MAX 10000
+
+#pragma pack(push, 1)
+
+typedef struct FfbWireHeader {
+    uint32_t magic;        /* FFB_WIRE_MAGIC */
+    uint8_t  version;      /* FFB_WIRE_VERSION */
+    uint8_t  kind;         /* FFB_KIND_* */
+    uint16_t size;         /* total packet size in bytes, header included */
+    uint32_t seq;          /* per-sender sequence number, wraps */
+    uint16_t client_id;    /* sender's session in the daemon; 0: keyed by source address */
+    uint8_t  priority;     /* arbitration priority, higher wins (daemon --arbitrate priority) */
+    uint8_t  reserved;
+    uint64_t timestamp_us; /* sender monotonic clock, microseconds, when the game posted this state */
+} FfbWireHeader;
+
+typedef struct FfbWireEffect {
+    FfbWireHeader hdr;
+    uint16_t effect_id;    /* stable for the lifetime of the effect object */
+    uint8_t  effect_type;  /* FFB_EFFECT_* */
+    uint8_t  state;        /* FFB_STATE_* */
+    int16_t  magnitude;    /* -FFB_MAGNITUDE_MAX..FFB_MAGNITUDE_MAX, direction already applied */
+    uint16_t gain;         /* DIEFFECT.dwGain, 0..FFB_MAGNITUDE_MAX */
+} FfbWireEffect;
+
+/*
+ * Spring/Damper/Friction/Inertia parameters (DICONDITION for the steering axis).
+ * Sent once per SetParameters/Start/Stop; the daemon runs the condition loop itself
+ * against the wheel position. Coefficients, offset and saturations use DirectInput units.
+ */
+typedef struct FfbWireCondition {
+    FfbWireHeader hdr;
+    uint16_t effect_id;
+    uint8_t  effect_type;          /* FFB_EFFECT_SPRING..FFB_EFFECT_INERTIA */
+    uint8_t  state;                /* FFB_STATE_* */
+    int16_t  offset;               /* -10000..10000 */
+    int16_t  positive_coefficient; /* -10000..10000 */
+    int16_t  negative_coefficient; /* -10000..10000 */
+    uint16_t positive_saturation;  /* 0..10000 */
+    uint16_t negative_saturation;  /* 0..10000 */
+    uint16_t deadband;             /* 0..10000 */
+    uint16_t gain;                 /* DIEFFECT.dwGain, 0..10000 */
+    uint16_t reserved;
+} FfbWireCondition;
+
+/*
+ * Sine/Square/Triangle/Sawtooth parameters (DIPERIODIC). Sent on parameter changes only;
+ * the daemon synthesizes the waveform at its own tick rate.
+ */
+typedef struct FfbWirePeriodic {
+    FfbWireHeader hdr;
+    uint16_t effect_id;
+    uint8_t  effect_type;  /* FFB_EFFECT_SINE..FFB_EFFECT_SAW_DOWN */
+    uint8_t  state;        /* FFB_STATE_* */
+    uint16_t magnitude;    /* 0..10000 */
+    int16_t  offset;       /* -10000..10000 */
+    uint16_t phase;        /* starting phase, hundredths of a degree (0..35999) */
+    uint16_t gain;         /* DIEFFECT.dwGain, 0..10000 */
+    uint32_t period_us;
+} FfbWirePeriodic;
+
+/*
+ * Device-wide state: SendForceFeedbackCommand, DIPROP_FFGAIN and DIPROP_AUTOCENTER. Every packet carries
+ * the current device gain, so a lost gain update is repaired by the next command.
+ */
+typedef struct FfbWireDevice {
+    FfbWireHeader hdr;
+    uint8_t  command;      /* FFB_CMD_* */
+    uint8_t  reserved0;
+    uint16_t gain;         /* DIPROP_FFGAIN, 0..10000 */
+    uint32_t reserved;
+} FfbWireDevice;
+
+/*
+ * Liveness lease. The proxy's sender thread sends one every FFB_HEARTBEAT_MS for as long as
+ * the game keeps calling into DirectInput, so a steady force needs no resends: the daemon
+ * holds the last state until lease_ms after the latest heartbeat (or its own watchdog after
+ * the latest update, whichever is later). lease_ms 0 ends the lease (device released).
+ */
+typedef struct FfbWireHeartbeat {
+    FfbWireHeader hdr;
+    uint16_t lease_ms;
+    uint16_t reserved0;
+    uint32_t reserved;
+} FfbWireHeartbeat;
+
+#pragma pack(pop)
+
+#ifdef __cplusplus
+static_assert(sizeof(FfbWireHeader) == 24, "FfbWireHeader layout changed");
+static_assert(sizeof(FfbWireEffect) == 32, "FfbWireEffect layout changed");
+static_assert(sizeof(FfbWireCondition) == 44, "FfbWireCondition layout changed");
+static_assert(sizeof(FfbWirePeriodic) == 40, "FfbWirePeriodic layout changed");
+static_assert(sizeof(FfbWireDevice) == 32, "FfbWireDevice layout changed");
+static_assert(sizeof(FfbWireHeartbeat) == 32, "FfbWireHeartbeat layout changed");
+#endif
+
+static inline void ffb_wire_init_header(FfbWireHeader *h, uint8_t kind, uint16_t size,
+                                        uint32_t seq, uint64_t timestamp_us) {
+    h->magic = FFB_WIRE_MAGIC;
+    h->version = FFB_WIRE_VERSION;
+    h->kind = kind;
+    h->size = size;
+    h->seq = seq;
+    h->client_id = 0;
+    h->priority = 0;
+    h->reserved = 0;
+    h->timestamp_us = timestamp_us;
+}
+
+#endif /* FFB_WIRE_H */
@@ -8,6 +8,12 @@
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
+#include <atomic>
+
+#include "../common/ffb_wire.h"
+#include "../common/ffb_trace.h"
+#include "../common/ffb_shm.h"
 
 extern "C" const IID IID_IUnknown = {
     0x00000000, 0x0000, 0x0000, {0xC0,0x00,0x00,0x00,0x00,0x00,0x00,0x46}
@@ -17,26 +23,189 @@ static HMODULE g_real_dinput8 = NULL;
 typedef HRESULT (WINAPI *DirectInput8CreateFn)(HINSTANCE, DWORD, REFIID, LPVOID *, LPUNKNOWN);
 static DirectInput8CreateFn g_real_DirectInput8Create = NULL;
 
+// Build-time log level (-DFFB_LOG_LEVEL=n): 0 compiles every log line out, 1 keeps setup,
+// failures and the periodic stats, 2 (default) also logs every hooked call.
+#ifndef FFB_LOG_LEVEL
+#define FFB_LOG_LEVEL 2
+#endif
+#define FFB_LOG_INFO 1
+#define FFB_LOG_CALLS 2
+
+// A line below the build level is dead code; otherwise a disabled log costs one load and
+// branch. Either way the arguments (GUID strings included) are only evaluated when written.
+#define LOG_AT(level, ...) \
+    do { \
+        if (FFB_LOG_LEVEL >= (level) && g_log_enabled) logf(__VA_ARGS__); \
+    } while (0)
+#define LOG_INFO(...) LOG_AT(FFB_LOG_INFO, __VA_ARGS__)
+#define LOG_CALL(...) LOG_AT(FFB_LOG_CALLS, __VA_ARGS__)
+
 static CRITICAL_SECTION g_log_lock;
-static int g_log_init = 0;
-static int g_log_enabled = -1;
+static volatile LONG g_log_init = 0; // 0 = not yet, 1 = initializing, 2 = ready
+static int g_log_enabled = 0; // set by init_log, which DirectInput8Create runs first
 static ULONGLONG g_log_rate_ms = 0;
 static ULONGLONG g_log_last_ms = 0;
 static char g_proc_name[MAX_PATH] = {0};
 static DWORD g_proc_pid = 0;
 static ULONGLONG g_start_ms = 0;
 
+// Async logging: logf formats the line straight into a ring slot on the calling thread;
+// g_log_thread appends whole batches through one handle kept open. Any thread may log,
+// so slots are claimed with a per-slot sequence (bounded MPSC queue). A full ring drops
+// the line and counts it. FFB_LOG_ASYNC=0 goes back to open/append/close per line.
+#ifndef LOG_PATH
+#define LOG_PATH "C:\\ac_ffb_proxy.log"
+#endif
+#define LOG_RING_SLOTS 1024 /* power of two */
+#define LOG_LINE_BYTES 240
+#define LOG_FLUSH_MS 100
+#define LOG_BATCH_BYTES (64 * 1024)
+
+struct LogSlot {
+    std::atomic<unsigned> seq; // == position: free; == position + 1: filled
+    ULONGLONG ms;
+    int len;
+    char text[LOG_LINE_BYTES];
+};
+
+static int g_log_async = 1;
+static LogSlot g_log_ring[LOG_RING_SLOTS];
+static std::atomic<unsigned> g_log_head(0);
+static std::atomic<unsigned> g_log_tail(0); // advanced by the writer only
+static std::atomic<unsigned long long> g_log_dropped(0);
+static HANDLE g_log_wake = NULL;
+static HANDLE g_log_thread = NULL;
+static HANDLE g_log_file = INVALID_HANDLE_VALUE; // writer only
+static char g_log_batch[LOG_BATCH_BYTES];       // writer only
+
+// Binary call trace (FFB_TRACE=<path>): one FfbTraceRecord per hooked call, never throttled,
+// queued the same way as log lines and written by the same thread.
+#define TRACE_RING_SLOTS 4096 /* power of two */
+#define TRACE_BATCH_RECORDS 1024
+
+struct TraceSlot {
+    std::atomic<unsigned> seq;
+    FfbTraceRecord rec;
+};
+
+static TraceSlot g_trace_ring[TRACE_RING_SLOTS];
+static std::atomic<unsigned> g_trace_head(0);
+static std::atomic<unsigned> g_trace_tail(0); // advanced by the writer only
+static std::atomic<unsigned long long> g_trace_dropped(0);
+static HANDLE g_trace_file = INVALID_HANDLE_VALUE;
+static FfbTraceRecord g_trace_batch[TRACE_BATCH_RECORDS]; // writer only
+
 static CRITICAL_SECTION g_udp_lock;
 static int g_udp_init = 0;
 static int g_udp_ready = 0;
 static SOCKET g_udp_sock = INVALID_SOCKET;
 static struct sockaddr_in g_udp_addr;
+static int g_udp_binary = 1;
+static uint32_t g_udp_seq = 0; // guarded by g_udp_lock
+// The daemon's session for this process (see --arbitrate): one ID for UDP and shared memory.
+static uint16_t g_client_id = 0;  // FFB_CLIENT_ID, default the process ID
+static uint8_t g_priority = 100;  // FFB_PRIORITY, 0-255
+static volatile LONG g_next_effect_id = 0;
+// Bumped by STOPALL/RESET: an effect started before the bump is stopped until started again.
+static volatile LONG g_ffb_epoch = 0;
+static volatile LONG g_device_gain = FFB_MAGNITUDE_MAX; // DIPROP_FFGAIN
+static LARGE_INTEGER g_qpc_freq;
+
+// Async UDP: effect calls on any thread only push datagrams into a ring; g_udp_thread
+// drains it and does the sendto (and the shared-memory push) under g_udp_lock, which no
+// other thread takes. Slots are claimed with a per-slot sequence like the log ring, so
+// several game threads may push at once. FFB_UDP_ASYNC=0 sends inline instead.
+#define UDP_RING_SLOTS 256 /* power of two */
+#define UDP_SLOT_BYTES 124
+#define UDP_STATS_EVERY_MS 5000
+
+struct UdpSlot {
+    std::atomic<unsigned> seq; // == position: free; == position + 1: filled
+    int len;
+    char data[UDP_SLOT_BYTES];
+};
+
+static int g_udp_async = 1;
+static UdpSlot g_udp_ring[UDP_RING_SLOTS];
+static std::atomic<unsigned> g_udp_head(0);
+static std::atomic<unsigned> g_udp_tail(0); // written by the sender thread only
+static std::atomic<int> g_udp_sender_waiting(0);
+static HANDLE g_udp_wake = NULL;
+static HANDLE g_udp_thread = NULL;
+
+// Counters (relaxed; read by the sender thread for the periodic stats line).
+static std::atomic<unsigned> g_udp_depth_max(0);
+static std::atomic<unsigned long long> g_udp_queued(0);
+static std::atomic<unsigned long long> g_udp_dropped(0);
+static std::atomic<unsigned long long> g_udp_inline(0);
+static std::atomic<unsigned long long> g_udp_sent(0);
+static std::atomic<unsigned long long> g_udp_errors(0);
+
+// FFB_SHM: shared-memory ring to the daemon; datagrams fall back to UDP when it is not read.
+static FfbShmHeader *g_shm = NULL;
+static std::atomic<unsigned long long> g_shm_sent(0);
+static std::atomic<unsigned long long> g_shm_fallback(0);
+static std::atomic<unsigned long long> g_shm_doorbells(0);
+
+#define FORCE_MAILBOXES 64
+#define MAILBOX_VALID 0x8000000000000000ull
+
+struct ForceMailbox {
+    std::atomic<int> in_use;
+    std::atomic<int> closing;
+    std::atomic<int> urgent;
+    std::atomic<unsigned long long> latest; // packed snapshot, written by the game thread
+    std::atomic<unsigned long long> sent;   // packed snapshot, written by the sender thread
+    std::atomic<unsigned long long> posted_us; // when `latest` was posted, for the wire timestamp
+    ULONGLONG sent_us;            // sender thread only
+    uint16_t effect_id;
+    uint8_t effect_type;
+};
+
+static ForceMailbox g_mailboxes[FORCE_MAILBOXES];
+static std::atomic<int> g_mailbox_urgent(0);
+static ULONGLONG g_mailbox_min_interval_us = 1000000 / 200;
+static int g_mailbox_threshold = 200;
+static std::atomic<unsigned long long> g_mailbox_unchanged(0);
+static std::atomic<unsigned long long> g_mailbox_coalesced(0);
+
+// Lease heartbeats: the sender thread renews the daemon's hold on the current forces every
+// g_heartbeat_ms, but only if the game read the wheel since the previous heartbeat, so a
+// steady force needs no resends and a hung or crashed game still lets the lease lapse.
+static ULONGLONG g_heartbeat_ms = 100; // FFB_HEARTBEAT_MS, 0 = off
+static int g_lease_ms = 300;           // FFB_LEASE_MS, default three heartbeats
+static std::atomic<int> g_game_active(0);
+static std::atomic<unsigned long long> g_heartbeats(0);
+
+static DWORD WINAPI log_thread_main(LPVOID param);
+static ULONGLONG now_us();
+
+static void start_log_thread() {
+    for (unsigned i = 0; i < LOG_RING_SLOTS; i++) {
+        g_log_ring[i].seq.store(i, std::memory_order_relaxed);
+    }
+    for (unsigned i = 0; i < TRACE_RING_SLOTS; i++) {
+        g_trace_ring[i].seq.store(i, std::memory_order_relaxed);
+    }
+    g_log_wake = CreateEventA(NULL, FALSE, FALSE, NULL);
+    if (!g_log_wake) return;
+    g_log_thread = CreateThread(NULL, 0, log_thread_main, NULL, 0, NULL);
+    if (!g_log_thread) {
+        CloseHandle(g_log_wake);
+        g_log_wake = NULL;
+    }
+}
 
 static void init_log() {
-    if (g_log_init) return;
-    g_log_init = 1;
+    if (g_log_init == 2) return;
+    if (InterlockedCompareExchange(&g_log_init, 1, 0) != 0) {
+        while (g_log_init != 2) Sleep(0);
+        return;
+    }
     const char *env_log = getenv("FFB_LOG");
-    if (env_log && (env_log[0] == '0' || env_log[0] == 'n' || env_log[0] == 'N' || env_log[0] == 'f' || env_log[0] == 'F')) {
+    if (FFB_LOG_LEVEL == 0) {
+        g_log_enabled = 0;
+    } else if (env_log && (env_log[0] == '0' || env_log[0] == 'n' || env_log[0] == 'N' || env_log[0] == 'f' || env_log[0] == 'F')) {
         g_log_enabled = 0;
     } else {
         g_log_enabled = 1;
@@ -46,25 +215,205 @@ static void init_log() {
         long rate = atol(env_rate);
         if (rate > 0) g_log_rate_ms = (ULONGLONG)rate;
     }
-    if (!g_log_enabled) return;
+    const char *env_async = getenv("FFB_LOG_ASYNC");
+    if (env_async && env_async[0] == '0') g_log_async = 0;
+
+    if (g_log_enabled) {
+        InitializeCriticalSection(&g_log_lock);
+        g_proc_pid = GetCurrentProcessId();
+        GetModuleFileNameA(NULL, g_proc_name, MAX_PATH);
+        g_start_ms = GetTickCount64();
+    }
+
+    // One file per process: launchers load dinput8 too.
+    const char *env_trace = getenv("FFB_TRACE");
+    if (env_trace && env_trace[0] != '\0') {
+        char path[MAX_PATH];
+        _snprintf(path, sizeof(path), "%s.%lu", env_trace, (unsigned long)GetCurrentProcessId());
+        path[sizeof(path) - 1] = '\0';
+        g_trace_file = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                                   FILE_ATTRIBUTE_NORMAL, NULL);
+        if (g_trace_file != INVALID_HANDLE_VALUE) {
+            FfbTraceHeader hdr;
+            hdr.magic = FFB_TRACE_MAGIC;
+            hdr.version = FFB_TRACE_VERSION;
+            hdr.record_size = (uint16_t)sizeof(FfbTraceRecord);
+            hdr.pid = (uint32_t)GetCurrentProcessId();
+            hdr.reserved = 0;
+            hdr.start_us = now_us();
+            DWORD written = 0;
+            WriteFile(g_trace_file, &hdr, (DWORD)sizeof(hdr), &written, NULL);
+        }
+    }
 
-    InitializeCriticalSection(&g_log_lock);
-    g_proc_pid = GetCurrentProcessId();
-    GetModuleFileNameA(NULL, g_proc_name, MAX_PATH);
-    g_start_ms = GetTickCount64();
+    if ((g_log_enabled && g_log_async) || g_trace_file != INVALID_HANDLE_VALUE) start_log_thread();
+    if (g_trace_file != INVALID_HANDLE_VALUE && !g_log_thread) {
+        CloseHandle(g_trace_file);
+        g_trace_file = INVALID_HANDLE_VALUE;
+    }
+    InterlockedExchange(&g_log_init, 2);
 }
 
-static void logf(const char *fmt, ...) {
-    init_log();
-    if (!g_log_enabled) return;
+static int log_prefix(char *out, size_t out_len, ULONGLONG now) {
+    ULONGLONG delta = (g_start_ms == 0) ? 0 : (now - g_start_ms);
+    return _snprintf(out, out_len, "[%llu ms][%lu:%s] ", (unsigned long long)delta, (unsigned long)g_proc_pid, g_proc_name);
+}
+
+// Claims the next free slot of a log or trace ring; false when the ring is full.
+template <typename Slot, unsigned N>
+static bool ring_claim(Slot (&ring)[N], std::atomic<unsigned> &head, unsigned *pos_out) {
+    unsigned pos = head.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot &slot = ring[pos & (N - 1)];
+        int diff = (int)(slot.seq.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                *pos_out = pos;
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+static void log_enqueue(ULONGLONG now, const char *fmt, va_list ap) {
+    unsigned pos;
+    if (!ring_claim(g_log_ring, g_log_head, &pos)) {
+        g_log_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    LogSlot &slot = g_log_ring[pos & (LOG_RING_SLOTS - 1)];
+    int n = _vsnprintf(slot.text, LOG_LINE_BYTES, fmt, ap);
+    slot.len = (n < 0 || n >= LOG_LINE_BYTES) ? LOG_LINE_BYTES - 1 : n;
+    slot.ms = now;
+    slot.seq.store(pos + 1, std::memory_order_release);
+
+    // The writer flushes on its own every LOG_FLUSH_MS; only a half-full ring wakes it early.
+    if (pos + 1 - g_log_tail.load(std::memory_order_relaxed) == LOG_RING_SLOTS / 2) {
+        SetEvent(g_log_wake);
+    }
+}
 
+static void log_write(const char *data, size_t len) {
+    if (g_log_file == INVALID_HANDLE_VALUE) {
+        g_log_file = CreateFileA(LOG_PATH, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                                 OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (g_log_file == INVALID_HANDLE_VALUE) return;
+    }
+    DWORD written = 0;
+    WriteFile(g_log_file, data, (DWORD)len, &written, NULL);
+}
+
+// Writer only (or the process-exit path, once every other thread is gone).
+static void log_drain() {
+    size_t used = 0;
+    unsigned tail = g_log_tail.load(std::memory_order_relaxed);
+    for (;;) {
+        LogSlot &slot = g_log_ring[tail & (LOG_RING_SLOTS - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != tail + 1) break;
+        if (used + MAX_PATH + LOG_LINE_BYTES + 64 > LOG_BATCH_BYTES) {
+            log_write(g_log_batch, used);
+            used = 0;
+        }
+        int n = log_prefix(g_log_batch + used, LOG_BATCH_BYTES - used, slot.ms);
+        if (n > 0) used += (size_t)n;
+        memcpy(g_log_batch + used, slot.text, (size_t)slot.len);
+        used += (size_t)slot.len;
+        g_log_batch[used++] = '\r';
+        g_log_batch[used++] = '\n';
+        slot.seq.store(tail + LOG_RING_SLOTS, std::memory_order_release);
+        tail += 1;
+        g_log_tail.store(tail, std::memory_order_relaxed);
+    }
+    if (used > 0) log_write(g_log_batch, used);
+}
+
+static void trace_call(uint8_t call, uint16_t effect_id, uint8_t effect_type, uint32_t flags,
+                       const int32_t *params, int count) {
+    if (g_trace_file == INVALID_HANDLE_VALUE) return;
+    unsigned pos;
+    if (!ring_claim(g_trace_ring, g_trace_head, &pos)) {
+        g_trace_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TraceSlot &slot = g_trace_ring[pos & (TRACE_RING_SLOTS - 1)];
+    FfbTraceRecord &r = slot.rec;
+    r.t_us = now_us();
+    r.call = call;
+    r.effect_type = effect_type;
+    r.effect_id = effect_id;
+    r.flags = flags;
+    for (int i = 0; i < FFB_TRACE_PARAMS; i++) r.p[i] = i < count ? params[i] : 0;
+    slot.seq.store(pos + 1, std::memory_order_release);
+    if (pos + 1 - g_trace_tail.load(std::memory_order_relaxed) == TRACE_RING_SLOTS / 2) {
+        SetEvent(g_log_wake);
+    }
+}
+
+static void trace_drain() {
+    if (g_trace_file == INVALID_HANDLE_VALUE) return;
+    int used = 0;
+    unsigned tail = g_trace_tail.load(std::memory_order_relaxed);
+    DWORD written = 0;
+    for (;;) {
+        TraceSlot &slot = g_trace_ring[tail & (TRACE_RING_SLOTS - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != tail + 1) break;
+        g_trace_batch[used++] = slot.rec;
+        slot.seq.store(tail + TRACE_RING_SLOTS, std::memory_order_release);
+        tail += 1;
+        g_trace_tail.store(tail, std::memory_order_relaxed);
+        if (used == TRACE_BATCH_RECORDS) {
+            WriteFile(g_trace_file, g_trace_batch, (DWORD)(used * sizeof(FfbTraceRecord)), &written, NULL);
+            used = 0;
+        }
+    }
+    if (used > 0) WriteFile(g_trace_file, g_trace_batch, (DWORD)(used * sizeof(FfbTraceRecord)), &written, NULL);
+}
+
+static DWORD WINAPI log_thread_main(LPVOID param) {
+    (void)param;
+    unsigned long long reported = 0;
+    unsigned long long trace_reported = 0;
+    for (;;) {
+        WaitForSingleObject(g_log_wake, LOG_FLUSH_MS);
+        trace_drain();
+        log_drain();
+        if (!g_log_enabled || !g_log_async) continue;
+        unsigned long long dropped = g_log_dropped.load(std::memory_order_relaxed);
+        unsigned long long trace_dropped = g_trace_dropped.load(std::memory_order_relaxed);
+        if (dropped != reported || trace_dropped != trace_reported) {
+            char line[128];
+            int n = _snprintf(line, sizeof(line), "[proxy] ring full; %llu log lines, %llu trace records dropped so far\r\n",
+                              dropped, trace_dropped);
+            if (n > 0) log_write(line, (size_t)n);
+            reported = dropped;
+            trace_reported = trace_dropped;
+        }
+    }
+    return 0;
+}
+
+// Called through LOG_INFO/LOG_CALL, which already checked g_log_enabled.
+static void logf(const char *fmt, ...) {
     ULONGLONG now = GetTickCount64();
     if (g_log_rate_ms > 0 && (now - g_log_last_ms) < g_log_rate_ms) {
         return;
     }
 
+    if (g_log_async && g_log_thread) {
+        g_log_last_ms = now;
+        va_list ap;
+        va_start(ap, fmt);
+        log_enqueue(now, fmt, ap);
+        va_end(ap);
+        return;
+    }
+
     EnterCriticalSection(&g_log_lock);
-    FILE *f = fopen("C:\\ac_ffb_proxy.log", "a");
+    FILE *f = fopen(LOG_PATH, "a");
     if (f) {
         g_log_last_ms = now;
         ULONGLONG delta = (g_start_ms == 0) ? 0 : (now - g_start_ms);
@@ -79,6 +428,383 @@ static void logf(const char *fmt, ...) {
     LeaveCriticalSection(&g_log_lock);
 }
 
+static void udp_sendto_now(const void *data, int len) {
+    char stamped[UDP_SLOT_BYTES];
+    EnterCriticalSection(&g_udp_lock);
+    // Sequence numbers are assigned in send order, so packets that went through the ring
+    // and packets flushed from a mailbox can never look reordered to the daemon.
+    if (len >= (int)sizeof(FfbWireHeader) && len <= UDP_SLOT_BYTES &&
+        ((const FfbWireHeader *)data)->magic == FFB_WIRE_MAGIC) {
+        memcpy(stamped, data, (size_t)len);
+        FfbWireHeader *hdr = (FfbWireHeader *)stamped;
+        hdr->seq = ++g_udp_seq;
+        hdr->client_id = g_client_id;
+        hdr->priority = g_priority;
+        data = stamped;
+    }
+    if (g_shm) {
+        int wake = 0;
+        if (ffb_shm_push(g_shm, data, len, &wake)) {
+            // The daemon is waiting for a wakeup instead of polling: ring the doorbell.
+            if (wake) {
+                sendto(g_udp_sock, "", 0, 0, (const struct sockaddr *)&g_udp_addr, sizeof(g_udp_addr));
+                g_shm_doorbells.fetch_add(1, std::memory_order_relaxed);
+            }
+            LeaveCriticalSection(&g_udp_lock);
+            g_shm_sent.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        g_shm_fallback.fetch_add(1, std::memory_order_relaxed);
+    }
+    int r = sendto(g_udp_sock, (const char *)data, len, 0, (const struct sockaddr *)&g_udp_addr, sizeof(g_udp_addr));
+    LeaveCriticalSection(&g_udp_lock);
+    if (r == SOCKET_ERROR) {
+        g_udp_errors.fetch_add(1, std::memory_order_relaxed);
+        LOG_INFO("[proxy] UDP sendto failed: %d", WSAGetLastError());
+    } else {
+        g_udp_sent.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+static ULONGLONG now_us() {
+    if (g_qpc_freq.QuadPart == 0) QueryPerformanceFrequency(&g_qpc_freq);
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    ULONGLONG secs = (ULONGLONG)(t.QuadPart / g_qpc_freq.QuadPart);
+    ULONGLONG rem = (ULONGLONG)(t.QuadPart % g_qpc_freq.QuadPart);
+    return secs * 1000000ULL + (rem * 1000000ULL) / (ULONGLONG)g_qpc_freq.QuadPart;
+}
+
+static int clamp_int(int v, int lo, int hi) {
+    if (v < lo) return lo;
+    if (v > hi) return hi;
+    return v;
+}
+
+static uint16_t next_effect_id() {
+    return (uint16_t)InterlockedIncrement(&g_next_effect_id);
+}
+
+static uint8_t effect_type_from_guid(const GUID &g) {
+    if (IsEqualGUID(g, GUID_ConstantForce)) return FFB_EFFECT_CONSTANT;
+    if (IsEqualGUID(g, GUID_RampForce)) return FFB_EFFECT_RAMP;
+    if (IsEqualGUID(g, GUID_Spring)) return FFB_EFFECT_SPRING;
+    if (IsEqualGUID(g, GUID_Damper)) return FFB_EFFECT_DAMPER;
+    if (IsEqualGUID(g, GUID_Friction)) return FFB_EFFECT_FRICTION;
+    if (IsEqualGUID(g, GUID_Inertia)) return FFB_EFFECT_INERTIA;
+    if (IsEqualGUID(g, GUID_Sine)) return FFB_EFFECT_SINE;
+    if (IsEqualGUID(g, GUID_Square)) return FFB_EFFECT_SQUARE;
+    if (IsEqualGUID(g, GUID_Triangle)) return FFB_EFFECT_TRIANGLE;
+    if (IsEqualGUID(g, GUID_SawtoothUp)) return FFB_EFFECT_SAW_UP;
+    if (IsEqualGUID(g, GUID_SawtoothDown)) return FFB_EFFECT_SAW_DOWN;
+    return FFB_EFFECT_CUSTOM;
+}
+
+// Encodes one effect snapshot in the active wire format. Binary packets carry full
+// state, so the daemon can apply any single one of them as-is. stamp_us is when the
+// game posted this state, so the daemon can measure latency from the DirectInput call.
+static int encode_effect(char *out, uint16_t effect_id, uint8_t effect_type, uint8_t state, int magnitude, int gain,
+                         ULONGLONG stamp_us) {
+    if (!g_udp_binary) {
+        int scaled = clamp_int((int)(((long long)magnitude * gain / FFB_MAGNITUDE_MAX) * 100 / 10000), -100, 100);
+        if (state != FFB_STATE_PLAYING || scaled == 0) {
+            memcpy(out, "STOP", 4);
+            return 4;
+        }
+        return _snprintf(out, UDP_SLOT_BYTES, "CONST %d", scaled);
+    }
+    FfbWireEffect pkt;
+    ffb_wire_init_header(&pkt.hdr, FFB_KIND_EFFECT, (uint16_t)sizeof(pkt), 0, stamp_us);
+    pkt.effect_id = effect_id;
+    pkt.effect_type = effect_type;
+    pkt.state = state;
+    pkt.magnitude = (int16_t)clamp_int(magnitude, -FFB_MAGNITUDE_MAX, FFB_MAGNITUDE_MAX);
+    pkt.gain = (uint16_t)clamp_int(gain, 0, FFB_MAGNITUDE_MAX);
+    memcpy(out, &pkt, sizeof(pkt));
+    return (int)sizeof(pkt);
+}
+
+static void wake_udp_thread() {
+    if (g_udp_sender_waiting.exchange(0, std::memory_order_acq_rel)) {
+        SetEvent(g_udp_wake);
+    }
+}
+
+// Any thread. A full ring drops the datagram and counts it; the caller never waits.
+static void udp_enqueue(const void *data, int len) {
+    unsigned pos;
+    if (!ring_claim(g_udp_ring, g_udp_head, &pos)) {
+        g_udp_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    UdpSlot &slot = g_udp_ring[pos & (UDP_RING_SLOTS - 1)];
+    slot.len = len;
+    memcpy(slot.data, data, (size_t)len);
+    slot.seq.store(pos + 1, std::memory_order_release);
+    g_udp_queued.fetch_add(1, std::memory_order_relaxed);
+
+    unsigned depth = pos + 1 - g_udp_tail.load(std::memory_order_relaxed);
+    unsigned max = g_udp_depth_max.load(std::memory_order_relaxed);
+    while (depth > max && !g_udp_depth_max.compare_exchange_weak(max, depth, std::memory_order_relaxed)) {
+    }
+    wake_udp_thread();
+}
+
+static void log_udp_stats() {
+    unsigned depth = g_udp_head.load(std::memory_order_relaxed) - g_udp_tail.load(std::memory_order_relaxed);
+    LOG_INFO("[proxy] UDP stats depth=%u maxDepth=%u queued=%llu dropped=%llu inline=%llu sent=%llu errors=%llu "
+         "unchanged=%llu coalesced=%llu shm=%llu shmFallback=%llu doorbells=%llu heartbeats=%llu",
+         depth,
+         g_udp_depth_max.load(std::memory_order_relaxed),
+         g_udp_queued.load(std::memory_order_relaxed),
+         g_udp_dropped.load(std::memory_order_relaxed),
+         g_udp_inline.load(std::memory_order_relaxed),
+         g_udp_sent.load(std::memory_order_relaxed),
+         g_udp_errors.load(std::memory_order_relaxed),
+         g_mailbox_unchanged.load(std::memory_order_relaxed),
+         g_mailbox_coalesced.load(std::memory_order_relaxed),
+         g_shm_sent.load(std::memory_order_relaxed),
+         g_shm_fallback.load(std::memory_order_relaxed),
+         g_shm_doorbells.load(std::memory_order_relaxed),
+         g_heartbeats.load(std::memory_order_relaxed));
+}
+
+static void init_udp();
+
+// Latest-value-wins mailboxes. The game thread overwrites an effect's snapshot and
+// only wakes the sender thread when the change is large (or a state change); small
+// changes are picked up by the sender thread at most every g_mailbox_min_interval_us.
+// Identical snapshots are never sent twice.
+static unsigned long long mailbox_pack(uint8_t state, int magnitude, int gain) {
+    int m = clamp_int(magnitude, -FFB_MAGNITUDE_MAX, FFB_MAGNITUDE_MAX);
+    int g = clamp_int(gain, 0, FFB_MAGNITUDE_MAX);
+    return MAILBOX_VALID | ((unsigned long long)g << 32) | ((unsigned long long)state << 16) |
+           (unsigned long long)(uint16_t)(int16_t)m;
+}
+
+static uint8_t mailbox_state(unsigned long long snap) { return (uint8_t)((snap >> 16) & 0xFF); }
+static int mailbox_magnitude(unsigned long long snap) { return (int)(int16_t)(uint16_t)(snap & 0xFFFF); }
+static int mailbox_gain(unsigned long long snap) { return (int)((snap >> 32) & 0xFFFF); }
+
+static ForceMailbox *claim_mailbox(uint16_t effect_id, uint8_t effect_type) {
+    init_udp();
+    if (!g_udp_thread || g_mailbox_min_interval_us == 0) return NULL;
+    for (int i = 0; i < FORCE_MAILBOXES; i++) {
+        ForceMailbox *mb = &g_mailboxes[i];
+        int expected = 0;
+        if (!mb->in_use.compare_exchange_strong(expected, 1, std::memory_order_acquire)) continue;
+        mb->effect_id = effect_id;
+        mb->effect_type = effect_type;
+        mb->sent_us = 0;
+        mb->urgent.store(0, std::memory_order_relaxed);
+        mb->latest.store(0, std::memory_order_release);
+        mb->sent.store(0, std::memory_order_release);
+        mb->posted_us.store(0, std::memory_order_relaxed);
+        return mb;
+    }
+    LOG_INFO("[proxy] mailbox table full; effect %u sends every update", (unsigned)effect_id);
+    return NULL;
+}
+
+static void post_mailbox(ForceMailbox *mb, uint8_t state, int magnitude, int gain) {
+    unsigned long long snap = mailbox_pack(state, magnitude, gain);
+    // Published by the exchange below; a flush may pair a snapshot with a newer stamp, never an older one.
+    mb->posted_us.store(now_us(), std::memory_order_relaxed);
+    unsigned long long prev = mb->latest.exchange(snap, std::memory_order_acq_rel);
+    if (prev == snap) {
+        g_mailbox_unchanged.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    unsigned long long sent = mb->sent.load(std::memory_order_acquire);
+    if (sent == snap) return;
+    int delta = mailbox_magnitude(snap) - mailbox_magnitude(sent);
+    if (delta < 0) delta = -delta;
+    if (!(sent & MAILBOX_VALID) || mailbox_state(sent) != state || mailbox_gain(sent) != mailbox_gain(snap) ||
+        delta >= g_mailbox_threshold) {
+        mb->urgent.store(1, std::memory_order_release);
+        g_mailbox_urgent.store(1, std::memory_order_seq_cst);
+        wake_udp_thread();
+    } else {
+        g_mailbox_coalesced.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// The effect is going away: post a final stop and let the sender thread free the slot.
+static void release_mailbox(ForceMailbox *mb) {
+    if (!mb) return;
+    unsigned long long latest = mb->latest.load(std::memory_order_acquire);
+    if ((latest & MAILBOX_VALID) && mailbox_state(latest) == FFB_STATE_PLAYING) {
+        post_mailbox(mb, FFB_STATE_STOPPED, 0, mailbox_gain(latest));
+    }
+    mb->closing.store(1, std::memory_order_release);
+    g_mailbox_urgent.store(1, std::memory_order_seq_cst);
+    wake_udp_thread();
+}
+
+// STOPALL/RESET: overwrite every pending snapshot, so a coalesced value posted before the
+// command can never be flushed after it and restart the effect.
+static void stop_all_mailboxes() {
+    for (int i = 0; i < FORCE_MAILBOXES; i++) {
+        ForceMailbox *mb = &g_mailboxes[i];
+        if (!mb->in_use.load(std::memory_order_acquire)) continue;
+        unsigned long long latest = mb->latest.load(std::memory_order_acquire);
+        if ((latest & MAILBOX_VALID) && mailbox_state(latest) == FFB_STATE_PLAYING) {
+            post_mailbox(mb, FFB_STATE_STOPPED, 0, mailbox_gain(latest));
+        }
+    }
+}
+
+// Sender thread only. Returns how long it may sleep before a coalesced update is due.
+static DWORD flush_mailboxes() {
+    g_mailbox_urgent.store(0, std::memory_order_seq_cst);
+    DWORD wait_ms = UDP_STATS_EVERY_MS;
+    ULONGLONG now = 0;
+    for (int i = 0; i < FORCE_MAILBOXES; i++) {
+        ForceMailbox *mb = &g_mailboxes[i];
+        if (!mb->in_use.load(std::memory_order_acquire)) continue;
+        unsigned long long latest = mb->latest.load(std::memory_order_acquire);
+        unsigned long long sent = mb->sent.load(std::memory_order_relaxed);
+        if (latest != sent && (latest & MAILBOX_VALID)) {
+            if (now == 0) now = now_us();
+            ULONGLONG elapsed = now - mb->sent_us;
+            if (mb->urgent.exchange(0, std::memory_order_acq_rel) || elapsed >= g_mailbox_min_interval_us) {
+                char buf[UDP_SLOT_BYTES];
+                int len = encode_effect(buf, mb->effect_id, mb->effect_type, mailbox_state(latest),
+                                        mailbox_magnitude(latest), mailbox_gain(latest),
+                                        mb->posted_us.load(std::memory_order_relaxed));
+                udp_sendto_now(buf, len);
+                mb->sent.store(latest, std::memory_order_release);
+                mb->sent_us = now;
+            } else {
+                DWORD due_ms = (DWORD)((g_mailbox_min_interval_us - elapsed + 999) / 1000);
+                if (due_ms < wait_ms) wait_ms = due_ms;
+            }
+            continue;
+        }
+        if (mb->closing.load(std::memory_order_acquire)) {
+            mb->closing.store(0, std::memory_order_relaxed);
+            mb->in_use.store(0, std::memory_order_release);
+        }
+    }
+    return wait_ms;
+}
+
+// Called on every read of the wheel; the flag only changes once per heartbeat.
+static inline void note_game_alive() {
+    if (!g_game_active.load(std::memory_order_relaxed)) g_game_active.store(1, std::memory_order_relaxed);
+}
+
+static int encode_heartbeat(char *out, int lease_ms) {
+    FfbWireHeartbeat pkt;
+    ffb_wire_init_header(&pkt.hdr, FFB_KIND_HEARTBEAT, (uint16_t)sizeof(pkt), 0, now_us());
+    pkt.lease_ms = (uint16_t)lease_ms;
+    pkt.reserved0 = 0;
+    pkt.reserved = 0;
+    memcpy(out, &pkt, sizeof(pkt));
+    return (int)sizeof(pkt);
+}
+
+static DWORD WINAPI udp_thread_main(LPVOID param) {
+    (void)param;
+    ULONGLONG last_stats_ms = GetTickCount64();
+    ULONGLONG last_heartbeat_ms = 0;
+    for (;;) {
+        unsigned tail = g_udp_tail.load(std::memory_order_relaxed);
+        for (;;) {
+            UdpSlot &slot = g_udp_ring[tail & (UDP_RING_SLOTS - 1)];
+            if (slot.seq.load(std::memory_order_acquire) != tail + 1) break;
+            udp_sendto_now(slot.data, slot.len);
+            slot.seq.store(tail + UDP_RING_SLOTS, std::memory_order_release);
+            tail += 1;
+            g_udp_tail.store(tail, std::memory_order_relaxed);
+        }
+
+        DWORD wait_ms = flush_mailboxes();
+
+        ULONGLONG now = GetTickCount64();
+        if (g_heartbeat_ms) {
+            if (now - last_heartbeat_ms >= g_heartbeat_ms) {
+                last_heartbeat_ms = now;
+                if (g_game_active.exchange(0, std::memory_order_relaxed)) {
+                    char buf[UDP_SLOT_BYTES];
+                    udp_sendto_now(buf, encode_heartbeat(buf, g_lease_ms));
+                    g_heartbeats.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            DWORD due_ms = (DWORD)(last_heartbeat_ms + g_heartbeat_ms - now);
+            if (due_ms < wait_ms) wait_ms = due_ms;
+        }
+        if (now - last_stats_ms >= UDP_STATS_EVERY_MS) {
+            last_stats_ms = now;
+            log_udp_stats();
+        }
+
+        // Announce the wait, then re-check so a push racing with us is never missed. A slot
+        // claimed but not yet filled is waited for: its producer wakes us once it is.
+        g_udp_sender_waiting.store(1, std::memory_order_seq_cst);
+        if (g_udp_ring[tail & (UDP_RING_SLOTS - 1)].seq.load(std::memory_order_seq_cst) == tail + 1 ||
+            g_mailbox_urgent.load(std::memory_order_seq_cst)) {
+            g_udp_sender_waiting.store(0, std::memory_order_relaxed);
+            continue;
+        }
+        WaitForSingleObject(g_udp_wake, wait_ms);
+    }
+    return 0;
+}
+
+static void start_udp_thread() {
+    for (unsigned i = 0; i < UDP_RING_SLOTS; i++) {
+        g_udp_ring[i].seq.store(i, std::memory_order_relaxed);
+    }
+    g_udp_wake = CreateEventA(NULL, FALSE, FALSE, NULL);
+    if (!g_udp_wake) {
+        LOG_INFO("[proxy] UDP CreateEvent failed; sending inline");
+        return;
+    }
+    g_udp_thread = CreateThread(NULL, 0, udp_thread_main, NULL, 0, NULL);
+    if (!g_udp_thread) {
+        LOG_INFO("[proxy] UDP CreateThread failed; sending inline");
+        CloseHandle(g_udp_wake);
+        g_udp_wake = NULL;
+    }
+}
+
+// Maps the file the daemon created with --shm (e.g. FFB_SHM=Z:\tmp\g29ffb.shm). Any failure
+// leaves g_shm NULL and everything goes over UDP as before.
+static void init_shm() {
+    char path[MAX_PATH] = {0};
+    DWORD len = GetEnvironmentVariableA("FFB_SHM", path, (DWORD)sizeof(path));
+    if (len == 0 || len >= sizeof(path)) return;
+
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        LOG_INFO("[proxy] FFB_SHM %s: open failed (%lu); is the daemon running with --shm? Using UDP", path,
+             (unsigned long)GetLastError());
+        return;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, 0, (DWORD)FFB_SHM_FILE_BYTES, NULL);
+    CloseHandle(file);
+    if (!mapping) {
+        LOG_INFO("[proxy] FFB_SHM %s: CreateFileMapping failed (%lu); using UDP", path, (unsigned long)GetLastError());
+        return;
+    }
+    void *view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, FFB_SHM_FILE_BYTES);
+    CloseHandle(mapping);
+    if (!view) {
+        LOG_INFO("[proxy] FFB_SHM %s: MapViewOfFile failed (%lu); using UDP", path, (unsigned long)GetLastError());
+        return;
+    }
+    if (!ffb_shm_valid((const FfbShmHeader *)view)) {
+        LOG_INFO("[proxy] FFB_SHM %s: not a version %d ring; using UDP", path, FFB_SHM_VERSION);
+        UnmapViewOfFile(view);
+        return;
+    }
+    g_shm = (FfbShmHeader *)view;
+    LOG_INFO("[proxy] FFB_SHM %s mapped; daemon %s", path,
+         __atomic_load_n(&g_shm->consumer_active, __ATOMIC_ACQUIRE) ? "attached" : "not attached yet");
+}
+
 static void init_udp() {
     if (g_udp_init) return;
     InitializeCriticalSection(&g_udp_lock);
@@ -100,16 +826,72 @@ static void init_udp() {
         if (port <= 0 || port > 65535) port = 21999;
     }
 
+    char proto_buf[16] = {0};
+    DWORD proto_len = GetEnvironmentVariableA("FFB_PROTO", proto_buf, (DWORD)sizeof(proto_buf));
+    if (proto_len > 0 && proto_len < sizeof(proto_buf) && _stricmp(proto_buf, "text") == 0) {
+        g_udp_binary = 0;
+    }
+
+    char async_buf[8] = {0};
+    DWORD async_len = GetEnvironmentVariableA("FFB_UDP_ASYNC", async_buf, (DWORD)sizeof(async_buf));
+    if (async_len > 0 && async_len < sizeof(async_buf) && async_buf[0] == '0') {
+        g_udp_async = 0;
+    }
+
+    char rate_buf[16] = {0};
+    DWORD rate_len = GetEnvironmentVariableA("FFB_MAX_RATE_HZ", rate_buf, (DWORD)sizeof(rate_buf));
+    if (rate_len > 0 && rate_len < sizeof(rate_buf)) {
+        int hz = atoi(rate_buf);
+        g_mailbox_min_interval_us = hz > 0 ? (ULONGLONG)(1000000 / hz) : 0;
+    }
+
+    char hb_buf[16] = {0};
+    DWORD hb_len = GetEnvironmentVariableA("FFB_HEARTBEAT_MS", hb_buf, (DWORD)sizeof(hb_buf));
+    if (hb_len > 0 && hb_len < sizeof(hb_buf)) {
+        g_heartbeat_ms = (ULONGLONG)clamp_int(atoi(hb_buf), 0, 10000);
+        g_lease_ms = clamp_int(3 * (int)g_heartbeat_ms, 0, 65535);
+    }
+
+    char lease_buf[16] = {0};
+    DWORD lease_len = GetEnvironmentVariableA("FFB_LEASE_MS", lease_buf, (DWORD)sizeof(lease_buf));
+    if (lease_len > 0 && lease_len < sizeof(lease_buf)) {
+        g_lease_ms = clamp_int(atoi(lease_buf), 1, 65535);
+    }
+    // Heartbeats are binary, and need the sender thread's timer.
+    if (!g_udp_binary || !g_udp_async) g_heartbeat_ms = 0;
+
+    char id_buf[16] = {0};
+    DWORD id_len = GetEnvironmentVariableA("FFB_CLIENT_ID", id_buf, (DWORD)sizeof(id_buf));
+    if (id_len > 0 && id_len < sizeof(id_buf)) {
+        g_client_id = (uint16_t)clamp_int(atoi(id_buf), 0, 65535);
+    } else {
+        // 0 would mean "no ID"; a process ID that folds to 0 takes 1 instead.
+        g_client_id = (uint16_t)GetCurrentProcessId();
+        if (g_client_id == 0) g_client_id = 1;
+    }
+
+    char prio_buf[16] = {0};
+    DWORD prio_len = GetEnvironmentVariableA("FFB_PRIORITY", prio_buf, (DWORD)sizeof(prio_buf));
+    if (prio_len > 0 && prio_len < sizeof(prio_buf)) {
+        g_priority = (uint8_t)clamp_int(atoi(prio_buf), 0, 255);
+    }
+
+    char thr_buf[16] = {0};
+    DWORD thr_len = GetEnvironmentVariableA("FFB_CHANGE_THRESHOLD", thr_buf, (DWORD)sizeof(thr_buf));
+    if (thr_len > 0 && thr_len < sizeof(thr_buf)) {
+        g_mailbox_threshold = clamp_int(atoi(thr_buf), 0, FFB_MAGNITUDE_MAX);
+    }
+
     WSADATA wsa;
     if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
-        logf("[proxy] UDP WSAStartup failed");
+        LOG_INFO("[proxy] UDP WSAStartup failed");
         g_udp_ready = 0;
         return;
     }
 
     g_udp_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
     if (g_udp_sock == INVALID_SOCKET) {
-        logf("[proxy] UDP socket failed: %d", WSAGetLastError());
+        LOG_INFO("[proxy] UDP socket failed: %d", WSAGetLastError());
         g_udp_ready = 0;
         return;
     }
@@ -118,58 +900,234 @@ static void init_udp() {
     g_udp_addr.sin_family = AF_INET;
     g_udp_addr.sin_port = htons((u_short)port);
     if (InetPtonA(AF_INET, host, &g_udp_addr.sin_addr) != 1) {
-        logf("[proxy] UDP invalid host: %s", host);
+        LOG_INFO("[proxy] UDP invalid host: %s", host);
         g_udp_ready = 0;
         return;
     }
 
     g_udp_ready = 1;
-    logf("[proxy] UDP target %s:%d", host, port);
+    init_shm();
+    if (g_udp_async) start_udp_thread();
+    if (!g_udp_thread) g_heartbeat_ms = 0;
+    LOG_INFO("[proxy] UDP target %s:%d proto=%s async=%d maxRateHz=%d threshold=%d heartbeatMs=%d leaseMs=%d client=%u priority=%u",
+         host, port, g_udp_binary ? "binary" : "text", g_udp_thread != NULL,
+         g_mailbox_min_interval_us ? (int)(1000000 / g_mailbox_min_interval_us) : 0, g_mailbox_threshold,
+         (int)g_heartbeat_ms, g_heartbeat_ms ? g_lease_ms : 0, (unsigned)g_client_id, (unsigned)g_priority);
 }
 
-static void udp_send(const char *msg) {
+static void udp_send_bytes(const void *data, int len) {
     init_udp();
     if (!g_udp_ready || g_udp_sock == INVALID_SOCKET) return;
 
-    EnterCriticalSection(&g_udp_lock);
-    int len = (int)strlen(msg);
-    int r = sendto(g_udp_sock, msg, len, 0, (const struct sockaddr *)&g_udp_addr, sizeof(g_udp_addr));
-    LeaveCriticalSection(&g_udp_lock);
-    if (r == SOCKET_ERROR) {
-        logf("[proxy] UDP sendto failed: %d", WSAGetLastError());
+    if (g_udp_thread) {
+        // Every packet fits a slot; anything larger is dropped rather than sent under the lock.
+        if (len <= UDP_SLOT_BYTES) {
+            udp_enqueue(data, len);
+        } else {
+            g_udp_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
     }
+    g_udp_inline.fetch_add(1, std::memory_order_relaxed);
+    udp_sendto_now(data, len);
 }
 
-static int clamp_int(int v, int lo, int hi) {
-    if (v < lo) return lo;
-    if (v > hi) return hi;
-    return v;
+static void udp_send(const char *msg) {
+    udp_send_bytes(msg, (int)strlen(msg));
 }
 
-static void send_const_force(int magnitude) {
-    int scaled = (magnitude * 100) / 10000;
-    scaled = clamp_int(scaled, -100, 100);
-    if (scaled == 0) {
-        udp_send("STOP");
+// The device is gone: end the lease, so the daemon falls back to its watchdog right away
+// instead of holding the last force for the rest of the lease.
+static void end_lease() {
+    if (!g_udp_ready || !g_udp_thread || g_heartbeat_ms == 0) return;
+    g_game_active.store(0, std::memory_order_relaxed);
+    char buf[UDP_SLOT_BYTES];
+    udp_send_bytes(buf, encode_heartbeat(buf, 0));
+}
+
+static void send_effect_state(uint16_t effect_id, ForceMailbox *mb, uint8_t effect_type, uint8_t state,
+                              int magnitude, int gain) {
+    if (mb) {
+        post_mailbox(mb, state, magnitude, gain);
         return;
     }
-    char msg[32];
-    _snprintf(msg, sizeof(msg), "CONST %d", scaled);
-    udp_send(msg);
+    init_udp();
+    char buf[UDP_SLOT_BYTES];
+    int len = encode_effect(buf, effect_id, effect_type, state, magnitude, gain, now_us());
+    udp_send_bytes(buf, len);
 }
 
-static void send_stop() {
-    udp_send("STOP");
+static void send_const_force(uint16_t effect_id, ForceMailbox *mb, int magnitude, int gain) {
+    send_effect_state(effect_id, mb, FFB_EFFECT_CONSTANT, FFB_STATE_PLAYING, magnitude, gain);
 }
 
-static void guid_to_string(const GUID &g, char *out, size_t out_len) {
+static void send_stop(uint16_t effect_id, ForceMailbox *mb, int gain) {
+    send_effect_state(effect_id, mb, FFB_EFFECT_CONSTANT, FFB_STATE_STOPPED, 0, gain);
+}
+
+// Conditions are sent once per change; the daemon closes the loop on the wheel position.
+// Binary only: the text fallback has no way to express them.
+static void send_condition(uint16_t effect_id, uint8_t effect_type, bool playing, const DICONDITION &c, int gain) {
+    init_udp();
+    if (!g_udp_binary) return;
+    FfbWireCondition pkt;
+    ffb_wire_init_header(&pkt.hdr, FFB_KIND_CONDITION, (uint16_t)sizeof(pkt), 0, now_us());
+    pkt.effect_id = effect_id;
+    pkt.effect_type = effect_type;
+    pkt.state = playing ? FFB_STATE_PLAYING : FFB_STATE_STOPPED;
+    pkt.offset = (int16_t)clamp_int((int)c.lOffset, -FFB_MAGNITUDE_MAX, FFB_MAGNITUDE_MAX);
+    pkt.positive_coefficient = (int16_t)clamp_int((int)c.lPositiveCoefficient, -FFB_MAGNITUDE_MAX, FFB_MAGNITUDE_MAX);
+    pkt.negative_coefficient = (int16_t)clamp_int((int)c.lNegativeCoefficient, -FFB_MAGNITUDE_MAX, FFB_MAGNITUDE_MAX);
+    pkt.positive_saturation = (uint16_t)(c.dwPositiveSaturation > FFB_MAGNITUDE_MAX ? FFB_MAGNITUDE_MAX : c.dwPositiveSaturation);
+    pkt.negative_saturation = (uint16_t)(c.dwNegativeSaturation > FFB_MAGNITUDE_MAX ? FFB_MAGNITUDE_MAX : c.dwNegativeSaturation);
+    pkt.deadband = (uint16_t)clamp_int((int)c.lDeadBand, 0, FFB_MAGNITUDE_MAX);
+    pkt.gain = (uint16_t)clamp_int(gain, 0, FFB_MAGNITUDE_MAX);
+    pkt.reserved = 0;
+    udp_send_bytes(&pkt, (int)sizeof(pkt));
+}
+
+// Periodic parameters only; the daemon generates the samples. A negative direction
+// flips the waveform: offset negated, phase shifted by half a cycle.
+static void send_periodic(uint16_t effect_id, uint8_t effect_type, bool playing, const DIPERIODIC &p,
+                          int direction, int gain) {
+    init_udp();
+    if (!g_udp_binary) return;
+    FfbWirePeriodic pkt;
+    ffb_wire_init_header(&pkt.hdr, FFB_KIND_PERIODIC, (uint16_t)sizeof(pkt), 0, now_us());
+    pkt.effect_id = effect_id;
+    pkt.effect_type = effect_type;
+    pkt.state = playing ? FFB_STATE_PLAYING : FFB_STATE_STOPPED;
+    int magnitude = p.dwMagnitude > FFB_MAGNITUDE_MAX ? FFB_MAGNITUDE_MAX : (int)p.dwMagnitude;
+    int scale = direction < 0 ? -direction : direction;
+    pkt.magnitude = (uint16_t)(magnitude * scale / FFB_MAGNITUDE_MAX);
+    pkt.offset = (int16_t)clamp_int((int)((long long)p.lOffset * direction / FFB_MAGNITUDE_MAX),
+                                    -FFB_MAGNITUDE_MAX, FFB_MAGNITUDE_MAX);
+    pkt.phase = (uint16_t)((p.dwPhase + (direction < 0 ? 18000 : 0)) % 36000);
+    pkt.gain = (uint16_t)clamp_int(gain, 0, FFB_MAGNITUDE_MAX);
+    pkt.period_us = (uint32_t)p.dwPeriod;
+    udp_send_bytes(&pkt, (int)sizeof(pkt));
+}
+
+static void send_device(uint8_t command) {
+    init_udp();
+    if (!g_udp_binary) {
+        if (command == FFB_CMD_STOP_ALL || command == FFB_CMD_RESET) udp_send("STOP");
+        return;
+    }
+    FfbWireDevice pkt;
+    ffb_wire_init_header(&pkt.hdr, FFB_KIND_DEVICE, (uint16_t)sizeof(pkt), 0, now_us());
+    pkt.command = command;
+    pkt.reserved0 = 0;
+    pkt.gain = (uint16_t)g_device_gain;
+    pkt.reserved = 0;
+    udp_send_bytes(&pkt, (int)sizeof(pkt));
+}
+
+// SendForceFeedbackCommand. Stopping commands first invalidate every started effect and
+// pending mailbox snapshot, then go out in order with the effect updates around them.
+static void forward_ffb_command(DWORD flags) {
+    if (flags & (DISFFC_RESET | DISFFC_STOPALL)) {
+        InterlockedIncrement(&g_ffb_epoch);
+        stop_all_mailboxes();
+    }
+    if (flags & DISFFC_RESET) send_device(FFB_CMD_RESET);
+    if (flags & DISFFC_STOPALL) send_device(FFB_CMD_STOP_ALL);
+    if (flags & DISFFC_PAUSE) send_device(FFB_CMD_PAUSE);
+    if (flags & DISFFC_CONTINUE) send_device(FFB_CMD_CONTINUE);
+    if (flags & DISFFC_SETACTUATORSOFF) send_device(FFB_CMD_ACTUATORS_OFF);
+    if (flags & DISFFC_SETACTUATORSON) send_device(FFB_CMD_ACTUATORS_ON);
+}
+
+static void forward_property(REFGUID rguid, LPCDIPROPHEADER ph) {
+    if (!ph || ph->dwSize < sizeof(DIPROPDWORD)) return;
+    if (&rguid == &DIPROP_AUTOCENTER) {
+        DWORD on = ((const DIPROPDWORD *)ph)->dwData;
+        LOG_CALL("[proxy] SetProperty AUTOCENTER=%lu", on);
+        send_device(on == DIPROPAUTOCENTER_OFF ? FFB_CMD_AUTOCENTER_OFF : FFB_CMD_AUTOCENTER_ON);
+        return;
+    }
+    if (&rguid != &DIPROP_FFGAIN) return;
+    DWORD gain = ((const DIPROPDWORD *)ph)->dwData;
+    InterlockedExchange(&g_device_gain, (LONG)(gain > FFB_MAGNITUDE_MAX ? FFB_MAGNITUDE_MAX : gain));
+    LOG_CALL("[proxy] SetProperty FFGAIN=%lu", gain);
+    send_device(FFB_CMD_NONE);
+}
+
+static void trace_device(uint8_t call, DWORD flags, HRESULT hr) {
+    int32_t p = (int32_t)hr;
+    trace_call(call, 0, 0, (uint32_t)flags, &p, 1);
+}
+
+static void trace_set_parameters(uint16_t effect_id, uint8_t effect_type, LPCDIEFFECT peff, DWORD dwFlags) {
+    if (g_trace_file == INVALID_HANDLE_VALUE) return;
+    // Fields the flags leave out may be uninitialized, pointers included: never read them.
+    int32_t p[FFB_TRACE_PARAMS] = {0};
+    if (dwFlags & DIEP_GAIN) p[0] = (int32_t)peff->dwGain;
+    if ((dwFlags & DIEP_DIRECTION) && peff->cAxes > 0 && peff->rglDirection) p[1] = (int32_t)peff->rglDirection[0];
+    const void *ts = (dwFlags & DIEP_TYPESPECIFICPARAMS) ? peff->lpvTypeSpecificParams : NULL;
+    DWORD cb = ts ? peff->cbTypeSpecificParams : 0;
+    if (ts && effect_type == FFB_EFFECT_CONSTANT && cb >= sizeof(DICONSTANTFORCE)) {
+        p[2] = (int32_t)((const DICONSTANTFORCE *)ts)->lMagnitude;
+    } else if (ts && effect_type == FFB_EFFECT_RAMP && cb >= sizeof(DIRAMPFORCE)) {
+        const DIRAMPFORCE *r = (const DIRAMPFORCE *)ts;
+        p[2] = (int32_t)r->lStart;
+        p[3] = (int32_t)r->lEnd;
+    } else if (ts && effect_type >= FFB_EFFECT_SPRING && effect_type <= FFB_EFFECT_INERTIA && cb >= sizeof(DICONDITION)) {
+        const DICONDITION *c = (const DICONDITION *)ts;
+        p[2] = (int32_t)c->lOffset;
+        p[3] = (int32_t)c->lPositiveCoefficient;
+        p[4] = (int32_t)c->lNegativeCoefficient;
+        p[5] = (int32_t)c->dwPositiveSaturation;
+        p[6] = (int32_t)c->dwNegativeSaturation;
+        p[7] = (int32_t)c->lDeadBand;
+    } else if (ts && effect_type >= FFB_EFFECT_SINE && effect_type <= FFB_EFFECT_SAW_DOWN && cb >= sizeof(DIPERIODIC)) {
+        const DIPERIODIC *per = (const DIPERIODIC *)ts;
+        p[2] = (int32_t)per->dwMagnitude;
+        p[3] = (int32_t)per->lOffset;
+        p[4] = (int32_t)per->dwPhase;
+        p[5] = (int32_t)per->dwPeriod;
+    }
+    trace_call(FFB_TRACE_SET_PARAMETERS, effect_id, effect_type, (uint32_t)dwFlags, p, FFB_TRACE_PARAMS);
+}
+
+// Share of the effect along the wheel axis (the first axis), -10000..10000.
+static int direction_scale(LPCDIEFFECT peff) {
+    if (peff->cAxes == 0 || !peff->rglDirection) return FFB_MAGNITUDE_MAX;
+    const LONG *dir = peff->rglDirection;
+    const double rad = 3.14159265358979323846 / 18000.0; // per hundredth of a degree
+    double x = 1.0;
+    if (peff->dwFlags & DIEFF_POLAR) {
+        // Hundredths of a degree clockwise from north; east (9000) is +X.
+        x = sin((double)dir[0] * rad);
+    } else if (peff->dwFlags & DIEFF_SPHERICAL) {
+        // First angle is measured from +X toward +Y.
+        x = cos((double)dir[0] * rad);
+    } else if (peff->cAxes == 1) {
+        x = dir[0] < 0 ? -1.0 : 1.0;
+    } else {
+        double len = 0;
+        for (DWORD i = 0; i < peff->cAxes; i++) len += (double)dir[i] * (double)dir[i];
+        if (len > 0) x = (double)dir[0] / sqrt(len);
+    }
+    return clamp_int((int)lround(x * FFB_MAGNITUDE_MAX), -FFB_MAGNITUDE_MAX, FFB_MAGNITUDE_MAX);
+}
+
+struct GuidText {
+    char s[40];
+};
+
+// Formatted inside a LOG_* argument list, so only for lines that are actually written.
+static GuidText guid_text(const GUID &g) {
+    GuidText t;
     _snprintf(
-        out, out_len,
+        t.s, sizeof(t.s),
         "{%08lX-%04hX-%04hX-%02hhX%02hhX-%02hhX%02hhX%02hhX%02hhX%02hhX%02hhX}",
         g.Data1, g.Data2, g.Data3,
         g.Data4[0], g.Data4[1], g.Data4[2], g.Data4[3],
         g.Data4[4], g.Data4[5], g.Data4[6], g.Data4[7]
     );
+    t.s[sizeof(t.s) - 1] = '\0';
+    return t;
 }
 
 static void ensure_real_loaded() {
@@ -180,19 +1138,246 @@ static void ensure_real_loaded() {
     _snwprintf(path, MAX_PATH, L"%s\\dinput8.dll", sysdir);
     g_real_dinput8 = LoadLibraryW(path);
     if (!g_real_dinput8) {
-        logf("[proxy] failed to load real dinput8.dll");
+        LOG_INFO("[proxy] failed to load real dinput8.dll");
         return;
     }
     g_real_DirectInput8Create = (DirectInput8CreateFn)GetProcAddress(g_real_dinput8, "DirectInput8Create");
     if (!g_real_DirectInput8Create) {
-        logf("[proxy] failed to get DirectInput8Create");
+        LOG_INFO("[proxy] failed to get DirectInput8Create");
     }
 }
 
+// Caches the last direction_scale result: games that stream forces usually repeat the same
+// direction, and the projection needs sin/sqrt. Keyed on the coordinate system and the
+// first FFB_DIRECTION_KEY angles/components.
+#define FFB_DIRECTION_KEY 3
+
+struct DirectionCache {
+    bool valid;
+    DWORD coords;
+    DWORD axes;
+    LONG dir[FFB_DIRECTION_KEY];
+    int scale;
+
+    int project(LPCDIEFFECT peff) {
+        DWORD n = (peff->cAxes > 0 && peff->rglDirection) ? peff->cAxes : 0;
+        DWORD c = peff->dwFlags & (DIEFF_CARTESIAN | DIEFF_POLAR | DIEFF_SPHERICAL);
+        // More axes than the key covers always recompute (the tail would not be compared).
+        bool keyed = n <= FFB_DIRECTION_KEY;
+        if (valid && keyed && c == coords && n == axes &&
+            (n == 0 || memcmp(dir, peff->rglDirection, n * sizeof(LONG)) == 0)) {
+            return scale;
+        }
+        scale = direction_scale(peff);
+        valid = keyed;
+        coords = c;
+        axes = n;
+        if (n > 0 && keyed) memcpy(dir, peff->rglDirection, n * sizeof(LONG));
+        return scale;
+    }
+};
+
+// What the proxy mirrors of one effect, shared by the real-effect wrapper and the fake one.
+// effectType is resolved from the GUID once, at CreateEffect, which also takes the DIEFFECT
+// the game passes there (many games set everything at creation and then only call Start);
+// SetParameters only reads the DIEP_* fields it is given and sends a packet only when one
+// of them changed what the daemon plays.
+struct EffectState {
+    uint16_t effectId;
+    uint8_t effectType;
+    ForceMailbox *mailbox;
+    int lastForce;
+    bool hasForce;
+    bool forceStopped; // Stop() sent since the last force; the next SetParameters resumes it
+    DICONDITION condition;
+    bool hasCondition;
+    DIPERIODIC periodic;
+    bool hasPeriodic;
+    bool playing;
+    LONG playEpoch;
+    int gain;      // DIEFFECT.dwGain
+    int direction; // share along the wheel axis, -10000..10000
+    DirectionCache directionCache;
+
+    // `create` is CreateEffect's DIEFFECT (may be NULL): read as SetParameters with
+    // DIEP_ALLPARAMS, without DIEP_START, and without sending anything, since the
+    // effect is not playing yet.
+    EffectState(const GUID &guid, uint32_t fake, LPCDIEFFECT create)
+        : effectId(next_effect_id()), effectType(effect_type_from_guid(guid)), mailbox(NULL),
+          lastForce(0), hasForce(false), forceStopped(false), hasCondition(false), hasPeriodic(false), playing(false),
+          playEpoch(g_ffb_epoch), gain(FFB_MAGNITUDE_MAX), direction(FFB_MAGNITUDE_MAX) {
+        memset(&condition, 0, sizeof(condition));
+        memset(&periodic, 0, sizeof(periodic));
+        memset(&directionCache, 0, sizeof(directionCache));
+        if (effectType == FFB_EFFECT_CONSTANT) mailbox = claim_mailbox(effectId, effectType);
+        trace_call(FFB_TRACE_CREATE_EFFECT, effectId, effectType, fake, NULL, 0);
+        if (create) {
+            absorb(create, DIEP_ALLPARAMS & ~DIEP_START, "CreateEffect ");
+            // Never sent yet: the first SetParameters plays it, as without a DIEFFECT here.
+            forceStopped = hasForce;
+        }
+    }
+
+    void release() {
+        trace_call(FFB_TRACE_RELEASE, effectId, effectType, 0, NULL, 0);
+        release_mailbox(mailbox);
+        if (hasCondition && isPlaying()) send_condition(effectId, effectType, false, condition, gain);
+        if (hasPeriodic && isPlaying()) send_periodic(effectId, effectType, false, periodic, direction, gain);
+    }
+
+    // Reads the DIEP_* fields `dwFlags` names into the mirrored state (DIEP_START aside) and
+    // returns whether one changed what the daemon plays. Sends nothing. `who` prefixes the
+    // log lines ("", "FakeEffect " or "CreateEffect ").
+    bool absorb(LPCDIEFFECT peff, DWORD dwFlags, const char *who) {
+        bool changed = false;
+        if (dwFlags & DIEP_GAIN) {
+            int g = clamp_int((int)peff->dwGain, 0, FFB_MAGNITUDE_MAX);
+            changed |= g != gain;
+            gain = g;
+        }
+        if (dwFlags & DIEP_DIRECTION) {
+            if (peff->cAxes > 0 && peff->rglDirection) {
+                LOG_CALL("[proxy] %sSetParameters direction[0]=%ld", who, peff->rglDirection[0]);
+            }
+            int d = directionCache.project(peff);
+            // Conditions are sent unprojected (first axis), so a direction change is not theirs.
+            if (effectType != FFB_EFFECT_SPRING && effectType != FFB_EFFECT_DAMPER &&
+                effectType != FFB_EFFECT_FRICTION && effectType != FFB_EFFECT_INERTIA) {
+                changed |= d != direction;
+            }
+            direction = d;
+        }
+
+        const void *ts = (dwFlags & DIEP_TYPESPECIFICPARAMS) ? peff->lpvTypeSpecificParams : NULL;
+        DWORD cb = ts ? peff->cbTypeSpecificParams : 0;
+        switch (effectType) {
+        case FFB_EFFECT_CONSTANT:
+            if (ts && cb >= sizeof(DICONSTANTFORCE)) {
+                const DICONSTANTFORCE *cf = (const DICONSTANTFORCE *)ts;
+                LOG_CALL("[proxy] %sSetParameters ConstantForce magnitude=%ld", who, cf->lMagnitude);
+                changed |= !hasForce || (int)cf->lMagnitude != lastForce;
+                lastForce = (int)cf->lMagnitude;
+                hasForce = true;
+            }
+            break;
+        case FFB_EFFECT_RAMP:
+            if (ts && cb >= sizeof(DIRAMPFORCE)) {
+                const DIRAMPFORCE *rf = (const DIRAMPFORCE *)ts;
+                LOG_CALL("[proxy] %sSetParameters RampForce start=%ld end=%ld", who, rf->lStart, rf->lEnd);
+            }
+            break;
+        case FFB_EFFECT_SPRING:
+        case FFB_EFFECT_DAMPER:
+        case FFB_EFFECT_FRICTION:
+        case FFB_EFFECT_INERTIA:
+            if (ts && cb >= sizeof(DICONDITION)) {
+                const DICONDITION *cond = (const DICONDITION *)ts;
+                LOG_CALL("[proxy] %sSetParameters Condition posCoeff=%ld negCoeff=%ld posSat=%lu negSat=%lu dead=%ld",
+                         who,
+                         cond->lPositiveCoefficient,
+                         cond->lNegativeCoefficient,
+                         cond->dwPositiveSaturation,
+                         cond->dwNegativeSaturation,
+                         cond->lDeadBand);
+                changed |= !hasCondition || memcmp(&condition, cond, sizeof(condition)) != 0;
+                condition = *cond;
+                hasCondition = true;
+            }
+            break;
+        case FFB_EFFECT_SINE:
+        case FFB_EFFECT_SQUARE:
+        case FFB_EFFECT_TRIANGLE:
+        case FFB_EFFECT_SAW_UP:
+        case FFB_EFFECT_SAW_DOWN:
+            if (ts && cb >= sizeof(DIPERIODIC)) {
+                const DIPERIODIC *per = (const DIPERIODIC *)ts;
+                LOG_CALL("[proxy] %sSetParameters Periodic mag=%lu offset=%ld phase=%lu period=%lu",
+                         who, per->dwMagnitude, per->lOffset, per->dwPhase, per->dwPeriod);
+                changed |= !hasPeriodic || memcmp(&periodic, per, sizeof(periodic)) != 0;
+                periodic = *per;
+                hasPeriodic = true;
+            }
+            break;
+        default:
+            break;
+        }
+        return changed;
+    }
+
+    void setParameters(LPCDIEFFECT peff, DWORD dwFlags, const char *who) {
+        bool changed = absorb(peff, dwFlags, who);
+        if (dwFlags & DIEP_START) {
+            changed |= !isPlaying();
+            start();
+        }
+        switch (effectType) {
+        case FFB_EFFECT_CONSTANT:
+            // ConstantForce plays on SetParameters alone, unless STOPALL/RESET stopped it since.
+            if ((changed || forceStopped) && hasForce && playEpoch == g_ffb_epoch) {
+                send_const_force(effectId, mailbox, projectedForce(), gain);
+                forceStopped = false;
+            }
+            break;
+        case FFB_EFFECT_SPRING:
+        case FFB_EFFECT_DAMPER:
+        case FFB_EFFECT_FRICTION:
+        case FFB_EFFECT_INERTIA:
+            if (changed && hasCondition) send_condition(effectId, effectType, isPlaying(), condition, gain);
+            break;
+        case FFB_EFFECT_SINE:
+        case FFB_EFFECT_SQUARE:
+        case FFB_EFFECT_TRIANGLE:
+        case FFB_EFFECT_SAW_UP:
+        case FFB_EFFECT_SAW_DOWN:
+            if (changed && hasPeriodic) send_periodic(effectId, effectType, isPlaying(), periodic, direction, gain);
+            break;
+        default:
+            break;
+        }
+    }
+
+    void startEffect() {
+        start();
+        if (effectType == FFB_EFFECT_CONSTANT) {
+            if (hasForce) {
+                send_const_force(effectId, mailbox, projectedForce(), gain);
+                forceStopped = false;
+            }
+        } else if (hasCondition) {
+            send_condition(effectId, effectType, true, condition, gain);
+        } else if (hasPeriodic) {
+            send_periodic(effectId, effectType, true, periodic, direction, gain);
+        }
+    }
+
+    void stopEffect() {
+        playing = false;
+        if (effectType == FFB_EFFECT_CONSTANT) {
+            send_stop(effectId, mailbox, gain);
+            forceStopped = true;
+        } else if (hasCondition) {
+            send_condition(effectId, effectType, false, condition, gain);
+        } else if (hasPeriodic) {
+            send_periodic(effectId, effectType, false, periodic, direction, gain);
+        }
+    }
+
+    void start() {
+        playing = true;
+        playEpoch = g_ffb_epoch;
+    }
+
+    bool isPlaying() const { return playing && playEpoch == g_ffb_epoch; }
+
+    int projectedForce() const {
+        return (int)((long long)lastForce * direction / FFB_MAGNITUDE_MAX);
+    }
+};
+
 class DirectInputEffectProxy : public IDirectInputEffect {
 public:
-    DirectInputEffectProxy(IDirectInputEffect *real, const GUID &guid)
-        : refCount(1), realEffect(real), effectGuid(guid), lastForce(0), hasForce(false) {}
+    DirectInputEffectProxy(IDirectInputEffect *real, const GUID &guid, LPCDIEFFECT create)
+        : refCount(1), realEffect(real), effectGuid(guid), fx(guid, 0, create) {}
 
     STDMETHODIMP QueryInterface(REFIID riid, LPVOID *ppv) override {
         if (!ppv) return E_POINTER;
@@ -212,7 +1397,10 @@ public:
     STDMETHODIMP_(ULONG) Release() override {
         realEffect->Release();
         ULONG r = InterlockedDecrement(&refCount);
-        if (r == 0) delete this;
+        if (r == 0) {
+            fx.release();
+            delete this;
+        }
         return r;
     }
 
@@ -230,10 +1418,9 @@ public:
 
     STDMETHODIMP SetParameters(LPCDIEFFECT peff, DWORD dwFlags) override {
         if (peff) {
-            char gbuf[64];
-            guid_to_string(effectGuid, gbuf, sizeof(gbuf));
-            logf("[proxy] SetParameters guid=%s flags=0x%08lx duration=%lu gain=%lu trigger=%lu delay=%lu axes=%lu cbType=%lu",
-                 gbuf,
+            trace_set_parameters(fx.effectId, fx.effectType, peff, dwFlags);
+            LOG_CALL("[proxy] SetParameters guid=%s flags=0x%08lx duration=%lu gain=%lu trigger=%lu delay=%lu axes=%lu cbType=%lu",
+                 guid_text(effectGuid).s,
                  dwFlags,
                  peff->dwDuration,
                  peff->dwGain,
@@ -241,62 +1428,29 @@ public:
                  peff->dwStartDelay,
                  peff->cAxes,
                  peff->cbTypeSpecificParams);
-
-            if (peff->cAxes > 0 && peff->rglDirection) {
-                logf("[proxy] SetParameters direction[0]=%ld", peff->rglDirection[0]);
-            }
-
-            if (IsEqualGUID(effectGuid, GUID_ConstantForce) && peff->lpvTypeSpecificParams) {
-                const DICONSTANTFORCE *cf = (const DICONSTANTFORCE *)peff->lpvTypeSpecificParams;
-                logf("[proxy] SetParameters ConstantForce magnitude=%ld", cf->lMagnitude);
-                lastForce = (int)cf->lMagnitude;
-                hasForce = true;
-                send_const_force(lastForce);
-            } else if (IsEqualGUID(effectGuid, GUID_RampForce) && peff->lpvTypeSpecificParams &&
-                       peff->cbTypeSpecificParams >= sizeof(DIRAMPFORCE)) {
-                const DIRAMPFORCE *rf = (const DIRAMPFORCE *)peff->lpvTypeSpecificParams;
-                logf("[proxy] SetParameters RampForce start=%ld end=%ld", rf->lStart, rf->lEnd);
-            } else if ((IsEqualGUID(effectGuid, GUID_Spring) || IsEqualGUID(effectGuid, GUID_Damper) ||
-                        IsEqualGUID(effectGuid, GUID_Friction) || IsEqualGUID(effectGuid, GUID_Inertia)) &&
-                       peff->lpvTypeSpecificParams && peff->cbTypeSpecificParams >= sizeof(DICONDITION)) {
-                const DICONDITION *cond = (const DICONDITION *)peff->lpvTypeSpecificParams;
-                logf("[proxy] SetParameters Condition posCoeff=%ld negCoeff=%ld posSat=%lu negSat=%lu dead=%ld",
-                     cond->lPositiveCoefficient,
-                     cond->lNegativeCoefficient,
-                     cond->dwPositiveSaturation,
-                     cond->dwNegativeSaturation,
-                     cond->lDeadBand);
-            } else if ((IsEqualGUID(effectGuid, GUID_Sine) || IsEqualGUID(effectGuid, GUID_Square) ||
-                        IsEqualGUID(effectGuid, GUID_Triangle) || IsEqualGUID(effectGuid, GUID_SawtoothUp) ||
-                        IsEqualGUID(effectGuid, GUID_SawtoothDown)) &&
-                       peff->lpvTypeSpecificParams && peff->cbTypeSpecificParams >= sizeof(DIPERIODIC)) {
-                const DIPERIODIC *per = (const DIPERIODIC *)peff->lpvTypeSpecificParams;
-                logf("[proxy] SetParameters Periodic mag=%lu offset=%ld phase=%lu period=%lu",
-                     per->dwMagnitude, per->lOffset, per->dwPhase, per->dwPeriod);
-            }
+            fx.setParameters(peff, dwFlags, "");
         }
         HRESULT hr = realEffect->SetParameters(peff, dwFlags);
-        logf("[proxy] SetParameters -> hr=0x%08lx", (unsigned long)hr);
+        LOG_CALL("[proxy] SetParameters -> hr=0x%08lx", (unsigned long)hr);
         return hr;
     }
 
     STDMETHODIMP Start(DWORD dwIterations, DWORD dwFlags) override {
-        logf("[proxy] Effect Start iterations=%lu flags=0x%08lx", dwIterations, dwFlags);
-        if (IsEqualGUID(effectGuid, GUID_ConstantForce) && hasForce) {
-            send_const_force(lastForce);
-        }
+        LOG_CALL("[proxy] Effect Start iterations=%lu flags=0x%08lx", dwIterations, dwFlags);
+        int32_t iterations = (int32_t)dwIterations;
+        trace_call(FFB_TRACE_START, fx.effectId, fx.effectType, (uint32_t)dwFlags, &iterations, 1);
+        fx.startEffect();
         HRESULT hr = realEffect->Start(dwIterations, dwFlags);
-        logf("[proxy] Effect Start -> hr=0x%08lx", (unsigned long)hr);
+        LOG_CALL("[proxy] Effect Start -> hr=0x%08lx", (unsigned long)hr);
         return hr;
     }
 
     STDMETHODIMP Stop() override {
-        logf("[proxy] Effect Stop");
-        if (IsEqualGUID(effectGuid, GUID_ConstantForce)) {
-            send_stop();
-        }
+        LOG_CALL("[proxy] Effect Stop");
+        trace_call(FFB_TRACE_STOP, fx.effectId, fx.effectType, 0, NULL, 0);
+        fx.stopEffect();
         HRESULT hr = realEffect->Stop();
-        logf("[proxy] Effect Stop -> hr=0x%08lx", (unsigned long)hr);
+        LOG_CALL("[proxy] Effect Stop -> hr=0x%08lx", (unsigned long)hr);
         return hr;
     }
 
@@ -306,13 +1460,13 @@ public:
 
     STDMETHODIMP Download() override {
         HRESULT hr = realEffect->Download();
-        logf("[proxy] Effect Download -> hr=0x%08lx", (unsigned long)hr);
+        LOG_CALL("[proxy] Effect Download -> hr=0x%08lx", (unsigned long)hr);
         return hr;
     }
 
     STDMETHODIMP Unload() override {
         HRESULT hr = realEffect->Unload();
-        logf("[proxy] Effect Unload -> hr=0x%08lx", (unsigned long)hr);
+        LOG_CALL("[proxy] Effect Unload -> hr=0x%08lx", (unsigned long)hr);
         return hr;
     }
 
@@ -324,13 +1478,12 @@ private:
     LONG refCount;
     IDirectInputEffect *realEffect;
     GUID effectGuid;
-    int lastForce;
-    bool hasForce;
+    EffectState fx;
 };
 
 class DirectInputEffectFake : public IDirectInputEffect {
 public:
-    DirectInputEffectFake(const GUID &guid) : refCount(1), effectGuid(guid), lastForce(0), hasForce(false) {}
+    DirectInputEffectFake(const GUID &guid, LPCDIEFFECT create) : refCount(1), effectGuid(guid), fx(guid, 1, create) {}
 
     STDMETHODIMP QueryInterface(REFIID riid, LPVOID *ppv) override {
         if (!ppv) return E_POINTER;
@@ -349,13 +1502,16 @@ public:
 
     STDMETHODIMP_(ULONG) Release() override {
         ULONG r = InterlockedDecrement(&refCount);
-        if (r == 0) delete this;
+        if (r == 0) {
+            fx.release();
+            delete this;
+        }
         return r;
     }
 
     STDMETHODIMP Initialize(HINSTANCE hinst, DWORD dwVersion, REFGUID rguid) override {
         (void)hinst; (void)dwVersion; (void)rguid;
-        logf("[proxy] FakeEffect Initialize");
+        LOG_CALL("[proxy] FakeEffect Initialize");
         return DI_OK;
     }
 
@@ -367,17 +1523,16 @@ public:
 
     STDMETHODIMP GetParameters(LPDIEFFECT peff, DWORD dwFlags) override {
         (void)dwFlags;
-        logf("[proxy] FakeEffect GetParameters");
+        LOG_CALL("[proxy] FakeEffect GetParameters");
         if (!peff) return E_POINTER;
         return DI_OK;
     }
 
     STDMETHODIMP SetParameters(LPCDIEFFECT peff, DWORD dwFlags) override {
         if (peff) {
-            char gbuf[64];
-            guid_to_string(effectGuid, gbuf, sizeof(gbuf));
-            logf("[proxy] FakeEffect SetParameters guid=%s flags=0x%08lx duration=%lu gain=%lu trigger=%lu delay=%lu axes=%lu cbType=%lu",
-                 gbuf,
+            trace_set_parameters(fx.effectId, fx.effectType, peff, dwFlags);
+            LOG_CALL("[proxy] FakeEffect SetParameters guid=%s flags=0x%08lx duration=%lu gain=%lu trigger=%lu delay=%lu axes=%lu cbType=%lu",
+                 guid_text(effectGuid).s,
                  dwFlags,
                  peff->dwDuration,
                  peff->dwGain,
@@ -385,56 +1540,23 @@ public:
                  peff->dwStartDelay,
                  peff->cAxes,
                  peff->cbTypeSpecificParams);
-
-            if (peff->cAxes > 0 && peff->rglDirection) {
-                logf("[proxy] FakeEffect SetParameters direction[0]=%ld", peff->rglDirection[0]);
-            }
-
-            if (IsEqualGUID(effectGuid, GUID_ConstantForce) && peff->lpvTypeSpecificParams) {
-                const DICONSTANTFORCE *cf = (const DICONSTANTFORCE *)peff->lpvTypeSpecificParams;
-                logf("[proxy] FakeEffect SetParameters ConstantForce magnitude=%ld", cf->lMagnitude);
-                lastForce = (int)cf->lMagnitude;
-                hasForce = true;
-                send_const_force(lastForce);
-            } else if (IsEqualGUID(effectGuid, GUID_RampForce) && peff->lpvTypeSpecificParams &&
-                       peff->cbTypeSpecificParams >= sizeof(DIRAMPFORCE)) {
-                const DIRAMPFORCE *rf = (const DIRAMPFORCE *)peff->lpvTypeSpecificParams;
-                logf("[proxy] FakeEffect SetParameters RampForce start=%ld end=%ld", rf->lStart, rf->lEnd);
-            } else if ((IsEqualGUID(effectGuid, GUID_Spring) || IsEqualGUID(effectGuid, GUID_Damper) ||
-                        IsEqualGUID(effectGuid, GUID_Friction) || IsEqualGUID(effectGuid, GUID_Inertia)) &&
-                       peff->lpvTypeSpecificParams && peff->cbTypeSpecificParams >= sizeof(DICONDITION)) {
-                const DICONDITION *cond = (const DICONDITION *)peff->lpvTypeSpecificParams;
-                logf("[proxy] FakeEffect SetParameters Condition posCoeff=%ld negCoeff=%ld posSat=%lu negSat=%lu dead=%ld",
-                     cond->lPositiveCoefficient,
-                     cond->lNegativeCoefficient,
-                     cond->dwPositiveSaturation,
-                     cond->dwNegativeSaturation,
-                     cond->lDeadBand);
-            } else if ((IsEqualGUID(effectGuid, GUID_Sine) || IsEqualGUID(effectGuid, GUID_Square) ||
-                        IsEqualGUID(effectGuid, GUID_Triangle) || IsEqualGUID(effectGuid, GUID_SawtoothUp) ||
-                        IsEqualGUID(effectGuid, GUID_SawtoothDown)) &&
-                       peff->lpvTypeSpecificParams && peff->cbTypeSpecificParams >= sizeof(DIPERIODIC)) {
-                const DIPERIODIC *per = (const DIPERIODIC *)peff->lpvTypeSpecificParams;
-                logf("[proxy] FakeEffect SetParameters Periodic mag=%lu offset=%ld phase=%lu period=%lu",
-                     per->dwMagnitude, per->lOffset, per->dwPhase, per->dwPeriod);
-            }
+            fx.setParameters(peff, dwFlags, "FakeEffect ");
         }
         return DI_OK;
     }
 
     STDMETHODIMP Start(DWORD dwIterations, DWORD dwFlags) override {
-        logf("[proxy] FakeEffect Start iterations=%lu flags=0x%08lx", dwIterations, dwFlags);
-        if (IsEqualGUID(effectGuid, GUID_ConstantForce) && hasForce) {
-            send_const_force(lastForce);
-        }
+        LOG_CALL("[proxy] FakeEffect Start iterations=%lu flags=0x%08lx", dwIterations, dwFlags);
+        int32_t iterations = (int32_t)dwIterations;
+        trace_call(FFB_TRACE_START, fx.effectId, fx.effectType, (uint32_t)dwFlags, &iterations, 1);
+        fx.startEffect();
         return DI_OK;
     }
 
     STDMETHODIMP Stop() override {
-        logf("[proxy] FakeEffect Stop");
-        if (IsEqualGUID(effectGuid, GUID_ConstantForce)) {
-            send_stop();
-        }
+        LOG_CALL("[proxy] FakeEffect Stop");
+        trace_call(FFB_TRACE_STOP, fx.effectId, fx.effectType, 0, NULL, 0);
+        fx.stopEffect();
         return DI_OK;
     }
 
@@ -445,26 +1567,25 @@ public:
     }
 
     STDMETHODIMP Download() override {
-        logf("[proxy] FakeEffect Download");
+        LOG_CALL("[proxy] FakeEffect Download");
         return DI_OK;
     }
 
     STDMETHODIMP Unload() override {
-        logf("[proxy] FakeEffect Unload");
+        LOG_CALL("[proxy] FakeEffect Unload");
         return DI_OK;
     }
 
     STDMETHODIMP Escape(LPDIEFFESCAPE pesc) override {
         (void)pesc;
-        logf("[proxy] FakeEffect Escape");
+        LOG_CALL("[proxy] FakeEffect Escape");
         return DIERR_UNSUPPORTED;
     }
 
 private:
     LONG refCount;
     GUID effectGuid;
-    int lastForce;
-    bool hasForce;
+    EffectState fx;
 };
 
 class DirectInputDevice8ProxyA;
@@ -472,7 +1593,7 @@ class DirectInput8ProxyA;
 
 class DirectInputDevice8ProxyW : public IDirectInputDevice8W {
 public:
-    DirectInputDevice8ProxyW(IDirectInputDevice8W *real) : refCount(1), realDev(real) {}
+    DirectInputDevice8ProxyW(IDirectInputDevice8W *real) : refCount(1), realDev(real), ffb(false) {}
 
     STDMETHODIMP QueryInterface(REFIID riid, LPVOID *ppv) override {
         if (!ppv) return E_POINTER;
@@ -481,9 +1602,7 @@ public:
             riid == IID_IDirectInputDevice7W ||
             riid == IID_IDirectInputDevice2W ||
             riid == IID_IDirectInputDeviceW) {
-            char gbuf[64];
-            guid_to_string(riid, gbuf, sizeof(gbuf));
-            logf("[proxy] Device QI (W) riid=%s -> wrapper", gbuf);
+            LOG_CALL("[proxy] Device QI (W) riid=%s -> wrapper", guid_text(riid).s);
             *ppv = static_cast<IDirectInputDevice8W *>(this);
             AddRef();
             return S_OK;
@@ -499,7 +1618,10 @@ public:
     STDMETHODIMP_(ULONG) Release() override {
         realDev->Release();
         ULONG r = InterlockedDecrement(&refCount);
-        if (r == 0) delete this;
+        if (r == 0) {
+            if (ffb) end_lease();
+            delete this;
+        }
         return r;
     }
 
@@ -507,46 +1629,55 @@ public:
         HRESULT hr = realDev->GetCapabilities(caps);
         if (SUCCEEDED(hr) && caps) {
             caps->dwFlags |= (DIDC_FORCEFEEDBACK | DIDC_FFATTACK | DIDC_FFFADE);
-            logf("[proxy] GetCapabilities -> force feedback enabled");
+            LOG_CALL("[proxy] GetCapabilities -> force feedback enabled");
         } else if (FAILED(hr)) {
-            logf("[proxy] GetCapabilities -> hr=0x%08lx", (unsigned long)hr);
+            LOG_CALL("[proxy] GetCapabilities -> hr=0x%08lx", (unsigned long)hr);
         }
         return hr;
     }
     STDMETHODIMP EnumObjects(LPDIENUMDEVICEOBJECTSCALLBACKW cb, LPVOID pvRef, DWORD dwFlags) override { return realDev->EnumObjects(cb, pvRef, dwFlags); }
     STDMETHODIMP GetProperty(REFGUID rguid, LPDIPROPHEADER ph) override { return realDev->GetProperty(rguid, ph); }
-    STDMETHODIMP SetProperty(REFGUID rguid, LPCDIPROPHEADER ph) override { return realDev->SetProperty(rguid, ph); }
+    STDMETHODIMP SetProperty(REFGUID rguid, LPCDIPROPHEADER ph) override {
+        forward_property(rguid, ph);
+        return realDev->SetProperty(rguid, ph);
+    }
     STDMETHODIMP Acquire() override {
-        logf("[proxy] Acquire");
+        LOG_CALL("[proxy] Acquire");
         HRESULT hr = realDev->Acquire();
-        logf("[proxy] Acquire -> hr=0x%08lx", (unsigned long)hr);
+        trace_device(FFB_TRACE_ACQUIRE, 0, hr);
+        LOG_CALL("[proxy] Acquire -> hr=0x%08lx", (unsigned long)hr);
         return hr;
     }
     STDMETHODIMP Unacquire() override {
-        logf("[proxy] Unacquire");
+        LOG_CALL("[proxy] Unacquire");
         HRESULT hr = realDev->Unacquire();
-        logf("[proxy] Unacquire -> hr=0x%08lx", (unsigned long)hr);
+        trace_device(FFB_TRACE_UNACQUIRE, 0, hr);
+        LOG_CALL("[proxy] Unacquire -> hr=0x%08lx", (unsigned long)hr);
         return hr;
     }
-    STDMETHODIMP GetDeviceState(DWORD cbData, LPVOID lpvData) override { return realDev->GetDeviceState(cbData, lpvData); }
+    STDMETHODIMP GetDeviceState(DWORD cbData, LPVOID lpvData) override {
+        note_game_alive();
+        return realDev->GetDeviceState(cbData, lpvData);
+    }
     STDMETHODIMP GetDeviceData(DWORD cbObjectData, LPDIDEVICEOBJECTDATA rgdod, LPDWORD pdwInOut, DWORD dwFlags) override {
+        note_game_alive();
         return realDev->GetDeviceData(cbObjectData, rgdod, pdwInOut, dwFlags);
     }
     STDMETHODIMP SetDataFormat(LPCDIDATAFORMAT lpdf) override {
-        logf("[proxy] SetDataFormat");
+        LOG_CALL("[proxy] SetDataFormat");
         if (lpdf) {
-            logf("[proxy] SetDataFormat size=%lu data=%lu objs=%lu flags=0x%08lx",
+            LOG_CALL("[proxy] SetDataFormat size=%lu data=%lu objs=%lu flags=0x%08lx",
                  lpdf->dwSize, lpdf->dwDataSize, lpdf->dwNumObjs, lpdf->dwFlags);
         }
         HRESULT hr = realDev->SetDataFormat(lpdf);
-        logf("[proxy] SetDataFormat -> hr=0x%08lx", (unsigned long)hr);
+        LOG_CALL("[proxy] SetDataFormat -> hr=0x%08lx", (unsigned long)hr);
         return hr;
     }
     STDMETHODIMP SetEventNotification(HANDLE hEvent) override { return realDev->SetEventNotification(hEvent); }
     STDMETHODIMP SetCooperativeLevel(HWND hwnd, DWORD dwFlags) override {
-        logf("[proxy] SetCooperativeLevel flags=0x%08lx", dwFlags);
+        LOG_CALL("[proxy] SetCooperativeLevel flags=0x%08lx", dwFlags);
         HRESULT hr = realDev->SetCooperativeLevel(hwnd, dwFlags);
-        logf("[proxy] SetCooperativeLevel -> hr=0x%08lx", (unsigned long)hr);
+        LOG_CALL("[proxy] SetCooperativeLevel -> hr=0x%08lx", (unsigned long)hr);
         return hr;
     }
     STDMETHODIMP GetObjectInfo(LPDIDEVICEOBJECTINSTANCEW pdidoi, DWORD dwObj, DWORD dwHow) override {
@@ -555,14 +1686,10 @@ public:
     STDMETHODIMP GetDeviceInfo(LPDIDEVICEINSTANCEW pdidi) override {
         HRESULT hr = realDev->GetDeviceInfo(pdidi);
         if (SUCCEEDED(hr) && pdidi) {
-            char gprod[64];
-            char ginst[64];
-            guid_to_string(pdidi->guidProduct, gprod, sizeof(gprod));
-            guid_to_string(pdidi->guidInstance, ginst, sizeof(ginst));
-            logf("[proxy] GetDeviceInfo devType=0x%08lx guidProduct=%s guidInstance=%s",
-                 pdidi->dwDevType, gprod, ginst);
+            LOG_CALL("[proxy] GetDeviceInfo devType=0x%08lx guidProduct=%s guidInstance=%s",
+                 pdidi->dwDevType, guid_text(pdidi->guidProduct).s, guid_text(pdidi->guidInstance).s);
         } else if (FAILED(hr)) {
-            logf("[proxy] GetDeviceInfo -> hr=0x%08lx", (unsigned long)hr);
+            LOG_CALL("[proxy] GetDeviceInfo -> hr=0x%08lx", (unsigned long)hr);
         }
         return hr;
     }
@@ -570,19 +1697,19 @@ public:
     STDMETHODIMP Initialize(HINSTANCE hinst, DWORD dwVersion, REFGUID rguid) override { return realDev->Initialize(hinst, dwVersion, rguid); }
 
     STDMETHODIMP CreateEffect(REFGUID rguid, LPCDIEFFECT lpeff, LPDIRECTINPUTEFFECT *ppdeff, LPUNKNOWN pUnkOuter) override {
-        char gbuf[64];
-        guid_to_string(rguid, gbuf, sizeof(gbuf));
-        logf("[proxy] CreateEffect guid=%s", gbuf);
+        LOG_CALL("[proxy] CreateEffect guid=%s", guid_text(rguid).s);
         HRESULT hr = realDev->CreateEffect(rguid, lpeff, ppdeff, pUnkOuter);
-        logf("[proxy] CreateEffect -> hr=0x%08lx", (unsigned long)hr);
+        LOG_CALL("[proxy] CreateEffect -> hr=0x%08lx", (unsigned long)hr);
         if ((hr == DIERR_UNSUPPORTED || hr == E_NOTIMPL) && ppdeff) {
-            logf("[proxy] CreateEffect unsupported; using fake effect");
-            *ppdeff = new DirectInputEffectFake(rguid);
+            LOG_INFO("[proxy] CreateEffect unsupported; using fake effect");
+            *ppdeff = new DirectInputEffectFake(rguid, lpeff);
+            ffb = true;
             return DI_OK;
         }
         if (SUCCEEDED(hr) && ppdeff && *ppdeff) {
+            ffb = true;
             IDirectInputEffect *realEff = *ppdeff;
-            *ppdeff = new DirectInputEffectProxy(realEff, rguid);
+            *ppdeff = new DirectInputEffectProxy(realEff, rguid, lpeff);
         }
         return hr;
     }
@@ -596,10 +1723,8 @@ public:
         auto thunk = [](LPCDIEFFECTINFOW info, LPVOID ref) -> BOOL {
             Ctx *c = (Ctx *)ref;
             if (info) {
-                char gbuf[64];
-                guid_to_string(info->guid, gbuf, sizeof(gbuf));
-                logf("[proxy] EnumEffects (W) guid=%s type=0x%08lx static=0x%08lx dynamic=0x%08lx",
-                     gbuf, info->dwEffType, info->dwStaticParams, info->dwDynamicParams);
+                LOG_CALL("[proxy] EnumEffects (W) guid=%s type=0x%08lx static=0x%08lx dynamic=0x%08lx",
+                     guid_text(info->guid).s, info->dwEffType, info->dwStaticParams, info->dwDynamicParams);
             }
             return c->cb ? c->cb(info, c->pvRef) : DIENUM_CONTINUE;
         };
@@ -609,16 +1734,21 @@ public:
     STDMETHODIMP GetEffectInfo(LPDIEFFECTINFOW pei, REFGUID rguid) override { return realDev->GetEffectInfo(pei, rguid); }
     STDMETHODIMP GetForceFeedbackState(LPDWORD pdwOut) override { return realDev->GetForceFeedbackState(pdwOut); }
     STDMETHODIMP SendForceFeedbackCommand(DWORD dwFlags) override {
-        logf("[proxy] SendForceFeedbackCommand flags=0x%08lx", dwFlags);
+        LOG_CALL("[proxy] SendForceFeedbackCommand flags=0x%08lx", dwFlags);
+        forward_ffb_command(dwFlags);
         HRESULT hr = realDev->SendForceFeedbackCommand(dwFlags);
-        logf("[proxy] SendForceFeedbackCommand -> hr=0x%08lx", (unsigned long)hr);
+        trace_device(FFB_TRACE_FF_COMMAND, dwFlags, hr);
+        LOG_CALL("[proxy] SendForceFeedbackCommand -> hr=0x%08lx", (unsigned long)hr);
         return hr;
     }
     STDMETHODIMP EnumCreatedEffectObjects(LPDIENUMCREATEDEFFECTOBJECTSCALLBACK cb, LPVOID pvRef, DWORD fl) override {
         return realDev->EnumCreatedEffectObjects(cb, pvRef, fl);
     }
     STDMETHODIMP Escape(LPDIEFFESCAPE pesc) override { return realDev->Escape(pesc); }
-    STDMETHODIMP Poll() override { return realDev->Poll(); }
+    STDMETHODIMP Poll() override {
+        note_game_alive();
+        return realDev->Poll();
+    }
     STDMETHODIMP SendDeviceData(DWORD cbObjectData, LPCDIDEVICEOBJECTDATA rgdod, LPDWORD pdwInOut, DWORD dwFlags) override {
         return realDev->SendDeviceData(cbObjectData, rgdod, pdwInOut, dwFlags);
     }
@@ -639,11 +1769,12 @@ public:
 private:
     LONG refCount;
     IDirectInputDevice8W *realDev;
+    bool ffb; // created an effect: its release ends the lease
 };
 
 class DirectInputDevice8ProxyA : public IDirectInputDevice8A {
 public:
-    DirectInputDevice8ProxyA(IDirectInputDevice8A *real) : refCount(1), realDev(real) {}
+    DirectInputDevice8ProxyA(IDirectInputDevice8A *real) : refCount(1), realDev(real), ffb(false) {}
 
     STDMETHODIMP QueryInterface(REFIID riid, LPVOID *ppv) override {
         if (!ppv) return E_POINTER;
@@ -652,9 +1783,7 @@ public:
             riid == IID_IDirectInputDevice7A ||
             riid == IID_IDirectInputDevice2A ||
             riid == IID_IDirectInputDeviceA) {
-            char gbuf[64];
-            guid_to_string(riid, gbuf, sizeof(gbuf));
-            logf("[proxy] Device QI (A) riid=%s -> wrapper", gbuf);
+            LOG_CALL("[proxy] Device QI (A) riid=%s -> wrapper", guid_text(riid).s);
             *ppv = static_cast<IDirectInputDevice8A *>(this);
             AddRef();
             return S_OK;
@@ -670,7 +1799,10 @@ public:
     STDMETHODIMP_(ULONG) Release() override {
         realDev->Release();
         ULONG r = InterlockedDecrement(&refCount);
-        if (r == 0) delete this;
+        if (r == 0) {
+            if (ffb) end_lease();
+            delete this;
+        }
         return r;
     }
 
@@ -678,46 +1810,55 @@ public:
         HRESULT hr = realDev->GetCapabilities(caps);
         if (SUCCEEDED(hr) && caps) {
             caps->dwFlags |= (DIDC_FORCEFEEDBACK | DIDC_FFATTACK | DIDC_FFFADE);
-            logf("[proxy] GetCapabilities -> force feedback enabled");
+            LOG_CALL("[proxy] GetCapabilities -> force feedback enabled");
         } else if (FAILED(hr)) {
-            logf("[proxy] GetCapabilities -> hr=0x%08lx", (unsigned long)hr);
+            LOG_CALL("[proxy] GetCapabilities -> hr=0x%08lx", (unsigned long)hr);
         }
         return hr;
     }
     STDMETHODIMP EnumObjects(LPDIENUMDEVICEOBJECTSCALLBACKA cb, LPVOID pvRef, DWORD dwFlags) override { return realDev->EnumObjects(cb, pvRef, dwFlags); }
     STDMETHODIMP GetProperty(REFGUID rguid, LPDIPROPHEADER ph) override { return realDev->GetProperty(rguid, ph); }
-    STDMETHODIMP SetProperty(REFGUID rguid, LPCDIPROPHEADER ph) override { return realDev->SetProperty(rguid, ph); }
+    STDMETHODIMP SetProperty(REFGUID rguid, LPCDIPROPHEADER ph) override {
+        forward_property(rguid, ph);
+        return realDev->SetProperty(rguid, ph);
+    }
     STDMETHODIMP Acquire() override {
-        logf("[proxy] Acquire");
+        LOG_CALL("[proxy] Acquire");
         HRESULT hr = realDev->Acquire();
-        logf("[proxy] Acquire -> hr=0x%08lx", (unsigned long)hr);
+        trace_device(FFB_TRACE_ACQUIRE, 0, hr);
+        LOG_CALL("[proxy] Acquire -> hr=0x%08lx", (unsigned long)hr);
         return hr;
     }
     STDMETHODIMP Unacquire() override {
-        logf("[proxy] Unacquire");
+        LOG_CALL("[proxy] Unacquire");
         HRESULT hr = realDev->Unacquire();
-        logf("[proxy] Unacquire -> hr=0x%08lx", (unsigned long)hr);
+        trace_device(FFB_TRACE_UNACQUIRE, 0, hr);
+        LOG_CALL("[proxy] Unacquire -> hr=0x%08lx", (unsigned long)hr);
         return hr;
     }
-    STDMETHODIMP GetDeviceState(DWORD cbData, LPVOID lpvData) override { return realDev->GetDeviceState(cbData, lpvData); }
+    STDMETHODIMP GetDeviceState(DWORD cbData, LPVOID lpvData) override {
+        note_game_alive();
+        return realDev->GetDeviceState(cbData, lpvData);
+    }
     STDMETHODIMP GetDeviceData(DWORD cbObjectData, LPDIDEVICEOBJECTDATA rgdod, LPDWORD pdwInOut, DWORD dwFlags) override {
+        note_game_alive();
         return realDev->GetDeviceData(cbObjectData, rgdod, pdwInOut, dwFlags);
     }
     STDMETHODIMP SetDataFormat(LPCDIDATAFORMAT lpdf) override {
-        logf("[proxy] SetDataFormat");
+        LOG_CALL("[proxy] SetDataFormat");
         if (lpdf) {
-            logf("[proxy] SetDataFormat size=%lu data=%lu objs=%lu flags=0x%08lx",
+            LOG_CALL("[proxy] SetDataFormat size=%lu data=%lu objs=%lu flags=0x%08lx",
                  lpdf->dwSize, lpdf->dwDataSize, lpdf->dwNumObjs, lpdf->dwFlags);
         }
         HRESULT hr = realDev->SetDataFormat(lpdf);
-        logf("[proxy] SetDataFormat -> hr=0x%08lx", (unsigned long)hr);
+        LOG_CALL("[proxy] SetDataFormat -> hr=0x%08lx", (unsigned long)hr);
         return hr;
     }
     STDMETHODIMP SetEventNotification(HANDLE hEvent) override { return realDev->SetEventNotification(hEvent); }
     STDMETHODIMP SetCooperativeLevel(HWND hwnd, DWORD dwFlags) override {
-        logf("[proxy] SetCooperativeLevel flags=0x%08lx", dwFlags);
+        LOG_CALL("[proxy] SetCooperativeLevel flags=0x%08lx", dwFlags);
         HRESULT hr = realDev->SetCooperativeLevel(hwnd, dwFlags);
-        logf("[proxy] SetCooperativeLevel -> hr=0x%08lx", (unsigned long)hr);
+        LOG_CALL("[proxy] SetCooperativeLevel -> hr=0x%08lx", (unsigned long)hr);
         return hr;
     }
     STDMETHODIMP GetObjectInfo(LPDIDEVICEOBJECTINSTANCEA pdidoi, DWORD dwObj, DWORD dwHow) override {
@@ -726,14 +1867,10 @@ public:
     STDMETHODIMP GetDeviceInfo(LPDIDEVICEINSTANCEA pdidi) override {
         HRESULT hr = realDev->GetDeviceInfo(pdidi);
         if (SUCCEEDED(hr) && pdidi) {
-            char gprod[64];
-            char ginst[64];
-            guid_to_string(pdidi->guidProduct, gprod, sizeof(gprod));
-            guid_to_string(pdidi->guidInstance, ginst, sizeof(ginst));
-            logf("[proxy] GetDeviceInfo devType=0x%08lx guidProduct=%s guidInstance=%s",
-                 pdidi->dwDevType, gprod, ginst);
+            LOG_CALL("[proxy] GetDeviceInfo devType=0x%08lx guidProduct=%s guidInstance=%s",
+                 pdidi->dwDevType, guid_text(pdidi->guidProduct).s, guid_text(pdidi->guidInstance).s);
         } else if (FAILED(hr)) {
-            logf("[proxy] GetDeviceInfo -> hr=0x%08lx", (unsigned long)hr);
+            LOG_CALL("[proxy] GetDeviceInfo -> hr=0x%08lx", (unsigned long)hr);
         }
         return hr;
     }
@@ -741,19 +1878,19 @@ public:
     STDMETHODIMP Initialize(HINSTANCE hinst, DWORD dwVersion, REFGUID rguid) override { return realDev->Initialize(hinst, dwVersion, rguid); }
 
     STDMETHODIMP CreateEffect(REFGUID rguid, LPCDIEFFECT lpeff, LPDIRECTINPUTEFFECT *ppdeff, LPUNKNOWN pUnkOuter) override {
-        char gbuf[64];
-        guid_to_string(rguid, gbuf, sizeof(gbuf));
-        logf("[proxy] CreateEffect guid=%s", gbuf);
+        LOG_CALL("[proxy] CreateEffect guid=%s", guid_text(rguid).s);
         HRESULT hr = realDev->CreateEffect(rguid, lpeff, ppdeff, pUnkOuter);
-        logf("[proxy] CreateEffect -> hr=0x%08lx", (unsigned long)hr);
+        LOG_CALL("[proxy] CreateEffect -> hr=0x%08lx", (unsigned long)hr);
         if ((hr == DIERR_UNSUPPORTED || hr == E_NOTIMPL) && ppdeff) {
-            logf("[proxy] CreateEffect unsupported; using fake effect");
-            *ppdeff = new DirectInputEffectFake(rguid);
+            LOG_INFO("[proxy] CreateEffect unsupported; using fake effect");
+            *ppdeff = new DirectInputEffectFake(rguid, lpeff);
+            ffb = true;
             return DI_OK;
         }
         if (SUCCEEDED(hr) && ppdeff && *ppdeff) {
+            ffb = true;
             IDirectInputEffect *realEff = *ppdeff;
-            *ppdeff = new DirectInputEffectProxy(realEff, rguid);
+            *ppdeff = new DirectInputEffectProxy(realEff, rguid, lpeff);
         }
         return hr;
     }
@@ -767,10 +1904,8 @@ public:
         auto thunk = [](LPCDIEFFECTINFOA info, LPVOID ref) -> BOOL {
             Ctx *c = (Ctx *)ref;
             if (info) {
-                char gbuf[64];
-                guid_to_string(info->guid, gbuf, sizeof(gbuf));
-                logf("[proxy] EnumEffects (A) guid=%s type=0x%08lx static=0x%08lx dynamic=0x%08lx",
-                     gbuf, info->dwEffType, info->dwStaticParams, info->dwDynamicParams);
+                LOG_CALL("[proxy] EnumEffects (A) guid=%s type=0x%08lx static=0x%08lx dynamic=0x%08lx",
+                     guid_text(info->guid).s, info->dwEffType, info->dwStaticParams, info->dwDynamicParams);
             }
             return c->cb ? c->cb(info, c->pvRef) : DIENUM_CONTINUE;
         };
@@ -780,16 +1915,21 @@ public:
     STDMETHODIMP GetEffectInfo(LPDIEFFECTINFOA pei, REFGUID rguid) override { return realDev->GetEffectInfo(pei, rguid); }
     STDMETHODIMP GetForceFeedbackState(LPDWORD pdwOut) override { return realDev->GetForceFeedbackState(pdwOut); }
     STDMETHODIMP SendForceFeedbackCommand(DWORD dwFlags) override {
-        logf("[proxy] SendForceFeedbackCommand flags=0x%08lx", dwFlags);
+        LOG_CALL("[proxy] SendForceFeedbackCommand flags=0x%08lx", dwFlags);
+        forward_ffb_command(dwFlags);
         HRESULT hr = realDev->SendForceFeedbackCommand(dwFlags);
-        logf("[proxy] SendForceFeedbackCommand -> hr=0x%08lx", (unsigned long)hr);
+        trace_device(FFB_TRACE_FF_COMMAND, dwFlags, hr);
+        LOG_CALL("[proxy] SendForceFeedbackCommand -> hr=0x%08lx", (unsigned long)hr);
         return hr;
     }
     STDMETHODIMP EnumCreatedEffectObjects(LPDIENUMCREATEDEFFECTOBJECTSCALLBACK cb, LPVOID pvRef, DWORD fl) override {
         return realDev->EnumCreatedEffectObjects(cb, pvRef, fl);
     }
     STDMETHODIMP Escape(LPDIEFFESCAPE pesc) override { return realDev->Escape(pesc); }
-    STDMETHODIMP Poll() override { return realDev->Poll(); }
+    STDMETHODIMP Poll() override {
+        note_game_alive();
+        return realDev->Poll();
+    }
     STDMETHODIMP SendDeviceData(DWORD cbObjectData, LPCDIDEVICEOBJECTDATA rgdod, LPDWORD pdwInOut, DWORD dwFlags) override {
         return realDev->SendDeviceData(cbObjectData, rgdod, pdwInOut, dwFlags);
     }
@@ -810,6 +1950,7 @@ public:
 private:
     LONG refCount;
     IDirectInputDevice8A *realDev;
+    bool ffb; // created an effect: its release ends the lease
 };
 
 class DirectInput8ProxyW : public IDirectInput8W {
@@ -839,11 +1980,9 @@ public:
     }
 
     STDMETHODIMP CreateDevice(REFGUID rguid, LPDIRECTINPUTDEVICE8W *lplpDirectInputDevice, LPUNKNOWN pUnkOuter) override {
-        char gbuf[64];
-        guid_to_string(rguid, gbuf, sizeof(gbuf));
-        logf("[proxy] CreateDevice (W) guid=%s", gbuf);
+        LOG_CALL("[proxy] CreateDevice (W) guid=%s", guid_text(rguid).s);
         HRESULT hr = realDI->CreateDevice(rguid, lplpDirectInputDevice, pUnkOuter);
-        logf("[proxy] CreateDevice (W) -> hr=0x%08lx", (unsigned long)hr);
+        LOG_CALL("[proxy] CreateDevice (W) -> hr=0x%08lx", (unsigned long)hr);
         if (SUCCEEDED(hr) && lplpDirectInputDevice && *lplpDirectInputDevice) {
             *lplpDirectInputDevice = new DirectInputDevice8ProxyW(*lplpDirectInputDevice);
         }
@@ -900,11 +2039,9 @@ public:
     }
 
     STDMETHODIMP CreateDevice(REFGUID rguid, LPDIRECTINPUTDEVICE8A *lplpDirectInputDevice, LPUNKNOWN pUnkOuter) override {
-        char gbuf[64];
-        guid_to_string(rguid, gbuf, sizeof(gbuf));
-        logf("[proxy] CreateDevice (A) guid=%s", gbuf);
+        LOG_CALL("[proxy] CreateDevice (A) guid=%s", guid_text(rguid).s);
         HRESULT hr = realDI->CreateDevice(rguid, lplpDirectInputDevice, pUnkOuter);
-        logf("[proxy] CreateDevice (A) -> hr=0x%08lx", (unsigned long)hr);
+        LOG_CALL("[proxy] CreateDevice (A) -> hr=0x%08lx", (unsigned long)hr);
         if (SUCCEEDED(hr) && lplpDirectInputDevice && *lplpDirectInputDevice) {
             *lplpDirectInputDevice = new DirectInputDevice8ProxyA(*lplpDirectInputDevice);
         }
@@ -935,31 +2072,36 @@ private:
 
 extern "C" __declspec(dllexport)
 HRESULT WINAPI DirectInput8Create(HINSTANCE hinst, DWORD dwVersion, REFIID riid, LPVOID *ppvOut, LPUNKNOWN punkOuter) {
+    // Every interface the hooks see comes from here, so logging is settled before any of them runs.
+    init_log();
     ensure_real_loaded();
     if (!g_real_DirectInput8Create) return E_FAIL;
 
-    logf("[proxy] DirectInput8Create called");
+    LOG_INFO("[proxy] DirectInput8Create called");
     HRESULT hr = g_real_DirectInput8Create(hinst, dwVersion, riid, ppvOut, punkOuter);
     if (FAILED(hr) || !ppvOut || !*ppvOut) return hr;
 
     if (riid == IID_IDirectInput8W || riid == IID_IDirectInput8) {
         IDirectInput8W *real = (IDirectInput8W *)*ppvOut;
         *ppvOut = new DirectInput8ProxyW(real);
-        logf("[proxy] Wrapped IDirectInput8W");
+        LOG_INFO("[proxy] Wrapped IDirectInput8W");
     } else if (riid == IID_IDirectInput8A) {
         IDirectInput8A *real = (IDirectInput8A *)*ppvOut;
         *ppvOut = new DirectInput8ProxyA(real);
-        logf("[proxy] Wrapped IDirectInput8A");
+        LOG_INFO("[proxy] Wrapped IDirectInput8A");
     } else {
-        logf("[proxy] Unknown riid, returning real interface");
+        LOG_INFO("[proxy] Unknown riid, returning real interface");
     }
     return hr;
 }
 
 BOOL WINAPI DllMain(HINSTANCE hinst, DWORD reason, LPVOID reserved) {
-    (void)reserved;
     if (reason == DLL_PROCESS_ATTACH) {
         DisableThreadLibraryCalls(hinst);
+    } else if (reason == DLL_PROCESS_DETACH && reserved && g_log_thread) {
+        // Process exit: the writer thread is already gone, so whatever is left is ours to write.
+        trace_drain();
+        if (g_log_async) log_drain();
     }
     return TRUE;
 }
@@ -1,44 +1,556 @@
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <windows.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <windows.h>
 
-#pragma comment(lib, "ws2_32.lib")
+#include "../common/ffb_wire.h"
+
+/* Winsock and POSIX sockets differ in a few names only. */
+#ifdef _WIN32
+typedef HANDLE thread_t;
+#define sock_error() WSAGetLastError()
+#define SLEEP_SLACK_US 16000 /* default timer resolution: Sleep(1) can take a full tick */
+#else
+typedef int SOCKET;
+typedef pthread_t thread_t;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define closesocket close
+#define sock_error() errno
+#define SLEEP_SLACK_US 2000
+#endif
+
+/* One daemon session: its client ID and the sequence its packets are numbered in. The
+   daemon drops a packet numbered below one it already applied, so a sequence is only
+   ever used from one thread, in send order. */
+typedef struct WireSender {
+    uint16_t client_id;
+    uint32_t seq;
+} WireSender;
+
+static int g_text = 0;
+static int g_lease_ms = 0;
+static WireSender g_wire;        /* --client-id, default the process ID */
+static uint8_t g_priority = 50;  /* --priority, below the proxy's default of 100 */
 
 static void usage(const char *exe) {
     fprintf(stderr,
-        "Usage:\n"
-        "  %s [--host HOST] [--port PORT] const <value> [--hold ms] [--interval ms]\n"
-        "  %s [--host HOST] [--port PORT] stop\n"
-        "  %s [--host HOST] [--port PORT] sweep\n"
+        "Usage (every form also takes --client-id ID --priority 0-255 before the command):\n"
+        "  %s [--host HOST] [--port PORT] [--text] const <value> [--hold ms] [--interval ms] [--lease ms]\n"
+        "  %s [--host HOST] [--port PORT] [--text] stop\n"
+        "  %s [--host HOST] [--port PORT] [--text] sweep\n"
+        "  %s [--host HOST] [--port PORT] stress [--rate HZ] [--seconds N] [--senders N] [--jitter us]\n"
+        "                                         [--burst N --burst-every ms] [--pattern P] [--value V] [--stats]\n"
+        "  %s [--host HOST] [--port PORT] stats\n"
+        "\n"
+        "Values are -100..100. Packets use the binary wire format unless --text is given.\n"
+        "const --lease: send the value once, then only heartbeats (every lease/3) until --hold ends.\n"
+        "stress: every sender keeps --rate packets/s (default 1000) for --seconds (default 10)\n"
+        "on its own socket and effect ID, each send shifted by up to +-jitter us; --burst adds\n"
+        "N back-to-back packets every --burst-every ms. Patterns: const (--value), sine,\n"
+        "random, steps (default random). Prints achieved rate and send lateness per sender;\n"
+        "--stats adds what the daemon counted over the run (its STATS query).\n"
+        "stats: prints the daemon's runtime counters.\n"
+        "Binary packets carry --client-id (default the process ID) and --priority (default 50),\n"
+        "which the daemon arbitrates on (g29ffb --arbitrate); text commands go by address.\n"
         "\n"
         "Examples:\n"
         "  %s const 40\n"
         "  %s --host 127.0.0.1 --port 21999 const -30 --hold 1500 --interval 50\n"
-        "  %s sweep\n",
-        exe, exe, exe, exe, exe, exe
+        "  %s sweep\n"
+        "  %s stress --rate 2000 --senders 4 --jitter 200 --burst 16 --burst-every 500\n",
+        exe, exe, exe, exe, exe, exe, exe, exe, exe
     );
 }
 
+static int net_init(void) {
+#ifdef _WIN32
+    WSADATA wsa;
+    return WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+#else
+    return 1;
+#endif
+}
+
+static void net_cleanup(void) {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+/* Same clock as the proxy: QueryPerformanceCounter, which Wine counts in
+   CLOCK_MONOTONIC_RAW, so ffb_replay sink can compare timestamps on Linux. */
+static uint64_t now_us(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, t;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (uint64_t)(t.QuadPart / freq.QuadPart) * 1000000ULL +
+           (uint64_t)(t.QuadPart % freq.QuadPart) * 1000000ULL / (uint64_t)freq.QuadPart;
+#else
+    struct timespec ts;
+#ifdef CLOCK_MONOTONIC_RAW
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+#endif
+}
+
+static void sleep_ms(int ms) {
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    usleep((useconds_t)ms * 1000);
+#endif
+}
+
+static void yield_cpu(void) {
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+/* Sleeps most of the way, then spins: kHz rates need better than the OS timer. */
+static void wait_until_us(uint64_t deadline) {
+    for (;;) {
+        uint64_t now = now_us();
+        if (now >= deadline) return;
+        uint64_t left = deadline - now;
+        if (left > SLEEP_SLACK_US) {
+            sleep_ms((int)((left - SLEEP_SLACK_US) / 1000) + 1);
+        } else {
+            yield_cpu();
+        }
+    }
+}
+
 static int send_msg(SOCKET s, const struct sockaddr_in *addr, const char *msg) {
     int len = (int)strlen(msg);
     int r = sendto(s, msg, len, 0, (const struct sockaddr *)addr, sizeof(*addr));
     if (r == SOCKET_ERROR) {
-        fprintf(stderr, "sendto failed: %d\n", WSAGetLastError());
+        fprintf(stderr, "sendto failed: %d\n", sock_error());
+        return 0;
+    }
+    return 1;
+}
+
+/* magnitude in -10000..10000. */
+static int send_effect(SOCKET s, const struct sockaddr_in *addr, WireSender *w, uint16_t effect_id, int playing,
+                       int magnitude, int quiet) {
+    FfbWireEffect pkt;
+    ffb_wire_init_header(&pkt.hdr, FFB_KIND_EFFECT, (uint16_t)sizeof(pkt), ++w->seq, now_us());
+    pkt.hdr.client_id = w->client_id;
+    pkt.hdr.priority = g_priority;
+    pkt.effect_id = effect_id;
+    pkt.effect_type = FFB_EFFECT_CONSTANT;
+    pkt.state = playing ? FFB_STATE_PLAYING : FFB_STATE_STOPPED;
+    pkt.magnitude = (int16_t)magnitude;
+    pkt.gain = FFB_MAGNITUDE_MAX;
+    int r = sendto(s, (const char *)&pkt, (int)sizeof(pkt), 0, (const struct sockaddr *)addr, sizeof(*addr));
+    if (r == SOCKET_ERROR) {
+        if (!quiet) fprintf(stderr, "sendto failed: %d\n", sock_error());
+        return 0;
+    }
+    return 1;
+}
+
+static int send_packet(SOCKET s, const struct sockaddr_in *addr, int playing, int value) {
+    return send_effect(s, addr, &g_wire, 1, playing, value * (FFB_MAGNITUDE_MAX / 100), 0);
+}
+
+static int send_const(SOCKET s, const struct sockaddr_in *addr, int value) {
+    if (value < -100) value = -100;
+    if (value > 100) value = 100;
+    if (!g_text) return send_packet(s, addr, 1, value);
+    char msg[64];
+    snprintf(msg, sizeof(msg), "CONST %d", value);
+    return send_msg(s, addr, msg);
+}
+
+static int clamp_lease(int ms) {
+    return ms < 0 ? 0 : ms > 65535 ? 65535 : ms;
+}
+
+/* Holds the daemon's current state for lease_ms (0 ends the lease). */
+static int send_heartbeat(SOCKET s, const struct sockaddr_in *addr, int lease_ms) {
+    FfbWireHeartbeat pkt;
+    ffb_wire_init_header(&pkt.hdr, FFB_KIND_HEARTBEAT, (uint16_t)sizeof(pkt), ++g_wire.seq, now_us());
+    pkt.hdr.client_id = g_wire.client_id;
+    pkt.hdr.priority = g_priority;
+    pkt.lease_ms = (uint16_t)lease_ms;
+    pkt.reserved0 = 0;
+    pkt.reserved = 0;
+    int r = sendto(s, (const char *)&pkt, (int)sizeof(pkt), 0, (const struct sockaddr *)addr, sizeof(*addr));
+    if (r == SOCKET_ERROR) {
+        fprintf(stderr, "sendto failed: %d\n", sock_error());
         return 0;
     }
     return 1;
 }
 
+static int send_stop(SOCKET s, const struct sockaddr_in *addr) {
+    if (!g_text) return send_packet(s, addr, 0, 0);
+    return send_msg(s, addr, "STOP");
+}
+
+/* ---- stats ---- */
+
+#define STATS_REPLY_MAX 8192
+
+/* Sends STATS and waits up to timeout_ms for the daemon's "name value" lines. Returns
+   the reply length, or -1 when nothing came back (daemon not running, or older). */
+static int query_stats(SOCKET s, const struct sockaddr_in *addr, char *buf, int cap, int timeout_ms) {
+#ifdef _WIN32
+    DWORD tv = (DWORD)timeout_ms;
+#else
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+#endif
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char *)&tv, sizeof(tv));
+    if (!send_msg(s, addr, "STATS")) return -1;
+    int r = recvfrom(s, buf, cap - 1, 0, NULL, NULL);
+    if (r == SOCKET_ERROR || r <= 0) return -1;
+    buf[r] = '\0';
+    return r;
+}
+
+/* Value of the line "name value" in a STATS reply, 0 if absent. */
+static unsigned long long stats_value(const char *text, const char *name) {
+    size_t len = strlen(name);
+    for (const char *line = text; line && *line; line = strchr(line, '\n'), line = line ? line + 1 : NULL) {
+        if (strncmp(line, name, len) == 0 && line[len] == ' ') return strtoull(line + len + 1, NULL, 10);
+    }
+    return 0;
+}
+
+/* ---- stress ---- */
+
+enum { PATTERN_CONST, PATTERN_SINE, PATTERN_RANDOM, PATTERN_STEPS };
+
+#define LATE_BUCKET_US 10
+#define LATE_BUCKETS 10000 /* 10 us each, up to 100 ms; the last one holds the rest */
+
+typedef struct StressConfig {
+    struct sockaddr_in addr;
+    int rate_hz;     /* per sender */
+    int seconds;
+    int senders;
+    int jitter_us;
+    int burst;
+    int burst_every_ms;
+    int pattern;
+    int value;       /* -100..100, PATTERN_CONST */
+    int stats;       /* query the daemon's counters before and after */
+    uint64_t start_us;
+} StressConfig;
+
+typedef struct Sender {
+    const StressConfig *cfg;
+    int index;
+    SOCKET sock;
+    WireSender wire; /* a session of its own: its sends are not ordered against the others' */
+    uint64_t rng;
+    uint64_t sent;
+    uint64_t burst_sent;
+    uint64_t errors;
+    uint64_t first_us;
+    uint64_t last_us;
+    uint64_t late_max_us;
+    uint32_t late[LATE_BUCKETS];
+} Sender;
+
+static uint32_t next_random(Sender *s) {
+    s->rng ^= s->rng << 13;
+    s->rng ^= s->rng >> 7;
+    s->rng ^= s->rng << 17;
+    return (uint32_t)(s->rng >> 32);
+}
+
+/* Force at t seconds into the run, -10000..10000. */
+static int pattern_magnitude(Sender *s, double t) {
+    switch (s->cfg->pattern) {
+    case PATTERN_CONST:
+        return s->cfg->value * (FFB_MAGNITUDE_MAX / 100);
+    case PATTERN_SINE:
+        /* Each sender at its own frequency, 1..8 Hz. */
+        return (int)(8000.0 * sin(2.0 * 3.14159265358979 * (1 + s->index % 8) * t));
+    case PATTERN_STEPS:
+        return ((int)(t * 4) + s->index) % 2 ? 6000 : -6000;
+    default:
+        return (int)(next_random(s) % (2 * FFB_MAGNITUDE_MAX + 1)) - FFB_MAGNITUDE_MAX;
+    }
+}
+
+static void record_send(Sender *s, int ok, uint64_t deadline, uint64_t sent_at) {
+    if (!ok) {
+        s->errors++;
+        return;
+    }
+    if (s->sent == 0) s->first_us = sent_at;
+    s->last_us = sent_at;
+    s->sent++;
+    uint64_t late = sent_at > deadline ? sent_at - deadline : 0;
+    if (late > s->late_max_us) s->late_max_us = late;
+    uint64_t b = late / LATE_BUCKET_US;
+    s->late[b < LATE_BUCKETS ? b : LATE_BUCKETS - 1]++;
+}
+
+static uint64_t late_percentile_us(const Sender *s, double p) {
+    uint64_t total = 0;
+    for (int i = 0; i < LATE_BUCKETS; i++) total += s->late[i];
+    if (total == 0) return 0;
+    uint64_t want = (uint64_t)(p * (double)(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < LATE_BUCKETS; i++) {
+        seen += s->late[i];
+        if (seen >= want) return (uint64_t)i * LATE_BUCKET_US;
+    }
+    return (uint64_t)(LATE_BUCKETS - 1) * LATE_BUCKET_US;
+}
+
+/* Deadlines are taken from the start of the run, not from the previous send, so a late
+   send is caught up instead of lowering the rate. */
+static void stress_sender(Sender *s) {
+    const StressConfig *cfg = s->cfg;
+    uint16_t effect_id = (uint16_t)(1 + s->index);
+    uint64_t period_us = 1000000ULL / (uint64_t)cfg->rate_hz;
+    uint64_t end_us = cfg->start_us + (uint64_t)cfg->seconds * 1000000ULL;
+    uint64_t next_burst_us = cfg->burst > 0 ? cfg->start_us + (uint64_t)cfg->burst_every_ms * 1000ULL : UINT64_MAX;
+
+    for (uint64_t n = 0;; n++) {
+        uint64_t deadline = cfg->start_us + n * period_us;
+        if (cfg->jitter_us > 0) {
+            int64_t shift = (int64_t)(next_random(s) % (uint32_t)(2 * cfg->jitter_us + 1)) - cfg->jitter_us;
+            if (shift < 0 && (uint64_t)-shift > deadline - cfg->start_us) shift = -(int64_t)(deadline - cfg->start_us);
+            deadline = (uint64_t)((int64_t)deadline + shift);
+        }
+        if (deadline >= end_us) break;
+        wait_until_us(deadline);
+        double t = (double)(now_us() - cfg->start_us) / 1e6;
+        int ok = send_effect(s->sock, &cfg->addr, &s->wire, effect_id, 1, pattern_magnitude(s, t), 1);
+        record_send(s, ok, deadline, now_us());
+
+        if (deadline >= next_burst_us) {
+            for (int k = 0; k < cfg->burst; k++) {
+                if (send_effect(s->sock, &cfg->addr, &s->wire, effect_id, 1, pattern_magnitude(s, t), 1)) {
+                    s->burst_sent++;
+                } else {
+                    s->errors++;
+                }
+            }
+            next_burst_us += (uint64_t)cfg->burst_every_ms * 1000ULL;
+        }
+    }
+    send_effect(s->sock, &cfg->addr, &s->wire, effect_id, 0, 0, 1);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI stress_thread(LPVOID param) {
+    stress_sender((Sender *)param);
+    return 0;
+}
+#else
+static void *stress_thread(void *param) {
+    stress_sender((Sender *)param);
+    return NULL;
+}
+#endif
+
+static int parse_pattern(const char *name) {
+    if (strcmp(name, "const") == 0) return PATTERN_CONST;
+    if (strcmp(name, "sine") == 0) return PATTERN_SINE;
+    if (strcmp(name, "steps") == 0) return PATTERN_STEPS;
+    if (strcmp(name, "random") == 0) return PATTERN_RANDOM;
+    return -1;
+}
+
+static const char *pattern_name(int pattern) {
+    static const char *names[] = { "const", "sine", "random", "steps" };
+    return names[pattern];
+}
+
+static int run_stress(const struct sockaddr_in *addr, int argc, char **argv, int i) {
+    StressConfig cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.addr = *addr;
+    cfg.rate_hz = 1000;
+    cfg.seconds = 10;
+    cfg.senders = 1;
+    cfg.burst_every_ms = 1000;
+    cfg.pattern = PATTERN_RANDOM;
+    cfg.value = 40;
+
+    for (; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "--stats") == 0) {
+            cfg.stats = 1;
+            continue;
+        }
+        if (!v) break;
+        if (strcmp(a, "--rate") == 0) cfg.rate_hz = atoi(v);
+        else if (strcmp(a, "--seconds") == 0) cfg.seconds = atoi(v);
+        else if (strcmp(a, "--senders") == 0) cfg.senders = atoi(v);
+        else if (strcmp(a, "--jitter") == 0) cfg.jitter_us = atoi(v);
+        else if (strcmp(a, "--burst") == 0) cfg.burst = atoi(v);
+        else if (strcmp(a, "--burst-every") == 0) cfg.burst_every_ms = atoi(v);
+        else if (strcmp(a, "--value") == 0) cfg.value = atoi(v);
+        else if (strcmp(a, "--pattern") == 0) {
+            cfg.pattern = parse_pattern(v);
+            if (cfg.pattern < 0) {
+                fprintf(stderr, "Unknown pattern: %s\n", v);
+                return 1;
+            }
+        } else break;
+        i++;
+    }
+    if (cfg.rate_hz < 1 || cfg.rate_hz > 1000000) cfg.rate_hz = 1000;
+    if (cfg.seconds < 1) cfg.seconds = 1;
+    if (cfg.senders < 1) cfg.senders = 1;
+    if (cfg.senders > 64) cfg.senders = 64;
+    if (cfg.jitter_us < 0) cfg.jitter_us = 0;
+    if (cfg.burst < 0) cfg.burst = 0;
+    if (cfg.burst_every_ms < 1) cfg.burst_every_ms = 1000;
+    if (cfg.value < -100) cfg.value = -100;
+    if (cfg.value > 100) cfg.value = 100;
+
+    Sender *senders = (Sender *)calloc((size_t)cfg.senders, sizeof(Sender));
+    thread_t *threads = (thread_t *)calloc((size_t)cfg.senders, sizeof(thread_t));
+    if (!senders || !threads) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (int k = 0; k < cfg.senders; k++) {
+        senders[k].cfg = &cfg;
+        senders[k].index = k;
+        senders[k].rng = 0x9E3779B97F4A7C15ULL * (uint64_t)(k + 1);
+        /* Consecutive IDs from --client-id, skipping 0; with --client-id 0 every sender's
+           own socket already makes it a session of its own. */
+        if (g_wire.client_id) {
+            uint16_t id = (uint16_t)(g_wire.client_id + k);
+            if (id < g_wire.client_id) id++; /* wrapped past 0 */
+            senders[k].wire.client_id = id;
+        }
+        senders[k].sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (senders[k].sock == INVALID_SOCKET) {
+            fprintf(stderr, "socket failed: %d\n", sock_error());
+            return 1;
+        }
+    }
+
+    printf("stress: %d sender(s) x %d Hz for %d s, jitter %d us, burst %d every %d ms, pattern %s\n",
+           cfg.senders, cfg.rate_hz, cfg.seconds, cfg.jitter_us, cfg.burst, cfg.burst_every_ms,
+           pattern_name(cfg.pattern));
+    fflush(stdout);
+
+    /* The daemon's counters never reset, so its side of the run is the difference. */
+    static char before[STATS_REPLY_MAX], after[STATS_REPLY_MAX];
+    SOCKET query = INVALID_SOCKET;
+    if (cfg.stats) {
+        query = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (query == INVALID_SOCKET || query_stats(query, addr, before, sizeof(before), 1000) < 0) {
+            printf("stats: no reply to STATS from the daemon, continuing without\n");
+            cfg.stats = 0;
+        }
+    }
+
+    /* Every sender counts from the same start, a little ahead so all threads are up. */
+    cfg.start_us = now_us() + 50000;
+    for (int k = 0; k < cfg.senders; k++) {
+#ifdef _WIN32
+        threads[k] = CreateThread(NULL, 0, stress_thread, &senders[k], 0, NULL);
+        if (threads[k]) SetThreadPriority(threads[k], THREAD_PRIORITY_ABOVE_NORMAL);
+#else
+        pthread_create(&threads[k], NULL, stress_thread, &senders[k]);
+#endif
+    }
+    for (int k = 0; k < cfg.senders; k++) {
+#ifdef _WIN32
+        WaitForSingleObject(threads[k], INFINITE);
+        CloseHandle(threads[k]);
+#else
+        pthread_join(threads[k], NULL);
+#endif
+    }
+
+    uint64_t total = 0, total_burst = 0, total_errors = 0;
+    for (int k = 0; k < cfg.senders; k++) {
+        Sender *s = &senders[k];
+        double span = s->sent > 1 ? (double)(s->last_us - s->first_us) / 1e6 : 0;
+        double rate = span > 0 ? (double)(s->sent - 1) / span : 0;
+        printf("sender %d: sent %llu (+%llu burst) %.1f Hz (%.2f%% of target), late p50 %llu us p99 %llu us"
+               " p99.9 %llu us max %llu us, errors %llu\n",
+               k, (unsigned long long)s->sent, (unsigned long long)s->burst_sent, rate,
+               100.0 * rate / cfg.rate_hz,
+               (unsigned long long)late_percentile_us(s, 0.5), (unsigned long long)late_percentile_us(s, 0.99),
+               (unsigned long long)late_percentile_us(s, 0.999), (unsigned long long)s->late_max_us,
+               (unsigned long long)s->errors);
+        total += s->sent;
+        total_burst += s->burst_sent;
+        total_errors += s->errors;
+        closesocket(s->sock);
+    }
+    printf("total: %llu packets (%llu burst) in %d s = %.0f packets/s, errors %llu\n",
+           (unsigned long long)(total + total_burst), (unsigned long long)total_burst, cfg.seconds,
+           (double)(total + total_burst) / cfg.seconds, (unsigned long long)total_errors);
+    if (cfg.stats) {
+        sleep_ms(200); /* let the daemon drain its socket */
+        if (query_stats(query, addr, after, sizeof(after), 1000) < 0) {
+            printf("daemon: no reply to STATS after the run\n");
+        } else {
+            /* Every sender also sent one stop packet. */
+            unsigned long long sent = (unsigned long long)(total + total_burst + (uint64_t)cfg.senders);
+#define DELTA(name) (stats_value(after, name) - stats_value(before, name))
+            unsigned long long got = DELTA("datagrams") - 1; /* minus the STATS query */
+            printf("daemon: received %llu of %llu sent (%.2f%%), superseded %llu, seq lost %llu stale %llu,"
+                   " rejected %llu, watchdog trips %llu\n",
+                   got, sent, sent ? 100.0 * (double)got / (double)sent : 0.0, DELTA("packets_superseded"),
+                   DELTA("seq_lost"), DELTA("seq_stale"), DELTA("packets_rejected"), DELTA("watchdog_trips"));
+            printf("daemon: hid written %llu failed %llu, reports elided %llu\n",
+                   DELTA("hid_written"), DELTA("hid_failed"), DELTA("reports_elided"));
+#undef DELTA
+        }
+    }
+    if (query != INVALID_SOCKET) closesocket(query);
+    free(threads);
+    free(senders);
+    return 0;
+}
+
 int main(int argc, char **argv) {
     const char *host = "127.0.0.1";
     int port = 21999;
     int hold_ms = 1000;
     int interval_ms = 50;
 
+#ifdef _WIN32
+    g_wire.client_id = (uint16_t)GetCurrentProcessId();
+#else
+    g_wire.client_id = (uint16_t)getpid();
+#endif
+    if (g_wire.client_id == 0) g_wire.client_id = 1; /* 0 would mean "no ID" */
+
     int i = 1;
     while (i < argc) {
         if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
@@ -61,6 +573,28 @@ int main(int argc, char **argv) {
             i += 2;
             continue;
         }
+        if (strcmp(argv[i], "--lease") == 0 && i + 1 < argc) {
+            g_lease_ms = clamp_lease(atoi(argv[i + 1]));
+            i += 2;
+            continue;
+        }
+        if (strcmp(argv[i], "--client-id") == 0 && i + 1 < argc) {
+            int id = atoi(argv[i + 1]);
+            g_wire.client_id = (uint16_t)(id < 0 ? 0 : id > 65535 ? 65535 : id);
+            i += 2;
+            continue;
+        }
+        if (strcmp(argv[i], "--priority") == 0 && i + 1 < argc) {
+            int prio = atoi(argv[i + 1]);
+            g_priority = (uint8_t)(prio < 0 ? 0 : prio > 255 ? 255 : prio);
+            i += 2;
+            continue;
+        }
+        if (strcmp(argv[i], "--text") == 0) {
+            g_text = 1;
+            i += 1;
+            continue;
+        }
         break;
     }
 
@@ -71,16 +605,15 @@ int main(int argc, char **argv) {
 
     const char *cmd = argv[i++];
 
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+    if (!net_init()) {
         fprintf(stderr, "WSAStartup failed\n");
         return 1;
     }
 
     SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
     if (s == INVALID_SOCKET) {
-        fprintf(stderr, "socket failed: %d\n", WSAGetLastError());
-        WSACleanup();
+        fprintf(stderr, "socket failed: %d\n", sock_error());
+        net_cleanup();
         return 1;
     }
 
@@ -91,52 +624,79 @@ int main(int argc, char **argv) {
     if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
         fprintf(stderr, "Invalid host: %s\n", host);
         closesocket(s);
-        WSACleanup();
+        net_cleanup();
         return 1;
     }
 
+    int rc = 0;
     if (strcmp(cmd, "stop") == 0) {
-        send_msg(s, &addr, "STOP");
+        send_stop(s, &addr);
     } else if (strcmp(cmd, "const") == 0) {
         if (i >= argc) {
             fprintf(stderr, "Missing value for const\n");
             usage(argv[0]);
             closesocket(s);
-            WSACleanup();
+            net_cleanup();
             return 1;
         }
         int value = atoi(argv[i]);
+        /* The options may also follow the value, as in the usage line. */
+        for (int k = i + 1; k + 1 < argc; k += 2) {
+            if (strcmp(argv[k], "--hold") == 0) hold_ms = atoi(argv[k + 1]);
+            else if (strcmp(argv[k], "--interval") == 0) interval_ms = atoi(argv[k + 1]);
+            else if (strcmp(argv[k], "--lease") == 0) g_lease_ms = clamp_lease(atoi(argv[k + 1]));
+            else break;
+        }
         if (interval_ms <= 0) interval_ms = 50;
         if (hold_ms < interval_ms) hold_ms = interval_ms;
 
         int elapsed = 0;
-        char msg[64];
-        while (elapsed < hold_ms) {
-            snprintf(msg, sizeof(msg), "CONST %d", value);
-            send_msg(s, &addr, msg);
-            Sleep((DWORD)interval_ms);
-            elapsed += interval_ms;
-        }
-        send_msg(s, &addr, "STOP");
+        if (g_lease_ms > 0 && !g_text) {
+            /* One update, then the lease keeps it: the daemon's watchdog alone would drop it. */
+            int beat_ms = g_lease_ms / 3 > 0 ? g_lease_ms / 3 : 1;
+            send_const(s, &addr, value);
+            while (elapsed < hold_ms) {
+                send_heartbeat(s, &addr, g_lease_ms);
+                sleep_ms(beat_ms);
+                elapsed += beat_ms;
+            }
+            send_stop(s, &addr);
+            send_heartbeat(s, &addr, 0);
+        } else {
+            while (elapsed < hold_ms) {
+                send_const(s, &addr, value);
+                sleep_ms(interval_ms);
+                elapsed += interval_ms;
+            }
+            send_stop(s, &addr);
+        }
     } else if (strcmp(cmd, "sweep") == 0) {
         const int values[] = { -60, -40, -20, 0, 20, 40, 60, 40, 20, 0, -20, -40, -60, 0 };
         const int steps = (int)(sizeof(values) / sizeof(values[0]));
-        char msg[64];
         for (int k = 0; k < steps; k++) {
-            snprintf(msg, sizeof(msg), "CONST %d", values[k]);
-            send_msg(s, &addr, msg);
-            Sleep(300);
+            send_const(s, &addr, values[k]);
+            sleep_ms(300);
+        }
+        send_stop(s, &addr);
+    } else if (strcmp(cmd, "stress") == 0) {
+        rc = run_stress(&addr, argc, argv, i);
+    } else if (strcmp(cmd, "stats") == 0) {
+        static char reply[STATS_REPLY_MAX];
+        if (query_stats(s, &addr, reply, sizeof(reply), 1000) < 0) {
+            fprintf(stderr, "No reply to STATS from %s:%d\n", host, port);
+            rc = 1;
+        } else {
+            fputs(reply, stdout);
         }
-        send_msg(s, &addr, "STOP");
     } else {
         fprintf(stderr, "Unknown command: %s\n", cmd);
         usage(argv[0]);
         closesocket(s);
-        WSACleanup();
+        net_cleanup();
         return 1;
     }
 
     closesocket(s);
-    WSACleanup();
-    return 0;
+    net_cleanup();
+    return rc;
 }
@@ -0,0 +1,322 @@
+/*
+ * Microbenchmark for the dinput8 proxy's COM hot path.
+ *
+ * Build (Linux, mingw-w64) and run under Wine:
+ *   x86_64-w64-mingw32-g++ -O2 -static -static-libstdc++ -static-libgcc -o proxy_bench.exe proxy_bench.cpp -lws2_32
+ *   wine proxy_bench.exe [--iterations N]
+ *
+ * The proxy source is compiled into this executable, and its wrapper classes are driven
+ * against mock device and effect objects that do no work, so what is timed is the proxy's
+ * own cost per call on the game thread: IDirectInputEffect::SetParameters for every
+ * effect type the proxy parses (new values each call, then the same values again), and
+ * the pass-through GetDeviceState/Poll of DirectInputDevice8ProxyW/A next to a direct
+ * call on the mock. Every case runs with logging off and on. Allocations are counted
+ * through operator new, which is what the proxy uses.
+ */
+#define LOG_PATH "proxy_bench.log"
+#include "../dinput8_proxy/dinput8_proxy.cpp"
+
+#include <new>
+
+static std::atomic<unsigned long long> g_bench_allocs(0);
+
+void *operator new(size_t n) {
+    g_bench_allocs.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+/* ---- mocks ---- */
+
+class MockEffect : public IDirectInputEffect {
+public:
+    MockEffect() : refCount(1) {}
+
+    STDMETHODIMP QueryInterface(REFIID, LPVOID *ppv) override {
+        if (ppv) *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+    STDMETHODIMP_(ULONG) AddRef() override { return InterlockedIncrement(&refCount); }
+    STDMETHODIMP_(ULONG) Release() override {
+        ULONG r = InterlockedDecrement(&refCount);
+        if (r == 0) delete this;
+        return r;
+    }
+    STDMETHODIMP Initialize(HINSTANCE, DWORD, REFGUID) override { return DI_OK; }
+    STDMETHODIMP GetEffectGuid(LPGUID) override { return DI_OK; }
+    STDMETHODIMP GetParameters(LPDIEFFECT, DWORD) override { return DI_OK; }
+    STDMETHODIMP SetParameters(LPCDIEFFECT, DWORD) override { return DI_OK; }
+    STDMETHODIMP Start(DWORD, DWORD) override { return DI_OK; }
+    STDMETHODIMP Stop() override { return DI_OK; }
+    STDMETHODIMP GetEffectStatus(LPDWORD) override { return DI_OK; }
+    STDMETHODIMP Download() override { return DI_OK; }
+    STDMETHODIMP Unload() override { return DI_OK; }
+    STDMETHODIMP Escape(LPDIEFFESCAPE) override { return DI_OK; }
+
+private:
+    LONG refCount;
+};
+
+// IDirectInputDevice8W and A differ only in their string and structure types.
+template <typename Iface, typename ObjectsCb, typename ObjectInfo, typename DeviceInfo, typename EffectsCb,
+          typename EffectInfo, typename Str, typename ActionFormat, typename ImageInfo>
+class MockDevice : public Iface {
+public:
+    // `unsupported`: CreateEffect fails the way Wine does without a FFB driver.
+    explicit MockDevice(bool unsupported) : refCount(1), unsupportedEffects(unsupported) {}
+
+    STDMETHODIMP QueryInterface(REFIID, LPVOID *ppv) override {
+        if (ppv) *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+    STDMETHODIMP_(ULONG) AddRef() override { return InterlockedIncrement(&refCount); }
+    STDMETHODIMP_(ULONG) Release() override {
+        ULONG r = InterlockedDecrement(&refCount);
+        if (r == 0) delete this;
+        return r;
+    }
+    STDMETHODIMP GetCapabilities(LPDIDEVCAPS) override { return DI_OK; }
+    STDMETHODIMP EnumObjects(ObjectsCb, LPVOID, DWORD) override { return DI_OK; }
+    STDMETHODIMP GetProperty(REFGUID, LPDIPROPHEADER) override { return DI_OK; }
+    STDMETHODIMP SetProperty(REFGUID, LPCDIPROPHEADER) override { return DI_OK; }
+    STDMETHODIMP Acquire() override { return DI_OK; }
+    STDMETHODIMP Unacquire() override { return DI_OK; }
+    // What a driver does at least: copy its last state out.
+    STDMETHODIMP GetDeviceState(DWORD cbData, LPVOID lpvData) override {
+        if (lpvData) memcpy(lpvData, state, cbData < sizeof(state) ? cbData : sizeof(state));
+        return DI_OK;
+    }
+    STDMETHODIMP GetDeviceData(DWORD, LPDIDEVICEOBJECTDATA, LPDWORD pdwInOut, DWORD) override {
+        if (pdwInOut) *pdwInOut = 0;
+        return DI_OK;
+    }
+    STDMETHODIMP SetDataFormat(LPCDIDATAFORMAT) override { return DI_OK; }
+    STDMETHODIMP SetEventNotification(HANDLE) override { return DI_OK; }
+    STDMETHODIMP SetCooperativeLevel(HWND, DWORD) override { return DI_OK; }
+    STDMETHODIMP GetObjectInfo(ObjectInfo, DWORD, DWORD) override { return DI_OK; }
+    STDMETHODIMP GetDeviceInfo(DeviceInfo) override { return DI_OK; }
+    STDMETHODIMP RunControlPanel(HWND, DWORD) override { return DI_OK; }
+    STDMETHODIMP Initialize(HINSTANCE, DWORD, REFGUID) override { return DI_OK; }
+    STDMETHODIMP CreateEffect(REFGUID, LPCDIEFFECT, LPDIRECTINPUTEFFECT *ppdeff, LPUNKNOWN) override {
+        if (!ppdeff) return DIERR_INVALIDPARAM;
+        if (unsupportedEffects) {
+            *ppdeff = nullptr;
+            return DIERR_UNSUPPORTED;
+        }
+        *ppdeff = new MockEffect();
+        return DI_OK;
+    }
+    STDMETHODIMP EnumEffects(EffectsCb, LPVOID, DWORD) override { return DI_OK; }
+    STDMETHODIMP GetEffectInfo(EffectInfo, REFGUID) override { return DI_OK; }
+    STDMETHODIMP GetForceFeedbackState(LPDWORD) override { return DI_OK; }
+    STDMETHODIMP SendForceFeedbackCommand(DWORD) override { return DI_OK; }
+    STDMETHODIMP EnumCreatedEffectObjects(LPDIENUMCREATEDEFFECTOBJECTSCALLBACK, LPVOID, DWORD) override { return DI_OK; }
+    STDMETHODIMP Escape(LPDIEFFESCAPE) override { return DI_OK; }
+    STDMETHODIMP Poll() override { return DI_OK; }
+    STDMETHODIMP SendDeviceData(DWORD, LPCDIDEVICEOBJECTDATA, LPDWORD, DWORD) override { return DI_OK; }
+    STDMETHODIMP EnumEffectsInFile(Str, LPDIENUMEFFECTSINFILECALLBACK, LPVOID, DWORD) override { return DI_OK; }
+    STDMETHODIMP WriteEffectToFile(Str, DWORD, LPDIFILEEFFECT, DWORD) override { return DI_OK; }
+    STDMETHODIMP BuildActionMap(ActionFormat, Str, DWORD) override { return DI_OK; }
+    STDMETHODIMP SetActionMap(ActionFormat, Str, DWORD) override { return DI_OK; }
+    STDMETHODIMP GetImageInfo(ImageInfo) override { return DI_OK; }
+
+private:
+    LONG refCount;
+    bool unsupportedEffects;
+    BYTE state[sizeof(DIJOYSTATE2)] = {0};
+};
+
+typedef MockDevice<IDirectInputDevice8W, LPDIENUMDEVICEOBJECTSCALLBACKW, LPDIDEVICEOBJECTINSTANCEW, LPDIDEVICEINSTANCEW,
+                   LPDIENUMEFFECTSCALLBACKW, LPDIEFFECTINFOW, LPCWSTR, LPDIACTIONFORMATW, LPDIDEVICEIMAGEINFOHEADERW>
+    MockDeviceW;
+typedef MockDevice<IDirectInputDevice8A, LPDIENUMDEVICEOBJECTSCALLBACKA, LPDIDEVICEOBJECTINSTANCEA, LPDIDEVICEINSTANCEA,
+                   LPDIENUMEFFECTSCALLBACKA, LPDIEFFECTINFOA, LPCSTR, LPDIACTIONFORMATA, LPDIDEVICEIMAGEINFOHEADERA>
+    MockDeviceA;
+
+/* ---- timing ---- */
+
+struct BenchResult {
+    double ns_per_call;
+    double allocs_per_call;
+};
+
+// Times `body(i)` over `iterations` calls after a short warm-up.
+template <typename F>
+static BenchResult bench(int iterations, F body) {
+    int warmup = iterations < 10000 ? iterations : 10000;
+    for (int i = 0; i < warmup; i++) body(i);
+    unsigned long long allocs = g_bench_allocs.load(std::memory_order_relaxed);
+    LARGE_INTEGER t0, t1;
+    QueryPerformanceCounter(&t0);
+    for (int i = 0; i < iterations; i++) body(warmup + i);
+    QueryPerformanceCounter(&t1);
+    BenchResult r;
+    r.ns_per_call = (double)(t1.QuadPart - t0.QuadPart) * 1e9 / (double)g_qpc_freq.QuadPart / iterations;
+    r.allocs_per_call = (double)(g_bench_allocs.load(std::memory_order_relaxed) - allocs) / iterations;
+    return r;
+}
+
+static void print_result(const char *name, BenchResult r) {
+    printf("  %-40s %9.1f ns/call %6.2f allocs/call\n", name, r.ns_per_call, r.allocs_per_call);
+}
+
+/* ---- effect parameters ---- */
+
+enum ParamKind { PARAMS_CONSTANT, PARAMS_RAMP, PARAMS_CONDITION, PARAMS_PERIODIC };
+
+struct BenchEffect {
+    const char *name;
+    const GUID *guid;
+    ParamKind kind;
+};
+
+static const BenchEffect k_effects[] = {
+    { "ConstantForce", &GUID_ConstantForce, PARAMS_CONSTANT },
+    { "RampForce", &GUID_RampForce, PARAMS_RAMP },
+    { "Spring", &GUID_Spring, PARAMS_CONDITION },
+    { "Damper", &GUID_Damper, PARAMS_CONDITION },
+    { "Friction", &GUID_Friction, PARAMS_CONDITION },
+    { "Inertia", &GUID_Inertia, PARAMS_CONDITION },
+    { "Sine", &GUID_Sine, PARAMS_PERIODIC },
+    { "Square", &GUID_Square, PARAMS_PERIODIC },
+    { "Triangle", &GUID_Triangle, PARAMS_PERIODIC },
+    { "SawtoothUp", &GUID_SawtoothUp, PARAMS_PERIODIC },
+    { "SawtoothDown", &GUID_SawtoothDown, PARAMS_PERIODIC },
+};
+
+// One DIEFFECT the way a racing game fills it: one axis, cartesian, gain and direction.
+struct EffectParams {
+    DWORD axes[1] = {0}; // DIJOFS_X
+    LONG direction[1] = {1};
+    DICONSTANTFORCE constant = {};
+    DIRAMPFORCE ramp = {};
+    DICONDITION condition = {};
+    DIPERIODIC periodic = {};
+    DIEFFECT eff = {};
+
+    explicit EffectParams(ParamKind kind) {
+        ramp.lEnd = 5000;
+        condition.lPositiveCoefficient = 5000;
+        condition.lNegativeCoefficient = 5000;
+        condition.dwPositiveSaturation = 10000;
+        condition.dwNegativeSaturation = 10000;
+        periodic.dwMagnitude = 5000;
+        periodic.dwPeriod = 100000;
+        eff.dwSize = sizeof(DIEFFECT);
+        eff.dwFlags = DIEFF_CARTESIAN | DIEFF_OBJECTOFFSETS;
+        eff.dwDuration = INFINITE;
+        eff.dwGain = 10000;
+        eff.cAxes = 1;
+        eff.rgdwAxes = axes;
+        eff.rglDirection = direction;
+        switch (kind) {
+        case PARAMS_CONSTANT: eff.cbTypeSpecificParams = sizeof(constant); eff.lpvTypeSpecificParams = &constant; break;
+        case PARAMS_RAMP: eff.cbTypeSpecificParams = sizeof(ramp); eff.lpvTypeSpecificParams = &ramp; break;
+        case PARAMS_CONDITION: eff.cbTypeSpecificParams = sizeof(condition); eff.lpvTypeSpecificParams = &condition; break;
+        case PARAMS_PERIODIC: eff.cbTypeSpecificParams = sizeof(periodic); eff.lpvTypeSpecificParams = &periodic; break;
+        }
+    }
+
+    // A new value every call: what a game sends from its physics step.
+    void vary(ParamKind kind, int i) {
+        LONG v = (LONG)(i % 2001) * 10 - 10000;
+        switch (kind) {
+        case PARAMS_CONSTANT: constant.lMagnitude = v; break;
+        case PARAMS_RAMP: ramp.lStart = v; break;
+        case PARAMS_CONDITION: condition.lPositiveCoefficient = v; break;
+        case PARAMS_PERIODIC: periodic.dwMagnitude = (DWORD)(v + 10000) / 2; break;
+        }
+    }
+};
+
+static const DWORD k_set_flags = DIEP_TYPESPECIFICPARAMS | DIEP_DIRECTION | DIEP_GAIN;
+
+static void bench_effect(IDirectInputDevice8W *dev, const BenchEffect &e, const char *suffix, int iterations) {
+    EffectParams p(e.kind);
+    IDirectInputEffect *eff = NULL;
+    if (FAILED(dev->CreateEffect(*e.guid, &p.eff, &eff, NULL)) || !eff) {
+        printf("  %s%s: CreateEffect failed\n", e.name, suffix);
+        return;
+    }
+    eff->SetParameters(&p.eff, k_set_flags);
+    eff->Start(1, 0);
+
+    char name[96];
+    _snprintf(name, sizeof(name), "SetParameters %s%s", e.name, suffix);
+    print_result(name, bench(iterations, [&](int i) {
+        p.vary(e.kind, i);
+        eff->SetParameters(&p.eff, k_set_flags);
+    }));
+    _snprintf(name, sizeof(name), "SetParameters %s%s, unchanged", e.name, suffix);
+    print_result(name, bench(iterations, [&](int) { eff->SetParameters(&p.eff, k_set_flags); }));
+
+    eff->Stop();
+    eff->Release();
+}
+
+static void run_suite(int iterations) {
+    MockDeviceW *realW = new MockDeviceW(false);
+    MockDeviceA *realA = new MockDeviceA(false);
+    DirectInputDevice8ProxyW *devW = new DirectInputDevice8ProxyW(realW);
+    DirectInputDevice8ProxyA *devA = new DirectInputDevice8ProxyA(realA);
+    IDirectInputDevice8W *directW = realW;
+    DIJOYSTATE2 state;
+
+    print_result("GetDeviceState, mock only", bench(iterations, [&](int) { directW->GetDeviceState(sizeof(state), &state); }));
+    print_result("GetDeviceState (W)", bench(iterations, [&](int) { devW->GetDeviceState(sizeof(state), &state); }));
+    print_result("GetDeviceState (A)", bench(iterations, [&](int) { devA->GetDeviceState(sizeof(state), &state); }));
+    print_result("Poll, mock only", bench(iterations, [&](int) { directW->Poll(); }));
+    print_result("Poll (W)", bench(iterations, [&](int) { devW->Poll(); }));
+    print_result("Poll (A)", bench(iterations, [&](int) { devA->Poll(); }));
+
+    for (const BenchEffect &e : k_effects) bench_effect(devW, e, "", iterations);
+
+    // Without a FFB driver the device refuses effects and the proxy hands out fakes.
+    DirectInputDevice8ProxyW *fakeW = new DirectInputDevice8ProxyW(new MockDeviceW(true));
+    bench_effect(fakeW, k_effects[0], " (fake)", iterations);
+
+    fakeW->Release();
+    devA->Release();
+    devW->Release();
+}
+
+int main(int argc, char **argv) {
+    int iterations = 200000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        }
+    }
+    if (iterations <= 0) iterations = 200000;
+
+    // Logging is switched per suite below, so it has to be set up; packets go to a port
+    // nobody listens on unless FFB_PORT says otherwise.
+    _putenv("FFB_LOG=1");
+    if (!getenv("FFB_PORT")) _putenv("FFB_PORT=21997");
+    init_log();
+    init_udp();
+    QueryPerformanceFrequency(&g_qpc_freq);
+
+    printf("dinput8 proxy hot path, %d iterations, FFB_LOG_LEVEL=%d, UDP %s\n", iterations, FFB_LOG_LEVEL,
+           g_udp_thread ? "async" : "inline");
+    printf("logging off:\n");
+    g_log_enabled = 0;
+    run_suite(iterations);
+
+    printf("logging on (%s):\n", FFB_LOG_LEVEL == 0 ? "compiled out" : LOG_PATH);
+    g_log_enabled = 1;
+    unsigned long long log_dropped = g_log_dropped.load();
+    run_suite(iterations);
+    g_log_enabled = 0;
+
+    // A full ring skips the formatting, so many drops make "logging on" look cheap.
+    printf("log lines dropped while on: %llu\n", g_log_dropped.load() - log_dropped);
+    printf("udp queued=%llu dropped=%llu inline=%llu, mailbox coalesced=%llu unchanged=%llu\n",
+           g_udp_queued.load(), g_udp_dropped.load(), g_udp_inline.load(),
+           g_mailbox_coalesced.load(), g_mailbox_unchanged.load());
+    return 0;
+}
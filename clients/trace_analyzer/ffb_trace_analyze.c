@@ -0,0 +1,435 @@
+/*
+ * Offline analyzer for dinput8 proxy call traces (FFB_TRACE, see ../common/ffb_trace.h).
+ *
+ * Build (Linux/macOS):
+ *   cc -O2 -o ffb_trace_analyze ffb_trace_analyze.c
+ *
+ * The trace is memory-mapped and walked once, so multi-hour traces cost one pass over
+ * the page cache and a fixed amount of memory per effect.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../common/ffb_wire.h"
+#include "../common/ffb_trace.h"
+
+/* Log-linear histogram: 8 sub-buckets per power of two, so any percentile read back
+ * from it is within 12.5% of the true value. */
+#define HIST_SUB_BITS 3
+#define HIST_BUCKETS 512
+#define MAG_BUCKETS 20
+#define FLAG_COMBOS 8
+#define MAX_EFFECTS 65536
+
+typedef struct Hist {
+    unsigned long long n[HIST_BUCKETS];
+    unsigned long long count;
+    unsigned long long max;
+} Hist;
+
+typedef struct ParamStats {
+    long long min, max;
+    double sum;
+    unsigned long long n;
+} ParamStats;
+
+typedef struct FlagCombo {
+    unsigned flags;
+    unsigned long long count;
+} FlagCombo;
+
+typedef struct EffectStats {
+    unsigned id;
+    unsigned type;
+    int fake;
+    unsigned long long first_us, last_us, created_us, released_us;
+    unsigned long long sets, starts, stops, repeats;
+    unsigned long long last_set_us;
+    int has_last;
+    int32_t last_p[FFB_TRACE_PARAMS];
+    Hist gaps;
+    ParamStats params[FFB_TRACE_PARAMS];
+    unsigned long long primary[MAG_BUCKETS];
+    FlagCombo combos[FLAG_COMBOS];
+    unsigned long long other_combos;
+} EffectStats;
+
+static EffectStats *g_effects[MAX_EFFECTS];
+static Hist g_all_gaps;
+static unsigned long long g_calls[16];
+static unsigned long long g_commands[8];
+
+static int hist_index(unsigned long long v) {
+    if (v < (1u << HIST_SUB_BITS)) return (int)v;
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - HIST_SUB_BITS;
+    return ((msb - HIST_SUB_BITS + 1) << HIST_SUB_BITS) + (int)((v >> shift) & ((1u << HIST_SUB_BITS) - 1));
+}
+
+static unsigned long long hist_lower(int idx) {
+    if (idx < (1 << HIST_SUB_BITS)) return (unsigned long long)idx;
+    int group = idx >> HIST_SUB_BITS;
+    int sub = idx & ((1 << HIST_SUB_BITS) - 1);
+    int msb = group + HIST_SUB_BITS - 1;
+    return (unsigned long long)((1 << HIST_SUB_BITS) + sub) << (msb - HIST_SUB_BITS);
+}
+
+static void hist_add(Hist *h, unsigned long long v) {
+    h->n[hist_index(v)]++;
+    h->count++;
+    if (v > h->max) h->max = v;
+}
+
+static unsigned long long hist_percentile(const Hist *h, double q) {
+    if (h->count == 0) return 0;
+    unsigned long long want = (unsigned long long)(q * (double)(h->count - 1)) + 1;
+    unsigned long long seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->n[i];
+        if (seen >= want) return hist_lower(i);
+    }
+    return h->max;
+}
+
+/* One row per power of two, which is what reads well in a terminal. */
+static void hist_print(const Hist *h, const char *indent) {
+    unsigned long long octave[64] = {0};
+    int lo = 64, hi = -1;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        if (!h->n[i]) continue;
+        unsigned long long v = hist_lower(i);
+        int o = v == 0 ? 0 : 64 - __builtin_clzll(v);
+        octave[o] += h->n[i];
+        if (o < lo) lo = o;
+        if (o > hi) hi = o;
+    }
+    unsigned long long peak = 0;
+    for (int o = lo; o <= hi; o++) {
+        if (octave[o] > peak) peak = octave[o];
+    }
+    for (int o = lo; o <= hi; o++) {
+        unsigned long long from = o == 0 ? 0 : 1ull << (o - 1);
+        unsigned long long to = 1ull << o;
+        int bar = peak ? (int)(octave[o] * 40 / peak) : 0;
+        printf("%s%10llu - %-10llu us %10llu %5.1f%% ", indent, from, to - 1, octave[o],
+               100.0 * (double)octave[o] / (double)h->count);
+        for (int b = 0; b < bar; b++) putchar('#');
+        putchar('\n');
+    }
+}
+
+static const char *call_name(unsigned call) {
+    switch (call) {
+    case FFB_TRACE_CREATE_EFFECT: return "CreateEffect";
+    case FFB_TRACE_SET_PARAMETERS: return "SetParameters";
+    case FFB_TRACE_START: return "Start";
+    case FFB_TRACE_STOP: return "Stop";
+    case FFB_TRACE_RELEASE: return "Release";
+    case FFB_TRACE_ACQUIRE: return "Acquire";
+    case FFB_TRACE_UNACQUIRE: return "Unacquire";
+    case FFB_TRACE_FF_COMMAND: return "SendForceFeedbackCommand";
+    default: return "unknown";
+    }
+}
+
+static const char *type_name(unsigned type) {
+    switch (type) {
+    case FFB_EFFECT_CONSTANT: return "constant";
+    case FFB_EFFECT_RAMP: return "ramp";
+    case FFB_EFFECT_SPRING: return "spring";
+    case FFB_EFFECT_DAMPER: return "damper";
+    case FFB_EFFECT_FRICTION: return "friction";
+    case FFB_EFFECT_INERTIA: return "inertia";
+    case FFB_EFFECT_SINE: return "sine";
+    case FFB_EFFECT_SQUARE: return "square";
+    case FFB_EFFECT_TRIANGLE: return "triangle";
+    case FFB_EFFECT_SAW_UP: return "sawUp";
+    case FFB_EFFECT_SAW_DOWN: return "sawDown";
+    default: return "custom";
+    }
+}
+
+/* Names of the SetParameters p[] slots for a type (see ffb_trace.h); NULL = unused. */
+static const char *param_name(unsigned type, int i) {
+    static const char *const common[2] = {"gain", "direction"};
+    static const char *const constant[] = {"magnitude"};
+    static const char *const ramp[] = {"start", "end"};
+    static const char *const condition[] = {"offset", "posCoeff", "negCoeff", "posSat", "negSat", "deadband"};
+    static const char *const periodic[] = {"magnitude", "offset", "phase", "period"};
+    if (i < 2) return common[i];
+    i -= 2;
+    if (type == FFB_EFFECT_CONSTANT) return i < 1 ? constant[i] : NULL;
+    if (type == FFB_EFFECT_RAMP) return i < 2 ? ramp[i] : NULL;
+    if (type >= FFB_EFFECT_SPRING && type <= FFB_EFFECT_INERTIA) return i < 6 ? condition[i] : NULL;
+    if (type >= FFB_EFFECT_SINE && type <= FFB_EFFECT_SAW_DOWN) return i < 4 ? periodic[i] : NULL;
+    return NULL;
+}
+
+/* The parameter whose distribution gets a histogram: magnitude, or the positive coefficient. */
+/* Whether a SetParameters record carries p[i]: the call's dwFlags name what it set. */
+static int param_set(unsigned flags, int i) {
+    if (i == 0) return (flags & FFB_TRACE_DIEP_GAIN) != 0;
+    if (i == 1) return (flags & FFB_TRACE_DIEP_DIRECTION) != 0;
+    return (flags & FFB_TRACE_DIEP_TYPESPECIFICPARAMS) != 0;
+}
+
+static int primary_param(unsigned type) {
+    if (type >= FFB_EFFECT_SPRING && type <= FFB_EFFECT_INERTIA) return 3;
+    return 2;
+}
+
+static EffectStats *effect(unsigned id, unsigned type, unsigned long long t) {
+    EffectStats *e = g_effects[id];
+    if (!e) {
+        e = (EffectStats *)calloc(1, sizeof(EffectStats));
+        if (!e) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        e->id = id;
+        e->type = type;
+        e->first_us = t;
+        for (int i = 0; i < FFB_TRACE_PARAMS; i++) {
+            e->params[i].min = 0x7fffffffffffffffll;
+            e->params[i].max = -0x7fffffffffffffffll;
+        }
+        g_effects[id] = e;
+    }
+    e->last_us = t;
+    return e;
+}
+
+static void add_combo(EffectStats *e, unsigned flags) {
+    for (int i = 0; i < FLAG_COMBOS; i++) {
+        if (e->combos[i].count && e->combos[i].flags == flags) {
+            e->combos[i].count++;
+            return;
+        }
+        if (!e->combos[i].count) {
+            e->combos[i].flags = flags;
+            e->combos[i].count = 1;
+            return;
+        }
+    }
+    e->other_combos++;
+}
+
+static void on_set_parameters(EffectStats *e, const FfbTraceRecord *r) {
+    e->sets++;
+    if (e->last_set_us) {
+        unsigned long long gap = r->t_us >= e->last_set_us ? r->t_us - e->last_set_us : 0;
+        hist_add(&e->gaps, gap);
+        hist_add(&g_all_gaps, gap);
+    }
+    e->last_set_us = r->t_us;
+
+    if (e->has_last && memcmp(e->last_p, r->p, sizeof(r->p)) == 0) e->repeats++;
+    memcpy(e->last_p, r->p, sizeof(r->p));
+    e->has_last = 1;
+
+    for (int i = 0; i < FFB_TRACE_PARAMS; i++) {
+        if (!param_name(e->type, i) || !param_set(r->flags, i)) continue;
+        ParamStats *ps = &e->params[i];
+        long long v = r->p[i];
+        if (v < ps->min) ps->min = v;
+        if (v > ps->max) ps->max = v;
+        ps->sum += (double)v;
+        ps->n++;
+    }
+    if (param_set(r->flags, primary_param(e->type))) {
+        long long v = r->p[primary_param(e->type)];
+        if (v < -FFB_MAGNITUDE_MAX) v = -FFB_MAGNITUDE_MAX;
+        if (v > FFB_MAGNITUDE_MAX) v = FFB_MAGNITUDE_MAX;
+        int b = (int)((v + FFB_MAGNITUDE_MAX) * MAG_BUCKETS / (2 * FFB_MAGNITUDE_MAX));
+        e->primary[b < MAG_BUCKETS ? b : MAG_BUCKETS - 1]++;
+    }
+    add_combo(e, r->flags);
+}
+
+static void print_effect(const EffectStats *e) {
+    double span = (double)(e->last_us - e->first_us) / 1e6;
+    printf("\neffect %u (%s%s): %llu SetParameters, %llu Start, %llu Stop, %llu repeated params, %.1fs alive\n",
+           e->id, type_name(e->type), e->fake ? ", fake" : "", e->sets, e->starts, e->stops, e->repeats, span);
+    if (e->gaps.count) {
+        printf("  SetParameters interval: p50 %llu us  p90 %llu us  p99 %llu us  max %llu us  (mean rate %.1f Hz)\n",
+               hist_percentile(&e->gaps, 0.50), hist_percentile(&e->gaps, 0.90),
+               hist_percentile(&e->gaps, 0.99), e->gaps.max,
+               span > 0 ? (double)(e->sets - 1) / span : 0.0);
+        hist_print(&e->gaps, "    ");
+    }
+    if (e->sets) {
+        printf("  params:");
+        for (int i = 0; i < FFB_TRACE_PARAMS; i++) {
+            const char *name = param_name(e->type, i);
+            const ParamStats *ps = &e->params[i];
+            if (!name || !ps->n) continue;
+            printf(" %s=[%lld .. %.0f .. %lld]", name, ps->min, ps->sum / (double)ps->n, ps->max);
+        }
+        printf("\n  %s distribution (-10000..10000):\n", param_name(e->type, primary_param(e->type)));
+        unsigned long long peak = 0;
+        for (int b = 0; b < MAG_BUCKETS; b++) {
+            if (e->primary[b] > peak) peak = e->primary[b];
+        }
+        for (int b = 0; b < MAG_BUCKETS; b++) {
+            if (!e->primary[b]) continue;
+            int from = -FFB_MAGNITUDE_MAX + b * (2 * FFB_MAGNITUDE_MAX) / MAG_BUCKETS;
+            int bar = (int)(e->primary[b] * 40 / peak);
+            printf("    %6d .. %-6d %10llu ", from, from + (2 * FFB_MAGNITUDE_MAX) / MAG_BUCKETS, e->primary[b]);
+            for (int i = 0; i < bar; i++) putchar('#');
+            putchar('\n');
+        }
+        printf("  dwFlags:");
+        for (int i = 0; i < FLAG_COMBOS && e->combos[i].count; i++) {
+            printf(" 0x%08x x%llu", e->combos[i].flags, e->combos[i].count);
+        }
+        if (e->other_combos) printf(" other x%llu", e->other_combos);
+        putchar('\n');
+    }
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "Usage: %s [-e <effect id>] [-s] <trace file>\n", argv0);
+    fprintf(stderr, "  -e <id>  details for one effect only\n");
+    fprintf(stderr, "  -s       summary only, no per-effect details\n");
+}
+
+int main(int argc, char **argv) {
+    long only = -1;
+    int summary = 0;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            only = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-s") == 0) {
+            summary = 1;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!path) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FfbTraceHeader)) {
+        fprintf(stderr, "%s: not a trace (too short)\n", path);
+        return 1;
+    }
+    size_t size = (size_t)st.st_size;
+    const unsigned char *base = (const unsigned char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == (const unsigned char *)MAP_FAILED) {
+        fprintf(stderr, "%s: mmap: %s\n", path, strerror(errno));
+        return 1;
+    }
+    madvise((void *)base, size, MADV_SEQUENTIAL);
+
+    FfbTraceHeader hdr;
+    memcpy(&hdr, base, sizeof(hdr));
+    if (hdr.magic != FFB_TRACE_MAGIC || hdr.version != FFB_TRACE_VERSION ||
+        hdr.record_size < sizeof(FfbTraceRecord)) {
+        fprintf(stderr, "%s: not a version %d trace\n", path, FFB_TRACE_VERSION);
+        return 1;
+    }
+
+    size_t stride = hdr.record_size;
+    size_t count = (size - sizeof(hdr)) / stride;
+    unsigned long long first = 0, last = 0;
+    for (size_t i = 0; i < count; i++) {
+        FfbTraceRecord r;
+        memcpy(&r, base + sizeof(hdr) + i * stride, sizeof(r));
+        if (i == 0) first = r.t_us;
+        last = r.t_us;
+        g_calls[r.call & 15]++;
+
+        if (r.call == FFB_TRACE_FF_COMMAND) {
+            for (int b = 0; b < 6; b++) {
+                if (r.flags & (1u << b)) g_commands[b]++;
+            }
+            continue;
+        }
+        if (r.call == FFB_TRACE_ACQUIRE || r.call == FFB_TRACE_UNACQUIRE) continue;
+
+        EffectStats *e = effect(r.effect_id, r.effect_type, r.t_us);
+        switch (r.call) {
+        case FFB_TRACE_CREATE_EFFECT:
+            e->created_us = r.t_us;
+            e->fake = r.flags & 1;
+            break;
+        case FFB_TRACE_SET_PARAMETERS:
+            on_set_parameters(e, &r);
+            break;
+        case FFB_TRACE_START:
+            e->starts++;
+            break;
+        case FFB_TRACE_STOP:
+            e->stops++;
+            break;
+        case FFB_TRACE_RELEASE:
+            e->released_us = r.t_us;
+            break;
+        default:
+            break;
+        }
+    }
+
+    double span = count ? (double)(last - first) / 1e6 : 0;
+    printf("trace %s: pid %u, %zu records over %.1fs", path, hdr.pid, count, span);
+    if ((size - sizeof(hdr)) % stride) printf(" (truncated last record ignored)");
+    printf("\n\ncalls:\n");
+    for (unsigned c = 1; c < 16; c++) {
+        if (g_calls[c]) printf("  %-26s %12llu  %10.1f/s\n", call_name(c), g_calls[c], span > 0 ? (double)g_calls[c] / span : 0.0);
+    }
+    static const char *const cmd_names[6] = {"RESET", "STOPALL", "PAUSE", "CONTINUE", "SETACTUATORSON", "SETACTUATORSOFF"};
+    int any_cmd = 0;
+    for (int b = 0; b < 6; b++) any_cmd |= g_commands[b] != 0;
+    if (any_cmd) {
+        printf("\nforce feedback commands:");
+        for (int b = 0; b < 6; b++) {
+            if (g_commands[b]) printf(" %s x%llu", cmd_names[b], g_commands[b]);
+        }
+        putchar('\n');
+    }
+
+    printf("\n%-6s %-9s %12s %8s %8s %10s %10s %10s\n", "effect", "type", "SetParams", "Start", "Stop", "rate Hz", "p50 us", "p99 us");
+    for (unsigned id = 0; id < MAX_EFFECTS; id++) {
+        const EffectStats *e = g_effects[id];
+        if (!e) continue;
+        double alive = (double)(e->last_us - e->first_us) / 1e6;
+        printf("%-6u %-9s %12llu %8llu %8llu %10.1f %10llu %10llu\n", id, type_name(e->type), e->sets, e->starts,
+               e->stops, alive > 0 && e->sets > 1 ? (double)(e->sets - 1) / alive : 0.0,
+               hist_percentile(&e->gaps, 0.50), hist_percentile(&e->gaps, 0.99));
+    }
+    if (g_all_gaps.count) {
+        printf("\nSetParameters interval, all effects: p50 %llu us  p99 %llu us  p99.9 %llu us  max %llu us\n",
+               hist_percentile(&g_all_gaps, 0.50), hist_percentile(&g_all_gaps, 0.99),
+               hist_percentile(&g_all_gaps, 0.999), g_all_gaps.max);
+        hist_print(&g_all_gaps, "  ");
+    }
+
+    if (!summary) {
+        for (unsigned id = 0; id < MAX_EFFECTS; id++) {
+            const EffectStats *e = g_effects[id];
+            if (!e || (only >= 0 && (long)id != only)) continue;
+            print_effect(e);
+        }
+    }
+
+    munmap((void *)base, size);
+    close(fd);
+    return 0;
+}